@@ -0,0 +1,120 @@
+#include <new>
+
+#include "msrp/Arena.hxx"
+
+using namespace msrp;
+using namespace std;
+
+static const size_t Alignment = sizeof(void*) * 2;
+
+static inline size_t
+align(size_t size)
+{
+   return (size + Alignment - 1) & ~(Alignment - 1);
+}
+
+Arena::Arena(size_t chunkSize) :
+   mHead(0),
+   mChunkSize(align(chunkSize))
+{}
+
+Arena::~Arena()
+{
+   while (mHead)
+   {
+      Chunk* next = mHead->next;
+      ::operator delete(mHead);
+      mHead = next;
+   }
+}
+
+Arena::Chunk*
+Arena::chunk(size_t size)
+{
+   Chunk* c = static_cast<Chunk*>(::operator new(align(sizeof(Chunk)) + size));
+
+   // data() starts right after the header; skip the padding up to alignment
+   c->next = mHead;
+   c->used = align(sizeof(Chunk)) - sizeof(Chunk);
+   c->size = c->used + size;
+
+   mHead = c;
+
+   return c;
+}
+
+void*
+Arena::allocate(size_t size)
+{
+   size = align(size);
+
+   Chunk* c = mHead;
+   if (!c || c->size - c->used < size)
+   {
+      // !cb! oversized requests get a chunk of their own
+      c = chunk(size > mChunkSize ? size : mChunkSize);
+   }
+
+   void* p = c->data() + c->used;
+   c->used += size;
+
+   return p;
+}
+
+void
+Arena::reset()
+{
+   if (!mHead)
+   {
+      return;
+   }
+
+   // keep the oldest chunk; anything allocated since is released
+   Chunk* c = mHead;
+   while (c->next)
+   {
+      Chunk* next = c->next;
+      ::operator delete(c);
+      c = next;
+   }
+
+   mHead = c;
+   mHead->used = align(sizeof(Chunk)) - sizeof(Chunk);
+}
+
+size_t
+Arena::capacity() const
+{
+   size_t total = 0;
+
+   for (const Chunk* c = mHead; c; c = c->next)
+   {
+      total += c->size;
+   }
+
+   return total;
+}
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
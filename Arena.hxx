@@ -1,24 +1,45 @@
-#ifndef MSRP_DNSRESULTSINK_HXX
-#define MSRP_DNSRESULTSINK_HXX
+#ifndef MSRP_ARENA_HXX
+#define MSRP_ARENA_HXX
 
-#include <rutil/dns/DnsStub.hxx>
+#include <cstddef>
+
+#include <boost/noncopyable.hpp>
 
 namespace msrp
 {
 
-// Provide default implementations to make resip::DnsResultSink concrete, so
-// only the relevant result handler must be implemented in the DnsResultHandler
-// template.
-class DnsResultSinkImpl : public resip::DnsResultSink
+// !cb! Bump allocator for per-message variable-length data.  Memory is carved
+// out of chunks and only given back in bulk by reset(), which keeps the first
+// chunk so that a recycled message can be refilled without going to the
+// heap.  Not thread-safe; an arena belongs to one message at a time.
+
+class Arena : private boost::noncopyable
 {
    public:
-      virtual void onDnsResult(const resip::DNSResult<resip::DnsHostRecord>&) {}
-      virtual void onDnsResult(const resip::DNSResult<resip::DnsSrvRecord>&) {}
-      virtual void onDnsResult(const resip::DNSResult<resip::DnsNaptrRecord>&) {}
-      virtual void onDnsResult(const resip::DNSResult<resip::DnsCnameRecord>&) {}
-#ifdef USE_IPV6
-      virtual void onDnsResult(const resip::DNSResult<resip::DnsAAAARecord>&) {}
-#endif
+      explicit Arena(std::size_t chunkSize = 1024);
+      ~Arena();
+
+      void* allocate(std::size_t size);
+
+      // Release everything allocated so far.
+      void reset();
+
+      std::size_t capacity() const;
+
+   private:
+      struct Chunk
+      {
+         Chunk* next;
+         std::size_t size;
+         std::size_t used;
+
+         char* data() { return reinterpret_cast<char*>(this + 1); }
+      };
+
+      Chunk* chunk(std::size_t size);
+
+      Chunk* mHead;
+      std::size_t mChunkSize;
 };
 
 }
@@ -0,0 +1,133 @@
+#include <boost/bind.hpp>
+
+#include "msrp/System.hxx"
+#include "msrp/AsyncLog.hxx"
+
+#define RESIPROCATE_SUBSYSTEM resip::Subsystem::NONE
+
+using namespace msrp;
+using namespace std;
+using namespace boost;
+
+AsyncLog&
+AsyncLog::instance()
+{
+   // !cb! never destroyed; anything may log during static destruction
+   static AsyncLog* log = new AsyncLog;
+
+   return *log;
+}
+
+AsyncLog::AsyncLog() :
+   mRing(Capacity), mReported(0)
+{
+   mThread.reset(new thread(bind(&AsyncLog::run, this)));
+}
+
+void
+AsyncLog::push(Record* r)
+{
+   if (!mRing.push(r))
+   {
+      mDropped.fetchAdd(1);
+
+      delete r;
+
+      return;
+   }
+
+   if (mPending.fetchAdd(1) == 0)
+   {
+      mutex::scoped_lock lock(mWaiting);
+      mReady.notify_one();
+   }
+}
+
+void
+AsyncLog::flush()
+{
+   drain();
+}
+
+unsigned long
+AsyncLog::dropped() const
+{
+   return mDropped.load();
+}
+
+void
+AsyncLog::run()
+{
+   for (;;)
+   {
+      {
+         mutex::scoped_lock lock(mWaiting);
+
+         while (mPending.load() <= 0)
+         {
+            mReady.wait(lock);
+         }
+      }
+
+      drain();
+   }
+}
+
+bool
+AsyncLog::drain()
+{
+   mutex::scoped_lock lock(mWriting);
+
+   long written = 0;
+
+   Record* r;
+
+   while (mRing.pop(r))
+   {
+      {
+         resip::Log::Guard guard(r->level, *r->subsystem, r->file, r->line);
+         guard.asStream() << r->text;
+      }
+
+      delete r;
+
+      ++written;
+   }
+
+   mPending.fetchSub(written);
+
+   const unsigned long dropped = mDropped.load();
+
+   if (dropped != mReported)
+   {
+      WarningLog(<< "log ring full, " << dropped - mReported << " lines dropped");
+
+      mReported = dropped;
+   }
+
+   return written != 0;
+}
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
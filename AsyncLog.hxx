@@ -0,0 +1,173 @@
+#ifndef MSRP_ASYNCLOG_HXX
+#define MSRP_ASYNCLOG_HXX
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <rutil/Data.hxx>
+#include <rutil/DataStream.hxx>
+#include <rutil/Logger.hxx>
+#include <rutil/Subsystem.hxx>
+
+#include "msrp/Atomic.hxx"
+#include "msrp/Ring.hxx"
+
+// !cb! Logging for the reactor.  The MsrpXxxLog macros take the same
+// arguments as resip's XxxLog, but a line is only formatted on the calling
+// thread; it is written by a background thread, through resip's logger,
+// from a lock-free ring.  If the ring is full the line is dropped and
+// counted rather than waiting on a slow log.  The writer sleeps until a
+// line arrives in an empty ring, so only that push takes a lock.
+//
+// Levels above MSRP_LOG_LEVEL are removed by the preprocessor.  It
+// defaults to Debug in debug builds and Info otherwise; the values are
+// resip's Log::Level.
+
+#define MSRP_LOG_ERR 3
+#define MSRP_LOG_WARNING 4
+#define MSRP_LOG_INFO 6
+#define MSRP_LOG_DEBUG 7
+
+#ifndef MSRP_LOG_LEVEL
+#ifdef DEBUG
+#define MSRP_LOG_LEVEL MSRP_LOG_DEBUG
+#else
+#define MSRP_LOG_LEVEL MSRP_LOG_INFO
+#endif
+#endif
+
+#define MsrpLog(level_, args_)                                                   \
+   do                                                                            \
+   {                                                                             \
+      if (resip::Log::isLogging(level_, RESIPROCATE_SUBSYSTEM))                  \
+      {                                                                          \
+         msrp::AsyncLog::Record* _msrp_record =                                  \
+            new msrp::AsyncLog::Record(level_, RESIPROCATE_SUBSYSTEM,            \
+                  __FILE__, __LINE__);                                           \
+         {                                                                       \
+            resip::DataStream _msrp_stream(_msrp_record->text);                  \
+            _msrp_stream args_;                                                  \
+         }                                                                       \
+         msrp::AsyncLog::instance().push(_msrp_record);                          \
+      }                                                                          \
+   } while (false)
+
+#define MsrpLogNothing() do {} while (false)
+
+#if MSRP_LOG_LEVEL >= MSRP_LOG_ERR
+#define MsrpErrLog(args_) MsrpLog(resip::Log::Err, args_)
+#else
+#define MsrpErrLog(args_) MsrpLogNothing()
+#endif
+
+#if MSRP_LOG_LEVEL >= MSRP_LOG_WARNING
+#define MsrpWarningLog(args_) MsrpLog(resip::Log::Warning, args_)
+#else
+#define MsrpWarningLog(args_) MsrpLogNothing()
+#endif
+
+#if MSRP_LOG_LEVEL >= MSRP_LOG_INFO
+#define MsrpInfoLog(args_) MsrpLog(resip::Log::Info, args_)
+#else
+#define MsrpInfoLog(args_) MsrpLogNothing()
+#endif
+
+#if MSRP_LOG_LEVEL >= MSRP_LOG_DEBUG
+#define MsrpDebugLog(args_) MsrpLog(resip::Log::Debug, args_)
+#else
+#define MsrpDebugLog(args_) MsrpLogNothing()
+#endif
+
+namespace msrp
+{
+
+class AsyncLog : private boost::noncopyable
+{
+   public:
+      enum
+      {
+         Capacity = 4096   // records queued before lines are dropped
+      };
+
+      struct Record
+      {
+         Record(resip::Log::Level l, const resip::Subsystem& s, const char* f, int n) :
+            level(l), subsystem(&s), file(f), line(n)
+         {}
+
+         resip::Log::Level level;
+         const resip::Subsystem* subsystem;
+         const char* file;
+         int line;
+
+         resip::Data text;
+      };
+
+      static AsyncLog& instance();
+
+      // takes ownership of the record
+      void push(Record*);
+
+      // write everything queued so far from the calling thread, e.g. before
+      // exiting
+      void flush();
+
+      unsigned long dropped() const;
+
+   private:
+      AsyncLog();
+
+      void run();
+
+      // false if there was nothing to write
+      bool drain();
+
+      Ring<Record*> mRing;
+
+      // !cb! Records pushed and not yet written.  Only the push that finds
+      // it zero wakes the writer; it can dip below zero while a record is
+      // written before its push has counted it.
+      Atomic<long> mPending;
+
+      boost::mutex mWaiting;
+      boost::condition mReady;
+
+      Atomic<unsigned long> mDropped;
+      unsigned long mReported;
+
+      // the writer thread against flush()
+      boost::mutex mWriting;
+
+      boost::scoped_ptr<boost::thread> mThread;
+};
+
+}
+
+#endif
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
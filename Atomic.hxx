@@ -0,0 +1,86 @@
+#ifndef MSRP_ATOMIC_HXX
+#define MSRP_ATOMIC_HXX
+
+namespace msrp
+{
+
+// !cb! Minimal atomic word built on the GCC __sync intrinsics.  Every
+// operation is a full barrier, which is stronger than the lock-free
+// structures here need but keeps them easy to reason about.  T must be an
+// integral or pointer type no wider than a machine word.
+
+template<typename T>
+class Atomic
+{
+   public:
+      explicit Atomic(T value = T()) :
+         mValue(value)
+      {}
+
+      T load() const
+      {
+         // a no-op compare-and-swap is an atomic read of any word type
+         return __sync_val_compare_and_swap(const_cast<volatile T*>(&mValue), T(), T());
+      }
+
+      void store(T value)
+      {
+         exchange(value);
+      }
+
+      T exchange(T value)
+      {
+         // __sync_lock_test_and_set is only an acquire barrier
+         __sync_synchronize();
+         return __sync_lock_test_and_set(&mValue, value);
+      }
+
+      bool compareExchange(T expected, T desired)
+      {
+         return __sync_bool_compare_and_swap(&mValue, expected, desired);
+      }
+
+      T fetchAdd(T delta)
+      {
+         return __sync_fetch_and_add(&mValue, delta);
+      }
+
+      T fetchSub(T delta)
+      {
+         return __sync_fetch_and_sub(&mValue, delta);
+      }
+
+   private:
+      Atomic(const Atomic&);
+      Atomic& operator=(const Atomic&);
+
+      volatile T mValue;
+};
+
+}
+
+#endif
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
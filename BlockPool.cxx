@@ -0,0 +1,306 @@
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "msrp/BlockPool.hxx"
+
+using namespace msrp;
+using namespace std;
+using namespace boost;
+
+struct BlockPool::Shared
+{
+   Shared(BlockPool* owner) :
+      mRefs(1), mOwner(owner), mFree(0), mIdle(0), mInUse(0), mTarget(Target)
+   {}
+
+   ~Shared()
+   {
+      while (mFree)
+      {
+         Block* next = mFree->mNext;
+         delete mFree;
+         mFree = next;
+      }
+   }
+
+   Atomic<long> mRefs;
+
+   mutable Mutex mMutex;
+
+   // the service while its timer may be armed, 0 once stopped
+   BlockPool* mOwner;
+
+   Block* mFree;
+
+   size_t mIdle;
+   size_t mInUse;
+   size_t mTarget;
+};
+
+BlockPool::BlockPool(asio::io_service& ios) :
+   asio::io_service::service(ios),
+   mShared(new Shared(this)),
+   mTimer(ios),
+   mInterval(posix_time::seconds(static_cast<long>(Interval))),
+   mArmed(false)
+{}
+
+BlockPool::~BlockPool()
+{
+   stop();
+
+   // !cb! blocks still referenced by a Buffer keep the free list alive
+   unref(mShared);
+}
+
+void
+BlockPool::shutdown_service()
+{
+   stop();
+}
+
+void
+BlockPool::stop()
+{
+   ScopedLock lock(mShared->mMutex);
+
+   mShared->mOwner = 0;
+
+   if (mArmed)
+   {
+      try
+      {
+         mTimer.cancel();
+      }
+      catch (const asio::error&) {}
+
+      mArmed = false;
+   }
+}
+
+void
+BlockPool::interval(const asio::deadline_timer::duration_type& interval)
+{
+   ScopedLock lock(mShared->mMutex);
+
+   mInterval = interval;
+}
+
+void
+BlockPool::arm()
+{
+   if (mArmed)
+   {
+      return;
+   }
+
+   mArmed = true;
+
+   mTimer.expires_from_now(mInterval);
+   mTimer.async_wait(bind(&BlockPool::onTimer, this, asio::placeholders::error));
+}
+
+void
+BlockPool::onTimer(const asio::error& e)
+{
+   {
+      ScopedLock lock(mShared->mMutex);
+
+      // cancelled by stop(), which has already disarmed
+      if (e || !mShared->mOwner)
+      {
+         return;
+      }
+
+      mArmed = false;
+   }
+
+   trim(mShared);
+}
+
+BlockPool::Block*
+BlockPool::allocate()
+{
+   Block* block;
+
+   mShared->mRefs.fetchAdd(1);
+
+   {
+      ScopedLock lock(mShared->mMutex);
+
+      block = mShared->mFree;
+
+      if (block)
+      {
+         mShared->mFree = block->mNext;
+         --mShared->mIdle;
+      }
+
+      ++mShared->mInUse;
+   }
+
+   if (!block)
+   {
+      block = new Block(mShared);
+   }
+
+   block->mNext = 0;
+   block->mRefs.store(1);
+   block->mUsed.store(0);
+
+   return block;
+}
+
+void
+BlockPool::retain(Block* block)
+{
+   block->mRefs.fetchAdd(1);
+}
+
+void
+BlockPool::release(Block* block)
+{
+   if (block->mRefs.fetchSub(1) != 1)
+   {
+      return;
+   }
+
+   Shared* shared = block->mShared;
+
+   {
+      ScopedLock lock(shared->mMutex);
+
+      block->mNext = shared->mFree;
+      shared->mFree = block;
+
+      ++shared->mIdle;
+      --shared->mInUse;
+
+      if (shared->mIdle > shared->mTarget && shared->mOwner)
+      {
+         shared->mOwner->arm();
+      }
+   }
+
+   unref(shared);
+}
+
+size_t
+BlockPool::extend(Block* block, const char* end, size_t size)
+{
+   const long used = end - block->data();
+   const long claim = min<long>(size, BlockSize - used);
+
+   if (claim <= 0 || !block->mUsed.compareExchange(used, used + claim))
+   {
+      return 0;
+   }
+
+   return claim;
+}
+
+void
+BlockPool::unref(Shared* shared)
+{
+   if (shared->mRefs.fetchSub(1) == 1)
+   {
+      delete shared;
+   }
+}
+
+void
+BlockPool::target(size_t blocks)
+{
+   ScopedLock lock(mShared->mMutex);
+
+   mShared->mTarget = blocks;
+}
+
+size_t
+BlockPool::target() const
+{
+   ScopedLock lock(mShared->mMutex);
+
+   return mShared->mTarget;
+}
+
+size_t
+BlockPool::trim()
+{
+   return trim(mShared);
+}
+
+size_t
+BlockPool::trim(Shared* shared)
+{
+   Block* victims = 0;
+   size_t count = 0;
+
+   {
+      ScopedLock lock(shared->mMutex);
+
+      while (shared->mIdle > shared->mTarget)
+      {
+         Block* block = shared->mFree;
+         shared->mFree = block->mNext;
+
+         block->mNext = victims;
+         victims = block;
+
+         --shared->mIdle;
+         ++count;
+      }
+   }
+
+   // delete outside the lock
+   while (victims)
+   {
+      Block* next = victims->mNext;
+      delete victims;
+      victims = next;
+   }
+
+   return count;
+}
+
+size_t
+BlockPool::idle() const
+{
+   ScopedLock lock(mShared->mMutex);
+
+   return mShared->mIdle;
+}
+
+size_t
+BlockPool::inUse() const
+{
+   ScopedLock lock(mShared->mMutex);
+
+   return mShared->mInUse;
+}
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
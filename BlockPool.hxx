@@ -0,0 +1,139 @@
+#ifndef MSRP_BLOCKPOOL_HXX
+#define MSRP_BLOCKPOOL_HXX
+
+#include <cstddef>
+
+#include <asio.hpp>
+#include <asio/deadline_timer.hpp>
+
+#include "msrp/Atomic.hxx"
+#include "msrp/Mutex.hxx"
+
+namespace msrp
+{
+
+// !cb! Slab allocator for send buffer blocks, one per io_service (get it
+// with asio::use_service<BlockPool>).  Idle blocks sit on an intrusive free
+// list, so allocate and release are O(1).  Blocks are refcounted so that
+// several Buffers can queue the same encoded payload.  When a release leaves
+// more than target() blocks idle, a timer on the io_service hands the excess
+// back to the heap one interval() later, whether or not anything else is
+// released in the meantime; call trim() to do it immediately.  The timer is
+// only armed while there is something to trim, and stop() cancels it so
+// that io_service::run() can return.
+//
+// The free list lives in a Shared object that every outstanding block holds
+// a reference to, so a Buffer destroyed after its io_service still has
+// somewhere to release its blocks; the last of them frees it.  Nothing may
+// be allocated once the service is gone.
+
+class BlockPool : public asio::io_service::service
+{
+   private:
+      struct Shared;
+
+   public:
+      enum { BlockSize = 8192 };
+
+      class Block
+      {
+         public:
+            char* data() { return mData; }
+            const char* data() const { return mData; }
+
+         private:
+            friend class BlockPool;
+            friend struct Shared;
+
+            Block(Shared* shared) : mShared(shared), mNext(0), mRefs(0), mUsed(0) {}
+
+            Shared* mShared;
+            Block* mNext;
+            Atomic<long> mRefs;
+
+            // bytes handed out by extend()
+            Atomic<long> mUsed;
+
+            char mData[BlockSize];
+      };
+
+      BlockPool(asio::io_service&);
+      ~BlockPool();
+
+      virtual void shutdown_service();
+
+      // Returns a block holding one reference.
+      Block* allocate();
+
+      static void retain(Block*);
+      static void release(Block*);
+
+      // Claim up to size bytes of the block starting at end, which must be
+      // where the last claim finished.  Returns the number of bytes claimed,
+      // 0 if someone else has written past end or the block is full.  This
+      // lets the holder of the newest bytes keep filling a shared block.
+      static std::size_t extend(Block*, const char* end, std::size_t size);
+
+      // number of idle blocks kept by trim()
+      void target(std::size_t blocks);
+      std::size_t target() const;
+
+      // Free idle blocks above target().  Returns the number freed.
+      std::size_t trim();
+
+      // delay between a release leaving too many blocks idle and the trim
+      void interval(const asio::deadline_timer::duration_type&);
+
+      // Cancel the trim timer and stop arming it; trim() still works.
+      void stop();
+
+      std::size_t idle() const;
+      std::size_t inUse() const;
+
+   private:
+      enum { Target = 16, Interval = 30 };
+
+      static std::size_t trim(Shared*);
+
+      // called with the shared mutex held
+      void arm();
+      void onTimer(const asio::error&);
+
+      // held by the service and by each block in use
+      static void unref(Shared*);
+
+      Shared* mShared;
+
+      // guarded by the shared mutex; releases arm it from any thread
+      asio::deadline_timer mTimer;
+      asio::deadline_timer::duration_type mInterval;
+      bool mArmed;
+};
+
+}
+
+#endif
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
@@ -1,111 +1,195 @@
-#include <boost/bind.hpp>
+#include <cassert>
+#include <cstring>
 
 #include "msrp/Buffer.hxx"
 
 using namespace msrp;
 using namespace std;
-using namespace boost;
 using namespace asio;
 using namespace resip;
 
-typedef object_pool<array<char, 8192> > Allocator;
-
-static Allocator Blockalloc;
-
-Buffer::Buffer() :
+Buffer::Buffer(BlockPool& pool) :
+   mPool(pool),
    mSize(0)
-{}
+{
+   mIov.reserve(Iov);
+}
 
 Buffer::~Buffer()
 {
-   for_each(mBuffers.begin(), mBuffers.end(), bind(&Buffer::free, this, _1));
+   for (deque<Segment>::const_iterator i = mSegments.begin(); i != mSegments.end(); ++i)
+   {
+      free(*i);
+   }
+}
+
+const Buffer::View
+Buffer::view() const
+{
+   if (mIov.empty())
+   {
+      return View(0, 0);
+   }
+
+   return View(&mIov[0], &mIov[0] + mIov.size());
 }
 
-const deque<const_buffer>
-Buffer::const_buffers() const
+void
+Buffer::push(const Segment& segment)
 {
-   deque<const_buffer> dqc(mBuffers.size());
+   mSegments.push_back(segment);
 
-   // !cb! does not deep copy -- const_buffer copy constructor only copies pointers
-   copy(mBuffers.begin(), mBuffers.end(), dqc.begin());
+   // !cb! capacity was reserved up front, so this never moves entries that
+   // an outstanding write may be looking at
+   if (mIov.size() + 1 == mSegments.size() && mIov.size() < Iov)
+   {
+      mIov.push_back(const_buffer(segment.data, segment.size));
+   }
 
-   return dqc;
+   mSize += segment.size;
 }
 
 void
 Buffer::write(const mutable_buffer& buf)
 {
-   mBuffers.push_back(buf);
+   Segment segment;
+   segment.block = 0;
+   segment.base = buffer_cast<char*>(buf);
+   segment.data = segment.base;
+   segment.size = buffer_size(buf);
 
-   mSize += buffer_size(buf);
+   push(segment);
 }
 
 void
 Buffer::write(const Data& data)
 {
+   const char* p = data.data();
    size_t s = data.size();
-   size_t i = 0;
 
-   while (i < s)
+   // keep filling the last block if we hold its newest bytes
+   if (!mSegments.empty() && s > 0 && mSegments.back().block)
    {
-      Allocator::element_type* block = Blockalloc.malloc();
+      Segment& tail = mSegments.back();
 
-      if (block == 0)
+      size_t space = BlockPool::extend(tail.block, tail.data + tail.size, s);
+
+      if (space > 0)
       {
-         throw bad_alloc();
+         memcpy(tail.data + tail.size, p, space);
+
+         if (mSegments.size() > mIov.size())
+         {
+            // not in the view yet, so it can simply grow
+            tail.size += space;
+            mSize += space;
+         }
+         else
+         {
+            Segment segment = tail;
+            segment.data = tail.data + tail.size;
+            segment.size = space;
+
+            BlockPool::retain(segment.block);
+
+            push(segment);
+         }
+
+         p += space;
+         s -= space;
       }
+   }
 
-      size_t space = min<size_t>(s - i, Allocator::element_type::static_size);
+   while (s > 0)
+   {
+      Segment segment;
+      segment.block = mPool.allocate();
+      segment.base = segment.block->data();
+      segment.data = segment.base;
+      segment.size = BlockPool::extend(segment.block, segment.data, s);
 
-      memcpy(block->c_array(), &data.data()[i], space);
+      memcpy(segment.data, p, segment.size);
 
-      i += space;
+      p += segment.size;
+      s -= segment.size;
 
-      mBuffers.push_back(mutable_buffer(block->c_array(), space));
+      push(segment);
    }
+}
 
-   mSize += static_cast<size_t>(i);
+void
+Buffer::append(const Buffer& other)
+{
+   for (deque<Segment>::const_iterator i = other.mSegments.begin(); i != other.mSegments.end(); ++i)
+   {
+      if (i->block)
+      {
+         BlockPool::retain(i->block);
+
+         push(*i);
+      }
+      else
+      {
+         write(Data(Data::Borrow, i->data, i->size));
+      }
+   }
 }
 
 void
 Buffer::shift(size_t size)
 {
+   assert(size <= mSize);
+
    mSize -= size;
 
+   size_t consumed = 0;
+
    while (size > 0)
    {
-      assert(!mBuffers.empty());
-
-      mutable_buffer& buf = mBuffers.front();
+      assert(!mSegments.empty());
 
-      size_t currentSize = buffer_size(buf);
+      Segment& segment = mSegments.front();
 
-      if (size < currentSize)
+      if (size < segment.size)
       {
-         // shift data to the front and resize the buffer
-         memmove(buffer_cast<void*>(buf),
-                 buffer_cast<char*>(buf) + size,
-                 currentSize - size);
+         segment.data += size;
+         segment.size -= size;
 
-         buf = mutable_buffer(buffer_cast<void*>(buf), currentSize - size);
+         if (consumed < mIov.size())
+         {
+            mIov[consumed] = const_buffer(segment.data, segment.size);
+         }
 
          break;
       }
       else
       {
-         free(buf);
+         size -= segment.size;
+
+         free(segment);
 
-         mBuffers.pop_front();
+         mSegments.pop_front();
 
-         size -= currentSize;
+         ++consumed;
       }
    }
+
+   // !cb! no write is outstanding while we shift, so the view can be
+   // compacted and refilled here
+   consumed = min(consumed, mIov.size());
+   mIov.erase(mIov.begin(), mIov.begin() + consumed);
+
+   while (mIov.size() < mSegments.size() && mIov.size() < Iov)
+   {
+      const Segment& segment = mSegments[mIov.size()];
+      mIov.push_back(const_buffer(segment.data, segment.size));
+   }
 }
 
 bool
 Buffer::empty() const
 {
-   return mBuffers.empty();
+   return mSegments.empty();
 }
 
 size_t
@@ -115,29 +199,24 @@ Buffer::size() const
 }
 
 void
-Buffer::free(const mutable_buffer& buf)
+Buffer::free(const Segment& segment)
 {
-   Allocator::element_type* block = buffer_cast<Allocator::element_type*>(buf);
-
-   if (Blockalloc.is_from(block))
+   if (segment.block)
    {
-      Blockalloc.free(block);
+      BlockPool::release(segment.block);
    }
    else
    {
-      delete[] reinterpret_cast<char*>(block);
+      delete[] segment.base;
    }
 }
 
 ostream&
 msrp::operator<<(ostream& os, const Buffer& b)
 {
-   const deque<const_buffer> v = b.const_buffers();
-
-   for (deque<const_buffer>::const_iterator i = v.begin(); i != v.end(); ++i)
+   for (deque<Buffer::Segment>::const_iterator i = b.mSegments.begin(); i != b.mSegments.end(); ++i)
    {
-      os.write(buffer_cast<const char*>(*i),
-         static_cast<streamsize>(buffer_size(*i)));
+      os.write(i->data, static_cast<streamsize>(i->size));
    }
 
    return os;
@@ -1,31 +1,74 @@
 #ifndef MSRP_BUFFER_HXX
 #define MSRP_BUFFER_HXX
 
+#include <climits>
 #include <ostream>
 #include <deque>
-
-#include <boost/array.hpp>
-#include <boost/pool/object_pool.hpp>
+#include <vector>
 
 #include <asio/buffer.hpp>
 
 #include <rutil/Data.hxx>
 
+#include "msrp/BlockPool.hxx"
+
 namespace msrp
 {
 
+// !cb! Queued data is a list of segments (pieces of pool blocks).  shift()
+// advances a cursor into the head segment rather than moving bytes, and the
+// first Iov segments are mirrored in an array of const_buffers that is kept
+// up to date as data is written and shifted, so view() costs nothing.
+// Entries already in the array are never modified outside shift(), and the
+// array never reallocates, so a view handed to an asynchronous write stays
+// valid while more data is queued behind it.
+
 class Buffer
 {
    public:
-      Buffer();
+#ifdef IOV_MAX
+      // asio gathers at most 64 buffers per writev
+      enum { Iov = IOV_MAX < 64 ? IOV_MAX : 64 };
+#else
+      enum { Iov = 16 };
+#endif
+
+      // ConstBufferSequence over the head of the queue
+      class View
+      {
+         public:
+            typedef asio::const_buffer value_type;
+            typedef const asio::const_buffer* const_iterator;
+
+            const_iterator begin() const { return mBegin; }
+            const_iterator end() const { return mEnd; }
+
+         private:
+            friend class Buffer;
+
+            View(const_iterator begin, const_iterator end) :
+               mBegin(begin), mEnd(end)
+            {}
+
+            const_iterator mBegin;
+            const_iterator mEnd;
+      };
+
+      explicit Buffer(BlockPool&);
 
       ~Buffer();
 
-      const std::deque<asio::const_buffer> const_buffers() const;
+      // At most Iov buffers from the front of the queue.
+      const View view() const;
 
+      // takes ownership of memory allocated with new[]
       void write(const asio::mutable_buffer&);
       void write(const resip::Data&);
 
+      // Queue the contents of another buffer.  Pool blocks are shared, not
+      // copied.
+      void append(const Buffer&);
+
       void shift(std::size_t bytes);
 
       bool empty() const;
@@ -35,9 +78,30 @@ class Buffer
    private:
       friend std::ostream& operator<<(std::ostream&, const Buffer&);
 
-      void free(const asio::mutable_buffer&);
+      Buffer(const Buffer&);
+      Buffer& operator=(const Buffer&);
+
+      struct Segment
+      {
+         // 0 for memory owned through write(mutable_buffer)
+         BlockPool::Block* block;
+
+         // start of the allocation, for delete[]
+         char* base;
+
+         char* data;
+         std::size_t size;
+      };
+
+      void push(const Segment&);
+      void free(const Segment&);
+
+      BlockPool& mPool;
+
+      std::deque<Segment> mSegments;
 
-      std::deque<asio::mutable_buffer> mBuffers;
+      // mirrors mSegments[0, mIov.size())
+      std::vector<asio::const_buffer> mIov;
 
       std::size_t mSize;
 };
@@ -1,100 +1,56 @@
 #ifndef MSRP_COALESCEDNSRESULTS_HXX
 #define MSRP_COALESCEDNSRESULTS_HXX
 
-#include <cstdlib>
 #include <vector>
 
-#include <asio/ip/address.hpp>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
 
-#include <rutil/dns/DnsStub.hxx>
+#include <asio.hpp>
 
-#include "DnsResultSinkImpl.hxx"
+#include "msrp/DnsMessage.hxx"
 
 namespace msrp
 {
 
-template<
-   typename Handler,
-   typename PostFunction
-   >
-class CoalesceDnsResults : public DnsResultSinkImpl
+// !cb! Collects the addresses from several queries for one host (A and
+// AAAA) and posts the handler once, when the last of them has answered.
+// Shared by the completions of those queries; they may run on different
+// threads.
+
+template<typename Handler>
+class CoalesceDnsResults : private boost::noncopyable
 {
    public:
-      CoalesceDnsResults(asio::io_service& fifo,
-            const Handler& handler,
-            const PostFunction& post) :
-         mFifo(fifo), mHandler(handler), mPost(post), mQueries(1)
-      {
-#ifdef USE_IPV6
-         mQueries++;
-#endif
-      }
-
-      virtual ~CoalesceDnsResults()
+      CoalesceDnsResults(asio::io_service& fifo, const Handler& handler, unsigned int queries) :
+         mFifo(fifo), mHandler(handler), mQueries(queries)
       {}
 
-   private:
-      template<typename Record>
-      void answer(const resip::DNSResult<Record>& r)
+      void answer(const DnsMessage& m)
       {
-         typename std::vector<Record>::const_iterator i = r.records.begin();
-         while (i != r.records.end())
-         {
-            try
-            {
-               mRecords.push_back(address(*i++));
-            }
-            catch (const asio::error&)
-            {}
-         }
+         boost::mutex::scoped_lock lock(mMutex);
+
+         mRecords.insert(mRecords.end(), m.addresses().begin(), m.addresses().end());
 
          if (--mQueries == 0)
          {
             mFifo.post(boost::bind(mHandler, mRecords));
-
-            mPost(this);
          }
       }
 
-      const asio::ip::address address(const resip::DnsHostRecord& r) const
-      {
-         return asio::ip::address_v4(ntohl(r.addr().s_addr));
-      }
-
-#ifdef USE_IPV6
-      const asio::ip::address address(const resip::DnsAAAARecord& r) const
-      {
-         asio::ip::address_v6::bytes_type bytes;
-         memcpy(bytes.c_array(), &r.v6Address().s6_addr, sizeof(r.v6Address().s6_addr));
-
-         return asio::ip::address_v6(bytes);
-      }
-#endif
-
-      virtual void onDnsResult(const resip::DNSResult<resip::DnsHostRecord>& r)
-      {
-         answer(r);
-      }
-
-#ifdef USE_IPV6
-      virtual void onDnsResult(const resip::DNSResult<resip::DnsAAAARecord>& r)
-      {
-         answer(r);
-      }
-#endif
+   private:
+      boost::mutex mMutex;
 
       asio::io_service& mFifo;
 
       // !cb! std::unary_function<std::vector<asio::ip::address>, void>
       //
       // It is important that your address vector parameter is not a ref&,
-      // and forces a copy, since this handler will be deleted by the time
+      // and forces a copy, since this collector will be deleted by the time
       // mHandler is called by the asio::io_service dispatcher.
       const Handler mHandler;
 
-      // !cb! std::unary_function<resip::DnsResultSink*, void> (cleanup)
-      const PostFunction mPost;
-
       unsigned int mQueries;
 
       std::vector<asio::ip::address> mRecords;
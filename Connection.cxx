@@ -3,9 +3,12 @@
 #include <functional>
 
 #include "msrp/System.hxx"
+#include "msrp/AsyncLog.hxx"
 #include "msrp/Connection.hxx"
+#include "msrp/TargetHealth.hxx"
 
 #include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/date_time/posix_time/ptime.hpp>
 #include <boost/date_time/posix_time/time_formatters.hpp>
 
@@ -52,30 +55,38 @@ Connection::Connection(io_service& service,
       const shared_ptr<ssl::context> identity) :
    mService(service), mIdentity(identity),
    mTargets(targets), mState(Disconnected),
+   mSend(use_service<BlockPool>(service)),
    mDependents(0),
-   mDisconnect(new boost::signal1<void, const asio::error&>())
+   mDisconnect(new boost::signal1<void, const asio::error&>()),
+   mInbound(&mTrace)
 {}
 
 Connection::Connection(io_service& service,
       const tcp::endpoint& bind,
       const shared_ptr<ssl::context> identity) :
-   mService(service), mIdentity(identity), mDependents(0),
-   mDisconnect(new boost::signal1<void, const asio::error&>())
+   mService(service), mIdentity(identity),
+   mSend(use_service<BlockPool>(service)), mDependents(0),
+   mDisconnect(new boost::signal1<void, const asio::error&>()),
+   mInbound(&mTrace)
 {
    mTarget = mTargets.end();
 }
 
 Connection::Connection(io_service& service, auto_ptr<tcp::socket> stream) :
-   mService(service), mTarget(mTargets.end()), mTcp(stream), mDependents(0),
-   mDisconnect(new boost::signal1<void, const asio::error&>())
+   mService(service), mTarget(mTargets.end()), mTcp(stream),
+   mSend(use_service<BlockPool>(service)), mDependents(0),
+   mDisconnect(new boost::signal1<void, const asio::error&>()),
+   mInbound(&mTrace)
 {
    init();
 }
 
 Connection::Connection(io_service& service,
       auto_ptr<ssl::stream<tcp::socket> > stream) :
-   mService(service), mTarget(mTargets.end()), mTls(stream), mDependents(0),
-   mDisconnect(new boost::signal1<void, const asio::error&>())
+   mService(service), mTarget(mTargets.end()), mTls(stream),
+   mSend(use_service<BlockPool>(service)), mDependents(0),
+   mDisconnect(new boost::signal1<void, const asio::error&>()),
+   mInbound(&mTrace)
 {
    init();
 }
@@ -118,14 +129,33 @@ Connection::init()
       mState = Connected;
 
       mTargets.push_back(remote);
+
+      cacheEndpoints();
+   }
+}
+
+void
+Connection::cacheEndpoints()
+{
+   try
+   {
+      mPeer = socket().remote_endpoint();
+      mLocal = socket().local_endpoint();
    }
+   catch (const asio::error&)
+   {}
 }
 
 Connection::~Connection()
 {
    if (active())
    {
-      WarningLog(<< "closing connection to " << peer());
+      MsrpWarningLog(<< "closing connection to " << peer());
+   }
+
+   if (mAttached != tcp::endpoint())
+   {
+      TargetHealth::instance().detach(mAttached);
    }
 }
 
@@ -172,6 +202,13 @@ Connection::context()
    return mContext;
 }
 
+// lifecycle histograms
+Trace&
+Connection::trace()
+{
+   return mTrace;
+}
+
 unsigned int
 Connection::dependents() const
 {
@@ -184,7 +221,7 @@ Connection::dependents()
    return mDependents;
 }
 
-const vector<ip::tcp::endpoint>&
+const vector<ip::tcp::endpoint>
 Connection::targets() const
 {
    ScopedLock lock(mMutex);
@@ -195,22 +232,50 @@ Connection::targets() const
 void
 Connection::pushTargets(const vector<tcp::endpoint>& ve)
 {
-   ScopedLock lock(mMutex);
+   if (ve.empty())
+   {
+      return;
+   }
 
-   bool reposition = mTarget == mTargets.end();
+   bool added = false;
 
-   mTargets.insert(mTargets.end(), ve.begin(), ve.end());
+   {
+      ScopedLock lock(mMutex);
 
-   unique(mTargets.begin(), mTargets.end());
+      // !cb! appending may reallocate, so remember the current target by index
+      const bool reposition = mTarget == mTargets.end();
+      const vector<tcp::endpoint>::size_type position = mTarget - mTargets.begin();
 
-   if (reposition)
-   {
-      mTarget = find(mTargets.begin(), mTargets.end(), ve.front());
+      for (vector<tcp::endpoint>::const_iterator i = ve.begin(); i != ve.end(); ++i)
+      {
+         if (find(mTargets.begin(), mTargets.end(), *i) == mTargets.end())
+         {
+            mTargets.push_back(*i);
+
+            added = true;
+         }
+      }
+
+      if (reposition)
+      {
+         mTarget = find(mTargets.begin(), mTargets.end(), ve.front());
+      }
+      else
+      {
+         mTarget = mTargets.begin() + position;
+      }
+
+      if (mState == Disconnected && mReconnectTimer.get() == 0)
+      {
+         connect();
+      }
    }
 
-   if (mState == Disconnected && mReconnectTimer.get() == 0)
+   // !cb! unlocked, since a ConnectionPool listening here locks itself and
+   // then reads the targets of every connection it holds
+   if (added)
    {
-      connect();
+      mTargetsAdded();
    }
 }
 
@@ -243,17 +308,8 @@ Connection::peer() const
 {
    ScopedLock lock(mMutex);
 
-   try
-   {
-      if (active())
-      {
-         return socket().remote_endpoint();
-      }
-   }
-   catch (const asio::error&)
-   {}
-
-   return tcp::endpoint();
+   // cached while connected
+   return mPeer;
 }
 
 const tcp::endpoint
@@ -261,6 +317,12 @@ Connection::local() const
 {
    ScopedLock lock(mMutex);
 
+   if (mLocal != tcp::endpoint())
+   {
+      return mLocal;
+   }
+
+   // not connected yet, though a connecting socket may be bound already
    try
    {
       if (active())
@@ -343,7 +405,7 @@ Connection::write()
    if (mTls)
    {
       async_write(*mTls,
-         mSend.const_buffers(),
+         mSend.view(),
          bind(&Connection::writeHandler,
             shared_from_this(),
             true, // buffered
@@ -353,7 +415,7 @@ Connection::write()
    else if (mTcp)
    {
       async_write(*mTcp,
-         mSend.const_buffers(),
+         mSend.view(),
          bind(&Connection::writeHandler,
             shared_from_this(),
             true, // buffered
@@ -379,13 +441,13 @@ Connection::writeHandler(bool queued, const asio::error& e, size_t bytes)
 
    if (queued)
    {
-      DebugLog(<< "sent " << bytes << " bytes from send queue to " << peer());
+      MsrpDebugLog(<< "sent " << bytes << " bytes from send queue to " << peer());
 
       mSend.shift(bytes);
    }
    else
    {
-      DebugLog(<< "sent " << bytes << " bytes to " << peer());
+      MsrpDebugLog(<< "sent " << bytes << " bytes to " << peer());
    }
 
    if (!mSend.empty())
@@ -444,7 +506,9 @@ Connection::receiveHandler(const asio::error& e, size_t bytes)
    }
    else
    {
-      DebugLog(<< "received " << bytes << " bytes from " << peer());
+      MsrpDebugLog(<< "received " << bytes << " bytes from " << peer());
+
+      mInbound.mark(Trace::Read);
 
       mBuffer.read(bytes);
 
@@ -458,9 +522,9 @@ Connection::receiveHandler(const asio::error& e, size_t bytes)
             {
                // !cb! SEND requests are the only message types that we want to
                // process before they have been completely received, because they
-               // are the only messages that may potentially exceed the message
-               // buffer size - and they may take quite a while to complete, which
-               // is not true of AUTH and REPORT requests, or responses.
+               // may take quite a while to complete, which is not true of AUTH
+               // and REPORT requests, or responses.  Those are held in the
+               // message buffer, which grows until they are complete.
                process();
             }
             break;
@@ -474,7 +538,16 @@ Connection::receiveHandler(const asio::error& e, size_t bytes)
       // !cb! handler may have closed the connection
       if (active())
       {
-         receive(mBuffer.mutableBuffer());
+         try
+         {
+            receive(mBuffer.mutableBuffer());
+         }
+         catch (const MessageBuffer::Exception& e)
+         {
+            MsrpWarningLog(<< "dropping connection to " << peer() << ": " << e);
+
+            disconnect(asio::error::no_buffer_space);
+         }
       }
    }
 }
@@ -492,12 +565,16 @@ Connection::process()
       }
       else
       {
+         mInbound.mark(Trace::Framed);
+
          if (mBuffer.state() == MessageBuffer::Complete)
          {
             shared_ptr<Message> m = mBuffer.parse(MessageBuffer::CopyContents);
             if (m)
             {
-               if (!mDemux.process(m))
+               mInbound.mark(Trace::Parsed);
+
+               if (!mDemux.process(m, &mInbound))
                {
                   reject(m, 481);
                }
@@ -508,7 +585,9 @@ Connection::process()
             shared_ptr<Message> m = mBuffer.parse(MessageBuffer::NoContents);
             if (m)
             {
-               if (mDemux.process(m))
+               mInbound.mark(Trace::Parsed);
+
+               if (mDemux.process(m, &mInbound))
                {
                   const const_buffer buffer = mBuffer.contents();
 
@@ -532,6 +611,9 @@ Connection::process()
             break;
          case MessageBuffer::Complete:
             mBuffer.reset();
+
+            // a chunk that never reached its handlers starts no later one
+            mInbound.clear();
             break;
          default:
             std::abort();
@@ -539,11 +621,11 @@ Connection::process()
    }
    catch (const ParseException& e)
    {
-      WarningLog(<< "parse exception while processing: " << e);
+      MsrpWarningLog(<< "parse exception while processing: " << e);
    }
    catch (const msrp::Exception& e)
    {
-      WarningLog(<< "unknown exception while processing: " << e);
+      MsrpWarningLog(<< "unknown exception while processing: " << e);
    }
 
    // !cb! If we can't parse the request, we ought to send a 400 response
@@ -554,7 +636,7 @@ Connection::process()
 void
 Connection::reject(shared_ptr<const Message> m, unsigned int code)
 {
-   DebugLog(<< "rejecting message with code " << code);
+   MsrpDebugLog(<< "rejecting message with code " << code);
 
    shared_ptr<Message> response = m->response(code, "Rejected");
    if (response)
@@ -571,12 +653,14 @@ Connection::send(shared_ptr<const Message> m)
    // ensure that the stream is not in the middle of sending another chunk
    mContext.clear();
 
-   stringstream ss;
-   ss << *m;
+   // !cb! encode into per-connection scratch space; send copies anything it
+   // cannot write immediately into the send queue
+   const size_t size = m->encode(0, 0);
 
-   const string& s = ss.str();
+   mEncoded.resize(size);
+   m->encode(&mEncoded[0], size);
 
-   send(const_buffer(s.c_str(), s.size()));
+   send(const_buffer(&mEncoded[0], size));
 }
 
 const tcp::endpoint
@@ -656,25 +740,27 @@ Connection::connect()
 
       mState = Connecting;
 
+      mConnectStart = posix_time::microsec_clock::universal_time();
+
       // connect
       socket().async_connect(target,
          bind(&Connection::connectHandler, shared_from_this(), placeholders::error));
 
       mConnecting(target);
 
-      InfoLog(<< "Connecting: " << local() << "->" << target);
+      MsrpInfoLog(<< "Connecting: " << local() << "->" << target);
 
       return;
    }
    catch (const asio::error& e)
    {
-      ErrLog(<< "connect asio error: " << e);
+      MsrpErrLog(<< "connect asio error: " << e);
 
       throw e;
    }
    catch (const Connection::Exception& e)
    {
-      ErrLog(<< "connect error: " << e);
+      MsrpErrLog(<< "connect error: " << e);
 
       throw e;
    }
@@ -702,12 +788,12 @@ Connection::reconnect(const deadline_timer::duration_type& duration)
       mReconnectTimer->async_wait(
          bind(&Connection::reconnectHandler, shared_from_this(), placeholders::error));
 
-      InfoLog(<< "Reconnecting at "
+      MsrpInfoLog(<< "Reconnecting at "
               << posix_time::to_simple_string(mReconnectTimer->expires_at()));
    }
    else
    {
-      InfoLog(<< "Reconnecting");
+      MsrpInfoLog(<< "Reconnecting");
 
       connect();
    }
@@ -722,16 +808,28 @@ Connection::connectHandler(const asio::error& e)
    {
       if (mState != Disconnected && e != error::operation_aborted)
       {
+         TargetHealth::instance().failed(*mTarget);
+
          disconnect(e);
       }
    }
    else
    {
-      InfoLog(<< "Connected: " << local() << "->" << peer());
-
       mState = Connected;
 
-      mConnect(peer());
+      cacheEndpoints();
+
+      MsrpInfoLog(<< "Connected: " << mLocal << "->" << peer());
+
+      const posix_time::time_duration latency =
+         posix_time::microsec_clock::universal_time() - mConnectStart;
+
+      mAttached = *mTarget;
+
+      TargetHealth::instance().connected(mAttached, latency.total_milliseconds());
+      TargetHealth::instance().attach(mAttached);
+
+      mConnect(mPeer);
 
       if (!mSend.empty())
       {
@@ -739,6 +837,8 @@ Connection::connectHandler(const asio::error& e)
       }
 
       receive(mBuffer.mutableBuffer());
+
+      sweep();
    }
 }
 
@@ -759,6 +859,41 @@ Connection::reconnectHandler(const asio::error& e)
    mReconnectTimer.reset();
 }
 
+void
+Connection::sweep()
+{
+   // a connect handler may have closed the connection already
+   if (mState != Connected)
+   {
+      return;
+   }
+
+   if (!mSweepTimer)
+   {
+      mSweepTimer.reset(new deadline_timer(service()));
+   }
+
+   mSweepTimer->expires_from_now(posix_time::seconds(static_cast<long>(SweepInterval)));
+   mSweepTimer->async_wait(
+      bind(&Connection::sweepHandler, shared_from_this(), placeholders::error));
+}
+
+void
+Connection::sweepHandler(const asio::error& e)
+{
+   ScopedLock lock(mMutex);
+
+   // cancelled, or disconnected since
+   if (e || mState != Connected)
+   {
+      return;
+   }
+
+   mDemux.sweep();
+
+   sweep();
+}
+
 void
 Connection::disconnect(const asio::error& e)
 {
@@ -767,13 +902,32 @@ Connection::disconnect(const asio::error& e)
       return;
    }
 
-   InfoLog(<< (void*)this << " Disconnected: " << e);
+   MsrpInfoLog(<< (void*)this << " Disconnected: " << e);
 
    mState = Disconnected;
 
+   if (mSweepTimer)
+   {
+      try
+      {
+         mSweepTimer->cancel();
+      }
+      catch (const asio::error&) {}
+   }
+
    mTls.reset();
    mTcp.reset();
 
+   mPeer = tcp::endpoint();
+   mLocal = tcp::endpoint();
+
+   if (mAttached != tcp::endpoint())
+   {
+      TargetHealth::instance().detach(mAttached);
+
+      mAttached = tcp::endpoint();
+   }
+
    if (e)
    {
       ++mTarget;
@@ -829,7 +983,7 @@ Connection::listen(const tcp::endpoint& endpoint)
 
    mListen(mAccept->local_endpoint());
 
-   InfoLog(<< "Listening on " << endpoint);
+   MsrpInfoLog(<< "Listening on " << endpoint);
 }
 
 void
@@ -843,13 +997,17 @@ Connection::acceptHandler(const asio::error& e)
    }
    else
    {
-      InfoLog(<< "Accepted connection from " << peer());
-
       mAccept.reset();
 
       mState = Connected;
 
-      mConnect(peer());
+      cacheEndpoints();
+
+      MsrpInfoLog(<< "Accepted connection from " << peer());
+
+      mConnect(mPeer);
+
+      sweep();
    }
 }
 
@@ -893,6 +1051,14 @@ Connection::onDisconnect()
    return *mDisconnect;
 }
 
+signal0<void>&
+Connection::onTargets()
+{
+   ScopedLock lock(mMutex);
+
+   return mTargetsAdded;
+}
+
 ostream&
 msrp::operator<<(ostream& os, const Connection& c)
 {
@@ -2,6 +2,7 @@
 #define MSRP_CONNECTION_HXX
 
 #include <list>
+#include <vector>
 
 #include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
@@ -18,6 +19,7 @@
 #include "msrp/Mutex.hxx"
 #include "msrp/Scheduler.hxx"
 #include "msrp/StreamContext.hxx"
+#include "msrp/Trace.hxx"
 
 namespace msrp
 {
@@ -74,10 +76,14 @@ class Connection :
       // outgoing stream context
       StreamContext& context();
 
+      // lifecycle histograms for this connection; see Trace
+      Trace& trace();
+
       unsigned int dependents() const;
       unsigned int& dependents();
 
-      const std::vector<asio::ip::tcp::endpoint>& targets() const;
+      // a copy, since pushTargets() may append to the list at any time
+      const std::vector<asio::ip::tcp::endpoint> targets() const;
 
       void pushTargets(const std::vector<asio::ip::tcp::endpoint>&);
 
@@ -108,6 +114,10 @@ class Connection :
       boost::signal1<void, const asio::ip::tcp::endpoint>& onConnect();
       boost::signal1<void, const asio::error&>& onDisconnect();
 
+      // targets were added by pushTargets(); fired without the connection
+      // locked
+      boost::signal0<void>& onTargets();
+
    private:
       // connect to target(s)
       Connection(asio::io_service& service,
@@ -144,13 +154,33 @@ class Connection :
 
       TcpStream::lowest_layer_type& socket() const;
 
+      // !cb! Endpoints of the connected stream, cached so that peer(),
+      // local() and log lines don't cost a system call each.
+      asio::ip::tcp::endpoint mPeer;
+      asio::ip::tcp::endpoint mLocal;
+
+      void cacheEndpoints();
+
       boost::scoped_ptr<asio::deadline_timer> mReconnectTimer;
 
+      // !cb! Sweeps the demultiplexer while connected, so entries for
+      // abandoned messages go even when no traffic arrives to sweep them.
+      enum { SweepInterval = 1 };   // seconds
+
+      boost::scoped_ptr<asio::deadline_timer> mSweepTimer;
+
+      // reported to TargetHealth
+      boost::posix_time::ptime mConnectStart;
+      asio::ip::tcp::endpoint mAttached;
+
       State mState;
 
       // outgoing send queue
       Buffer mSend;
 
+      // scratch space for encoding messages
+      std::vector<char> mEncoded;
+
       // incoming message buffer
       MessageBuffer mBuffer;
 
@@ -166,6 +196,12 @@ class Connection :
       boost::signal1<void, const asio::ip::tcp::endpoint> mConnecting;
       boost::signal1<void, const asio::ip::tcp::endpoint> mConnect;
       boost::shared_ptr< boost::signal1<void, const asio::error&> > mDisconnect;
+      boost::signal0<void> mTargetsAdded;
+
+      Trace mTrace;
+
+      // stages of the chunk being received
+      Trace::Timeline mInbound;
 
       void initOffer();
       void init();
@@ -178,6 +214,9 @@ class Connection :
       void reconnect(const asio::deadline_timer::duration_type&);
       void reconnectHandler(const asio::error&);
 
+      void sweep();
+      void sweepHandler(const asio::error&);
+
       void receiveHandler(const asio::error&, std::size_t bytes);
 
       void process();
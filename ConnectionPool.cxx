@@ -4,6 +4,7 @@
 #include <rutil/Logger.hxx>
 
 #include "msrp/System.hxx"
+#include "msrp/AsyncLog.hxx"
 #include "msrp/ConnectionPool.hxx"
 
 using namespace msrp;
@@ -14,33 +15,110 @@ using namespace asio;
 #define RESIPROCATE_SUBSYSTEM resip::Subsystem::TRANSPORT
 
 ConnectionPool::ConnectionPool(asio::io_service& ios) :
-   mService(ios)
+   mService(ios), mIndex(new Index)
 {}
 
 ConnectionPool::~ConnectionPool()
-{}
+{
+   delete mIndex.load();
+
+   for (vector<const Index*>::iterator i = mRetired.begin(); i != mRetired.end(); ++i)
+   {
+      delete *i;
+   }
+}
 
 void
 ConnectionPool::add(shared_ptr<Connection> c)
 {
+   ScopedLock lock(mMutex);
+
    mConnects.push_back(c);
 
+   publish();
+
    // automatically remove the connection from the pool on permanent disconnect
    c->onDisconnect().connect(bind(&ConnectionPool::onDisconnect, this, c, _1));
+
+   // and index the failover targets appended to it later
+   c->onTargets().connect(bind(&ConnectionPool::onTargets, this, weak_ptr<Connection>(c)));
 }
 
 void
 ConnectionPool::release(shared_ptr<Connection> c)
 {
+   ScopedLock lock(mMutex);
+
    vector<shared_ptr<Connection> >::iterator i =
       std::find(mConnects.begin(), mConnects.end(), c);
 
    if (i != mConnects.end())
    {
       mConnects.erase(i);
+
+      publish();
+   }
+}
+
+void
+ConnectionPool::publish()
+{
+   // !cb! O(connections) per add or release, which are rare next to lookups
+   Index* index = new Index;
+
+   for (vector<shared_ptr<Connection> >::const_iterator i = mConnects.begin();
+         i != mConnects.end(); ++i)
+   {
+      const vector<ip::tcp::endpoint> targets = (*i)->targets();
+
+      for (vector<ip::tcp::endpoint>::const_iterator t = targets.begin(); t != targets.end(); ++t)
+      {
+         // the oldest connection to a target wins
+         if (!index->find(*t))
+         {
+            index->set(*t, *i);
+         }
+      }
+   }
+
+   mRetired.push_back(mIndex.exchange(index));
+
+   // A reader that registers after this point can only see the new index,
+   // so with none registered now every retired index is unreachable.
+   if (mReaders.load() == 0)
+   {
+      for (vector<const Index*>::iterator i = mRetired.begin(); i != mRetired.end(); ++i)
+      {
+         delete *i;
+      }
+
+      mRetired.clear();
    }
 }
 
+shared_ptr<Connection>
+ConnectionPool::lookup(const ip::tcp::endpoint& target) const
+{
+   shared_ptr<Connection> c;
+
+   mReaders.fetchAdd(1);
+
+   if (const shared_ptr<Connection>* p = mIndex.load()->find(target))
+   {
+      c = *p;
+   }
+
+   mReaders.fetchSub(1);
+
+   if (c && !c->active())
+   {
+      // disconnected and waiting to be pruned
+      c.reset();
+   }
+
+   return c;
+}
+
 template<typename Value>
 class CompareConnection :
    public unary_function<shared_ptr<Connection>, bool>
@@ -82,14 +160,26 @@ ConnectionPool::findLocal(const asio::ip::tcp::endpoint& local) const
 bool
 ConnectionPool::member(shared_ptr<const Connection> c) const
 {
+   ScopedLock lock(mMutex);
+
    return std::find(mConnects.begin(), mConnects.end(), c) != mConnects.end();
 }
 
 void
 ConnectionPool::close()
 {
-   for (vector<shared_ptr<Connection> >::iterator i = mConnects.begin();
-         i != mConnects.end(); ++i)
+   vector<shared_ptr<Connection> > connects;
+
+   {
+      ScopedLock lock(mMutex);
+
+      connects.swap(mConnects);
+
+      publish();
+   }
+
+   for (vector<shared_ptr<Connection> >::iterator i = connects.begin();
+         i != connects.end(); ++i)
    {
       shared_ptr<Connection> c(*i);
 
@@ -98,8 +188,6 @@ ConnectionPool::close()
          c->close();
       }
    }
-
-   mConnects.clear();
 }
 
 void
@@ -114,6 +202,17 @@ ConnectionPool::onDisconnect(shared_ptr<Connection> c, const asio::error&)
    }
 }
 
+void
+ConnectionPool::onTargets(weak_ptr<Connection> c)
+{
+   ScopedLock lock(mMutex);
+
+   if (std::find(mConnects.begin(), mConnects.end(), c.lock()) != mConnects.end())
+   {
+      publish();
+   }
+}
+
 void
 ConnectionPool::conditionalRelease(shared_ptr<Connection> c)
 {
@@ -121,7 +220,7 @@ ConnectionPool::conditionalRelease(shared_ptr<Connection> c)
    {
       release(c);
 
-      DebugLog(<< "dead connection pruned from pool: " << (void*)c.get());
+      MsrpDebugLog(<< "dead connection pruned from pool: " << (void*)c.get());
    }
 }
 
@@ -4,16 +4,48 @@
 #include <asio.hpp>
 
 #include <algorithm>
+#include <vector>
 
 #include <boost/signals/trackable.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/weak_ptr.hpp>
 
+#include "msrp/Atomic.hxx"
 #include "msrp/Connection.hxx"
+#include "msrp/HashTable.hxx"
+#include "msrp/Mutex.hxx"
 #include "msrp/Uri.hxx"
 
 namespace msrp
 {
 
+template<>
+struct HashTraits<asio::ip::tcp::endpoint>
+{
+   static std::size_t hash(const asio::ip::tcp::endpoint& e)
+   {
+      std::size_t h;
+
+      if (e.address().is_v4())
+      {
+         const unsigned long a = e.address().to_v4().to_ulong();
+         h = hashBytes(reinterpret_cast<const char*>(&a), sizeof(a));
+      }
+      else
+      {
+         const asio::ip::address_v6::bytes_type a = e.address().to_v6().to_bytes();
+         h = hashBytes(reinterpret_cast<const char*>(&a[0]), a.size());
+      }
+
+      return h ^ e.port();
+   }
+
+   static bool equal(const asio::ip::tcp::endpoint& a, const asio::ip::tcp::endpoint& b)
+   {
+      return a == b;
+   }
+};
+
 class Session;
 
 class ConnectionPool :
@@ -35,6 +67,13 @@ class ConnectionPool :
 
       void release(boost::shared_ptr<Connection>);
 
+      // !cb! Lock-free: returns a live connection with the target in its
+      // target list, whether or not it has connected yet.  Readers search an
+      // immutable index that add(), release() and a pooled connection's
+      // pushTargets() replace; an index is only deleted once no reader can
+      // still be inside it.
+      boost::shared_ptr<Connection> lookup(const asio::ip::tcp::endpoint& target) const;
+
       boost::shared_ptr<Connection> find(const asio::ip::tcp::endpoint& peer) const;
 
       boost::shared_ptr<Connection> find(const asio::ip::address& addr) const;
@@ -44,6 +83,8 @@ class ConnectionPool :
       template<typename Predicate>
       boost::shared_ptr<Connection> find_if(const Predicate& p) const
       {
+         ScopedLock lock(mMutex);
+
          std::vector<boost::shared_ptr<Connection> >::const_iterator i =
             std::find_if(mConnects.begin(), mConnects.end(), p);
 
@@ -61,12 +102,26 @@ class ConnectionPool :
 
    private:
       void onDisconnect(boost::shared_ptr<Connection>, const asio::error&);
+      void onTargets(boost::weak_ptr<Connection>);
 
       void conditionalRelease(boost::shared_ptr<Connection>);
 
+      typedef HashTable<asio::ip::tcp::endpoint, boost::shared_ptr<Connection> > Index;
+
+      // rebuild the index from mConnects; called with mMutex held
+      void publish();
+
+      mutable Mutex mMutex;
+
       asio::io_service& mService;
 
       std::vector<boost::shared_ptr<Connection> > mConnects;
+
+      Atomic<const Index*> mIndex;
+      mutable Atomic<unsigned int> mReaders;
+
+      // replaced indexes that a reader may still be searching
+      std::vector<const Index*> mRetired;
 };
 
 }
@@ -8,6 +8,7 @@
 #include <rutil/Logger.hxx>
 
 #include "msrp/System.hxx"
+#include "msrp/AsyncLog.hxx"
 #include "msrp/IncomingMessage.hxx"
 #include "msrp/Demultiplex.hxx"
 #include "msrp/OutgoingMessage.hxx"
@@ -22,7 +23,7 @@ using namespace boost;
 using namespace asio;
 
 Demultiplex::Demultiplex() :
-   mContext(mMessages.end())
+   mMessageSweep(0), mReportSweep(0), mStreaming(false)
 {}
 
 void
@@ -30,7 +31,7 @@ Demultiplex::insert(shared_ptr<Session> s)
 {
    for (Path::const_iterator i = s->address().begin(); i != s->address().end(); ++i)
    {
-      mTargets[*i] = weak_ptr<Session>(s);
+      mTargets.set(*i, weak_ptr<Session>(s));
    }
 }
 
@@ -44,9 +45,9 @@ Demultiplex::remove(shared_ptr<Session> s)
 }
 
 void
-Demultiplex::remove(const vector<Uri>& us)
+Demultiplex::remove(const Path& us)
 {
-   for (vector<Uri>::const_iterator i = us.begin(); i != us.end(); ++i)
+   for (Path::const_iterator i = us.begin(); i != us.end(); ++i)
    {
       mTargets.erase(*i);
    }
@@ -55,7 +56,7 @@ Demultiplex::remove(const vector<Uri>& us)
 void
 Demultiplex::insert(shared_ptr<IncomingMessage> m)
 {
-   mMessages[m->messageId()] = m;
+   mMessages.set(m->messageId(), m);
 }
 
 void
@@ -67,7 +68,7 @@ Demultiplex::remove(shared_ptr<IncomingMessage> m)
 void
 Demultiplex::insert(boost::shared_ptr<OutgoingMessage> m)
 {
-   mReports[m->messageId()] = m;
+   mReports.set(m->messageId(), m);
 }
 
 void
@@ -77,7 +78,7 @@ Demultiplex::remove(boost::shared_ptr<OutgoingMessage> m)
 }
 
 bool
-Demultiplex::process(shared_ptr<const Message> m)
+Demultiplex::process(shared_ptr<const Message> m, Trace::Timeline* timeline)
 {
    // ``The receiving endpoint MUST first check the URI in the To-Path
    //   to make sure the request belongs to an existing session.  When
@@ -86,63 +87,86 @@ Demultiplex::process(shared_ptr<const Message> m)
    //   the connection on which the request arrived.  If this is not
    //   true, the receiver MUST generate a 481 error and ignore the
    //   request.''
-   const Path& to = m->header<ToPath>();
+   Uri to;
 
-   if (to.empty())
+   if (!m->pathAt<ToPath>(0, to))
    {
+      MsrpErrLog(<< "message contains no To-Path; rejected msg");
+
       return false;
    }
 
-   TargetMap::iterator i = mTargets.find(to.front());
-   if (i == mTargets.end())
+   const weak_ptr<Session>* target = mTargets.find(to);
+   if (!target)
    {
-      ErrLog(<< "unknown target: " << to.front() << "; rejected msg");
+      MsrpErrLog(<< "unknown target: " << to << "; rejected msg");
 
       return false;
    }
 
-   if (m->exists<MessageId>())
+   // the table may change under the handlers below
+   const weak_ptr<Session> route = *target;
+
+   if (timeline)
    {
-      const string& id = m->header<MessageId>();
+      timeline->mark(Trace::Demuxed);
+   }
+
+   sweep();
 
-      MessageMap::iterator mi = mMessages.find(id);
-      if (mi != mMessages.end())
+   HeaderTable::Range id;
+
+   if (messageId(*m, id))
+   {
+      const weak_ptr<IncomingMessage>* mi = mMessages.find(id);
+      if (mi)
       {
          try
          {
-            shared_ptr<IncomingMessage> incoming(mi->second);
+            shared_ptr<IncomingMessage> incoming(*mi);
 
             if (incoming->process(m))
             {
+               if (timeline)
+               {
+                  timeline->mark(Trace::Delivered);
+               }
+
                return true;
             }
          }
          catch (const bad_weak_ptr&)
          {
-            WarningLog(<< "message session " << id << " defunct");
+            MsrpWarningLog(<< "message session " << string(id.begin(), id.end()) << " defunct");
 
-            mMessages.erase(mi);
+            mMessages.erase(id);
          }
       }
       else if (m->method() == Message::REPORT)
       {
-         ReportMap::iterator ri = mReports.find(id);
-         if (ri != mReports.end())
+         const weak_ptr<OutgoingMessage>* ri = mReports.find(id);
+         if (ri)
          {
             try
             {
-               shared_ptr<OutgoingMessage> outgoing(ri->second);
+               shared_ptr<OutgoingMessage> outgoing(*ri);
 
                if (outgoing->process(m))
                {
+                  if (timeline)
+                  {
+                     timeline->mark(Trace::Delivered);
+                  }
+
                   return true;
                }
             }
             catch (const bad_weak_ptr&)
             {
-               WarningLog(<< "outgoing message " << id << " defunct, report dropped");
+               MsrpWarningLog(<< "outgoing message " << string(id.begin(), id.end())
+                  << " defunct, report dropped");
 
-               mReports.erase(ri);
+               mReports.erase(id);
             }
          }
       }
@@ -151,34 +175,34 @@ Demultiplex::process(shared_ptr<const Message> m)
    {
       if (m->method() == Message::SEND)
       {
-         ErrLog(<< "SEND request lacks Message-Id; rejected msg");
+         MsrpErrLog(<< "SEND request lacks Message-Id; rejected msg");
 
          return false;
       }
    }
 
-   if (!m->exists<ToPath>() || m->header<ToPath>().empty())
-   {
-      ErrLog(<< "message contains no To-Path; rejected msg");
-
-      return false;
-   }
-
    try
    {
-      shared_ptr<Session> session(i->second);
+      shared_ptr<Session> session(route);
       shared_ptr<IncomingMessage> incoming = session->process(m);
 
       if (incoming)
       {
          insert(incoming);
 
-         mContext = mMessages.find(incoming->messageId());
+         mStreaming = true;
+         mContextId = incoming->messageId();
+         mContext = incoming;
+      }
+
+      if (timeline)
+      {
+         timeline->mark(Trace::Delivered);
       }
    }
    catch (const bad_weak_ptr&)
    {
-      WarningLog(<< "session defunct: " << i->first << "; rejected msg");
+      MsrpWarningLog(<< "session defunct: " << to << "; rejected msg");
 
       return false;
    }
@@ -189,7 +213,7 @@ Demultiplex::process(shared_ptr<const Message> m)
 bool
 Demultiplex::process(const const_buffer& buffer, const Message::MsgStatus status)
 {
-   if (mContext == mMessages.end())
+   if (!mStreaming)
    {
       return false;
    }
@@ -198,7 +222,7 @@ Demultiplex::process(const const_buffer& buffer, const Message::MsgStatus status
 
    try
    {
-      shared_ptr<IncomingMessage> i(mContext->second);
+      shared_ptr<IncomingMessage> i(mContext);
 
       if (buffer_size(buffer) == 0 || i->process(buffer))
       {
@@ -231,14 +255,79 @@ Demultiplex::process(const const_buffer& buffer, const Message::MsgStatus status
 
    if (erase)
    {
-      mMessages.erase(mContext);
-
-      mContext = mMessages.end();
+      endContext();
    }
 
    return true;
 }
 
+void
+Demultiplex::endContext()
+{
+   mMessages.erase(mContextId);
+
+   mStreaming = false;
+   mContextId.clear();
+   mContext.reset();
+}
+
+namespace
+{
+
+// Walk at most slots entries of the table from cursor, erasing expired
+// weak_ptrs.  Erasing may pull a later entry into the current slot, so the
+// cursor only advances past live or empty slots.
+template<typename Table>
+void
+sweepTable(Table& table, size_t& cursor, size_t slots)
+{
+   for (; slots > 0 && !table.empty(); --slots)
+   {
+      if (cursor >= table.capacity())
+      {
+         cursor = 0;
+      }
+
+      if (table.occupied(cursor) && table.valueAt(cursor).expired())
+      {
+         table.eraseAt(cursor);
+      }
+      else
+      {
+         ++cursor;
+      }
+   }
+}
+
+}
+
+void
+Demultiplex::sweep(size_t slots)
+{
+   sweepTable(mMessages, mMessageSweep, slots);
+   sweepTable(mReports, mReportSweep, slots);
+}
+
+bool
+Demultiplex::messageId(const Message& m, HeaderTable::Range& id)
+{
+   if (m.raw<MessageId>(id))
+   {
+      return true;
+   }
+
+   if (m.exists<MessageId>())
+   {
+      const string& value = m.header<MessageId>();
+
+      id = HeaderTable::Range(value.data(), value.data() + value.size());
+
+      return true;
+   }
+
+   return false;
+}
+
 // Copyright 2007 Chris Bond
 // 
 // Permission is hereby granted, free of charge, to any person or organization
@@ -1,7 +1,6 @@
 #ifndef MSRP_DEMULTIPLEX_HXX
 #define MSRP_DEMULTIPLEX_HXX
 
-#include <map>
 #include <string>
 
 #include <boost/noncopyable.hpp>
@@ -9,7 +8,9 @@
 #include <boost/weak_ptr.hpp>
 
 #include "msrp/Exception.hxx"
+#include "msrp/HashTable.hxx"
 #include "msrp/Message.hxx"
+#include "msrp/Trace.hxx"
 #include "msrp/Uri.hxx"
 
 namespace msrp
@@ -40,7 +41,7 @@ class Demultiplex : private boost::noncopyable
       void insert(boost::shared_ptr<Session>);
       void remove(boost::shared_ptr<Session>);
 
-      void remove(const std::vector<Uri>&);
+      void remove(const Path&);
 
       // route based on Message-ID
       void insert(boost::shared_ptr<IncomingMessage>);
@@ -50,26 +51,79 @@ class Demultiplex : private boost::noncopyable
       void insert(boost::shared_ptr<OutgoingMessage>);
       void remove(boost::shared_ptr<OutgoingMessage>);
 
-      bool process(boost::shared_ptr<const Message>);
+      // marks the Demuxed and Delivered stages on the timeline, if any
+      bool process(boost::shared_ptr<const Message>, Trace::Timeline* = 0);
 
       bool process(const asio::const_buffer&, const Message::MsgStatus);
 
       bool streaming() const
       {
-         return mContext != mMessages.end();
+         return mStreaming;
       }
 
+      // Drop up to the given number of table slots' worth of defunct
+      // message and report entries.  Called with a small budget for every
+      // message processed, and by the owning Connection on a timer so that
+      // an idle connection reclaims them too.
+      void sweep(std::size_t slots = Sweep);
+
    private:
-      typedef std::map<Uri, boost::weak_ptr<Session> > TargetMap;
+      enum { Sweep = 8 };
+
+      // !cb! To-Path URIs match on their routing key only
+      struct RouteTraits
+      {
+         static std::size_t hash(const Uri& u) { return u.hash(); }
+         static bool equal(const Uri& a, const Uri& b) { return a.key() == b.key(); }
+      };
+
+      typedef HashTable<Uri, boost::weak_ptr<Session>, RouteTraits> TargetMap;
       TargetMap mTargets;
 
-      typedef std::map<std::string, boost::weak_ptr<IncomingMessage> > MessageMap;
+      // !cb! Message-IDs are stored once per message and looked up by the
+      // raw header range, so routing a chunk doesn't copy its Message-ID
+      struct IdTraits
+      {
+         static std::size_t hash(const std::string& s)
+         {
+            return hashBytes(s.data(), s.size());
+         }
+
+         static std::size_t hash(const HeaderTable::Range& r)
+         {
+            return hashBytes(r.begin(), r.size());
+         }
+
+         static bool equal(const std::string& a, const std::string& b)
+         {
+            return a == b;
+         }
+
+         static bool equal(const std::string& a, const HeaderTable::Range& b)
+         {
+            return a.size() == static_cast<std::size_t>(b.size())
+               && a.compare(0, a.size(), b.begin(), b.size()) == 0;
+         }
+      };
+
+      typedef HashTable<std::string, boost::weak_ptr<IncomingMessage>, IdTraits> MessageMap;
       MessageMap mMessages;
 
-      typedef std::map<std::string, boost::weak_ptr<OutgoingMessage> > ReportMap;
+      typedef HashTable<std::string, boost::weak_ptr<OutgoingMessage>, IdTraits> ReportMap;
       ReportMap mReports;
 
-      MessageMap::iterator mContext;
+      std::size_t mMessageSweep;
+      std::size_t mReportSweep;
+
+      // message whose contents are being streamed
+      bool mStreaming;
+      std::string mContextId;
+      boost::weak_ptr<IncomingMessage> mContext;
+
+      void endContext();
+
+      // the Message-ID as it appears on the wire, if present
+      static bool messageId(const Message&, HeaderTable::Range&);
 };
 
 }
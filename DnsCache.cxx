@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <cctype>
+
+#include "msrp/System.hxx"
+#include "msrp/DnsCache.hxx"
+
+using namespace msrp;
+using namespace std;
+using namespace boost;
+
+DnsCache::DnsCache()
+{}
+
+const string
+DnsCache::key(const string& name, unsigned short type)
+{
+   string k;
+   k.reserve(name.size() + 2);
+
+   k += static_cast<char>(type >> 8);
+   k += static_cast<char>(type & 0xff);
+
+   string::const_iterator end = name.end();
+   if (!name.empty() && name[name.size() - 1] == '.')
+   {
+      --end;
+   }
+
+   for (string::const_iterator i = name.begin(); i != end; ++i)
+   {
+      k += static_cast<char>(tolower(static_cast<unsigned char>(*i)));
+   }
+
+   return k;
+}
+
+bool
+DnsCache::find(const string& name, unsigned short type, DnsMessage& m)
+{
+   const string k = key(name, type);
+   const time_t now = time(0);
+
+   mutex::scoped_lock lock(mMutex);
+
+   Entry* e = mEntries.find(k);
+   if (!e)
+   {
+      return false;
+   }
+
+   if (e->expires <= now)
+   {
+      mEntries.erase(k);
+
+      return false;
+   }
+
+   m = e->message;
+
+   const unsigned long left = static_cast<unsigned long>(e->expires - now);
+
+   if (m.answered())
+   {
+      m.ttl() = left;
+   }
+   else
+   {
+      m.negativeTtl() = left;
+   }
+
+   return true;
+}
+
+void
+DnsCache::insert(const DnsMessage& m)
+{
+   unsigned long ttl = 0;
+
+   if (m.answered())
+   {
+      ttl = std::min<unsigned long>(m.ttl(), MaxTtl);
+   }
+   else if (m.rcode() == DnsMessage::NameError || m.rcode() == DnsMessage::NoError)
+   {
+      ttl = std::min<unsigned long>(m.negativeTtl(), MaxNegativeTtl);
+   }
+
+   if (ttl == 0)
+   {
+      return;
+   }
+
+   const string k = key(m.name(), m.type());
+   const time_t now = time(0);
+
+   mutex::scoped_lock lock(mMutex);
+
+   if (mEntries.size() >= Limit && !mEntries.find(k))
+   {
+      purge(now);
+   }
+
+   Entry& e = mEntries[k];
+   e.expires = now + ttl;
+   e.message = m;
+}
+
+void
+DnsCache::clear()
+{
+   mutex::scoped_lock lock(mMutex);
+
+   mEntries.clear();
+}
+
+size_t
+DnsCache::size() const
+{
+   mutex::scoped_lock lock(mMutex);
+
+   return mEntries.size();
+}
+
+void
+DnsCache::purge(time_t now)
+{
+   // !cb! eraseAt() may pull a later entry into the slot, so only move on
+   // when nothing was erased
+   for (size_t i = 0; i < mEntries.capacity(); )
+   {
+      if (mEntries.occupied(i) && mEntries.valueAt(i).expires <= now)
+      {
+         mEntries.eraseAt(i);
+      }
+      else
+      {
+         ++i;
+      }
+   }
+
+   if (mEntries.size() >= Limit)
+   {
+      mEntries.clear();
+   }
+}
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
@@ -0,0 +1,91 @@
+#ifndef MSRP_DNSCACHE_HXX
+#define MSRP_DNSCACHE_HXX
+
+#include <cstddef>
+#include <ctime>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "msrp/DnsMessage.hxx"
+#include "msrp/HashTable.hxx"
+
+namespace msrp
+{
+
+// !cb! Answers keyed by (name, type).  Positive answers are kept for the
+// smallest TTL among their records; NXDOMAIN and empty answers are kept for
+// the negative TTL of the SOA that came with them (RFC 2308), and not at
+// all without one.  Server failures and timeouts are never cached.  TTLs are
+// capped so that a bad record cannot pin an entry, and entries handed out
+// carry the TTL they have left.
+
+class DnsCache : private boost::noncopyable
+{
+   public:
+      enum
+      {
+         Limit = 4096,
+         MaxTtl = 86400,
+         MaxNegativeTtl = 900
+      };
+
+      DnsCache();
+
+      bool find(const std::string& name, unsigned short type, DnsMessage&);
+
+      void insert(const DnsMessage&);
+
+      void clear();
+
+      std::size_t size() const;
+
+      // case-folded name without a trailing dot, and the type
+      static const std::string key(const std::string& name, unsigned short type);
+
+   private:
+      struct Entry
+      {
+         Entry() : expires(0) {}
+
+         std::time_t expires;
+         DnsMessage message;
+      };
+
+      typedef HashTable<std::string, Entry> Table;
+
+      void purge(std::time_t now);
+
+      mutable boost::mutex mMutex;
+
+      Table mEntries;
+};
+
+}
+
+#endif
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
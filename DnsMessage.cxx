@@ -0,0 +1,487 @@
+#include <cstring>
+
+#include <boost/algorithm/string.hpp>
+
+#include "msrp/System.hxx"
+#include "msrp/DnsMessage.hxx"
+#include "msrp/Encode.hxx"
+
+using namespace msrp;
+using namespace std;
+
+namespace
+{
+
+enum
+{
+   HeaderSize = 12,
+   ClassIn = 1,
+   MaxName = 255,
+   MaxLabel = 63,
+   MaxJumps = 16
+};
+
+void
+put16(Writer& w, unsigned int v)
+{
+   w.put(static_cast<char>((v >> 8) & 0xff));
+   w.put(static_cast<char>(v & 0xff));
+}
+
+void
+put32(Writer& w, unsigned long v)
+{
+   put16(w, (v >> 16) & 0xffff);
+   put16(w, v & 0xffff);
+}
+
+void
+putName(Writer& w, const string& name)
+{
+   string::size_type begin = 0;
+
+   while (begin < name.size())
+   {
+      string::size_type end = name.find('.', begin);
+      if (end == string::npos)
+      {
+         end = name.size();
+      }
+
+      w.put(static_cast<char>(end - begin));
+      w.write(name.data() + begin, end - begin);
+
+      begin = end + 1;
+   }
+
+   w.put(0);
+}
+
+// !cb! Bounds-checked reader over a received message.  Any read past the end
+// clears ok(), so decode() can check once per record instead of per field.
+class Reader
+{
+   public:
+      Reader(const unsigned char* data, size_t size) :
+         mData(data), mSize(size), mPos(0), mOk(true)
+      {}
+
+      bool ok() const { return mOk; }
+      size_t pos() const { return mPos; }
+
+      void skip(size_t n)
+      {
+         if (mPos + n > mSize)
+         {
+            mOk = false;
+            mPos = mSize;
+         }
+         else
+         {
+            mPos += n;
+         }
+      }
+
+      unsigned int get8()
+      {
+         if (mPos + 1 > mSize)
+         {
+            mOk = false;
+            return 0;
+         }
+
+         return mData[mPos++];
+      }
+
+      unsigned int get16()
+      {
+         const unsigned int hi = get8();
+         return (hi << 8) | get8();
+      }
+
+      unsigned long get32()
+      {
+         const unsigned long hi = get16();
+         return (hi << 16) | get16();
+      }
+
+      const unsigned char* at() const { return mData + mPos; }
+
+      // Reads a possibly compressed name.  Compression pointers may only
+      // point backwards, and the number of jumps is bounded, so a hostile
+      // message cannot loop.
+      string name()
+      {
+         string result;
+
+         size_t pos = mPos;
+         bool jumped = false;
+
+         for (unsigned int jumps = 0; mOk; )
+         {
+            if (pos >= mSize)
+            {
+               mOk = false;
+               break;
+            }
+
+            const unsigned int length = mData[pos];
+
+            if ((length & 0xc0) == 0xc0)
+            {
+               if (pos + 1 >= mSize || ++jumps > MaxJumps)
+               {
+                  mOk = false;
+                  break;
+               }
+
+               const size_t target = ((length & 0x3f) << 8) | mData[pos + 1];
+               if (target >= pos)
+               {
+                  mOk = false;
+                  break;
+               }
+
+               if (!jumped)
+               {
+                  mPos = pos + 2;
+                  jumped = true;
+               }
+
+               pos = target;
+            }
+            else if (length & 0xc0)
+            {
+               mOk = false;
+            }
+            else if (length == 0)
+            {
+               if (!jumped)
+               {
+                  mPos = pos + 1;
+               }
+
+               break;
+            }
+            else
+            {
+               if (pos + 1 + length > mSize || result.size() + length + 1 > MaxName)
+               {
+                  mOk = false;
+                  break;
+               }
+
+               if (!result.empty())
+               {
+                  result += '.';
+               }
+
+               result.append(reinterpret_cast<const char*>(mData + pos + 1), length);
+
+               pos += length + 1;
+            }
+         }
+
+         return result;
+      }
+
+   private:
+      const unsigned char* mData;
+      size_t mSize;
+      size_t mPos;
+      bool mOk;
+};
+
+}
+
+bool
+SrvRecord::operator==(const SrvRecord& rhs) const
+{
+   return mPriority == rhs.mPriority
+      && mWeight == rhs.mWeight
+      && mPort == rhs.mPort
+      && boost::algorithm::iequals(mTarget, rhs.mTarget);
+}
+
+ostream&
+msrp::operator<<(ostream& os, const SrvRecord& srv)
+{
+   return os << "pri " << srv.priority()
+             << " weight " << srv.weight()
+             << " port " << srv.port()
+             << " target " << srv.target();
+}
+
+DnsMessage::DnsMessage() :
+   mId(0),
+   mResponse(false),
+   mTruncated(false),
+   mRcode(NoError),
+   mType(A),
+   mTtl(0),
+   mNegativeTtl(0)
+{}
+
+bool
+DnsMessage::answered() const
+{
+   if (mRcode != NoError)
+   {
+      return false;
+   }
+
+   return mType == SRV ? !mServices.empty() : !mAddresses.empty();
+}
+
+bool
+DnsMessage::valid(const string& name)
+{
+   if (name.empty() || name.size() > MaxName - 2)
+   {
+      return false;
+   }
+
+   string::size_type begin = 0;
+
+   while (begin < name.size())
+   {
+      string::size_type end = name.find('.', begin);
+      if (end == string::npos)
+      {
+         end = name.size();
+      }
+
+      if (end == begin || end - begin > MaxLabel)
+      {
+         return false;
+      }
+
+      begin = end + 1;
+   }
+
+   return true;
+}
+
+size_t
+DnsMessage::encode(char* buffer, size_t size) const
+{
+   Writer w(buffer, size);
+
+   unsigned int answers = 0;
+   for (vector<asio::ip::address>::const_iterator i = mAddresses.begin(); i != mAddresses.end(); ++i)
+   {
+      if (i->is_v4() == (mType == A))
+      {
+         ++answers;
+      }
+   }
+
+   if (mType == SRV)
+   {
+      answers = mServices.size();
+   }
+
+   put16(w, mId);
+
+   // QR, opcode QUERY, RD; RA on responses
+   put16(w, (mResponse ? 0x8080 : 0) | (mTruncated ? 0x0200 : 0) | 0x0100 | (mRcode & 0xf));
+
+   put16(w, 1);
+   put16(w, answers);
+   put16(w, mNegativeTtl ? 1 : 0);
+   put16(w, 0);
+
+   putName(w, mName);
+   put16(w, mType);
+   put16(w, ClassIn);
+
+   if (mType == SRV)
+   {
+      for (vector<SrvRecord>::const_iterator i = mServices.begin(); i != mServices.end(); ++i)
+      {
+         Writer count;
+         putName(count, i->target());
+
+         putName(w, mName);
+         put16(w, SRV);
+         put16(w, ClassIn);
+         put32(w, mTtl);
+         put16(w, 6 + count.size());
+         put16(w, i->priority());
+         put16(w, i->weight());
+         put16(w, i->port());
+         putName(w, i->target());
+      }
+   }
+   else
+   {
+      for (vector<asio::ip::address>::const_iterator i = mAddresses.begin(); i != mAddresses.end(); ++i)
+      {
+         if (i->is_v4() != (mType == A))
+         {
+            continue;
+         }
+
+         putName(w, mName);
+         put16(w, mType);
+         put16(w, ClassIn);
+         put32(w, mTtl);
+
+         if (i->is_v4())
+         {
+            put16(w, 4);
+            put32(w, i->to_v4().to_ulong());
+         }
+         else
+         {
+            const asio::ip::address_v6::bytes_type bytes = i->to_v6().to_bytes();
+
+            put16(w, bytes.size());
+            w.write(reinterpret_cast<const char*>(&bytes[0]), bytes.size());
+         }
+      }
+   }
+
+   if (mNegativeTtl)
+   {
+      // minimal SOA for the root; only its TTL and MINIMUM matter here
+      putName(w, string());
+      put16(w, SOA);
+      put16(w, ClassIn);
+      put32(w, mNegativeTtl);
+      put16(w, 2 + 5 * 4);
+      putName(w, string());
+      putName(w, string());
+      put32(w, 1);
+      put32(w, 3600);
+      put32(w, 600);
+      put32(w, 86400);
+      put32(w, mNegativeTtl);
+   }
+
+   return w.size();
+}
+
+bool
+DnsMessage::decode(const char* data, size_t size)
+{
+   mAddresses.clear();
+   mServices.clear();
+   mTtl = 0;
+   mNegativeTtl = 0;
+
+   Reader r(reinterpret_cast<const unsigned char*>(data), size);
+
+   mId = r.get16();
+
+   const unsigned int flags = r.get16();
+   mResponse = (flags & 0x8000) != 0;
+   mTruncated = (flags & 0x0200) != 0;
+   mRcode = flags & 0xf;
+
+   const unsigned int questions = r.get16();
+   const unsigned int answers = r.get16();
+   const unsigned int authority = r.get16();
+   r.get16();
+
+   if (!r.ok() || questions != 1)
+   {
+      return false;
+   }
+
+   mName = r.name();
+   mType = r.get16();
+   r.get16();
+
+   bool first = true;
+
+   for (unsigned int i = 0; i < answers + authority && r.ok(); ++i)
+   {
+      r.name();
+
+      const unsigned int type = r.get16();
+      r.get16();
+      const unsigned long ttl = r.get32();
+      const unsigned int length = r.get16();
+
+      if (!r.ok())
+      {
+         break;
+      }
+
+      const size_t end = r.pos() + length;
+
+      if (i >= answers)
+      {
+         if (type == SOA)
+         {
+            r.name();
+            r.name();
+            r.skip(4 * 4);
+
+            const unsigned long minimum = r.get32();
+            mNegativeTtl = std::min(ttl, minimum);
+         }
+      }
+      else if (type == mType || type == CNAME)
+      {
+         if (type == A && length == 4)
+         {
+            mAddresses.push_back(asio::ip::address_v4(r.get32()));
+         }
+         else if (type == AAAA && length == 16)
+         {
+            asio::ip::address_v6::bytes_type bytes;
+            std::memcpy(&bytes[0], r.at(), bytes.size());
+
+            mAddresses.push_back(asio::ip::address_v6(bytes));
+         }
+         else if (type == SRV)
+         {
+            SrvRecord srv;
+            srv.priority() = r.get16();
+            srv.weight() = r.get16();
+            srv.port() = r.get16();
+            srv.target() = r.name();
+
+            mServices.push_back(srv);
+         }
+
+         mTtl = first ? ttl : std::min(mTtl, ttl);
+         first = false;
+      }
+
+      if (!r.ok() || r.pos() > end)
+      {
+         return false;
+      }
+
+      // skip whatever of the record was not read
+      r.skip(end - r.pos());
+   }
+
+   return r.ok();
+}
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
@@ -0,0 +1,174 @@
+#ifndef MSRP_DNSMESSAGE_HXX
+#define MSRP_DNSMESSAGE_HXX
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <asio/ip/address.hpp>
+
+namespace msrp
+{
+
+class SrvRecord
+{
+   public:
+      SrvRecord() :
+         mPriority(0), mWeight(0), mPort(0)
+      {}
+
+      SrvRecord(unsigned short priority, unsigned short weight,
+            unsigned short port, const std::string& target) :
+         mPriority(priority), mWeight(weight), mPort(port), mTarget(target)
+      {}
+
+      unsigned short priority() const { return mPriority; }
+      unsigned short& priority() { return mPriority; }
+
+      unsigned short weight() const { return mWeight; }
+      unsigned short& weight() { return mWeight; }
+
+      unsigned short port() const { return mPort; }
+      unsigned short& port() { return mPort; }
+
+      const std::string& target() const { return mTarget; }
+      std::string& target() { return mTarget; }
+
+      bool operator==(const SrvRecord&) const;
+
+   private:
+      unsigned short mPriority;
+      unsigned short mWeight;
+      unsigned short mPort;
+
+      std::string mTarget;
+};
+
+std::ostream&
+operator<<(std::ostream&, const SrvRecord&);
+
+// !cb! RFC 1035 message with a single question.  Only the parts a resolver
+// needs are kept: answers of the question type (CNAMEs in front of them are
+// followed implicitly, since recursive servers return the whole chain), the
+// smallest TTL among them, and the RFC 2308 negative TTL from an SOA in the
+// authority section.  encode() writes the same subset, which is enough for
+// queries and for the stub server in the tests.
+
+class DnsMessage
+{
+   public:
+      enum Type
+      {
+         A     = 1,
+         CNAME = 5,
+         SOA   = 6,
+         AAAA  = 28,
+         SRV   = 33
+      };
+
+      enum Rcode
+      {
+         NoError       = 0,
+         FormatError   = 1,
+         ServerFailure = 2,
+         NameError     = 3,
+
+         // local: no server answered
+         Timeout       = 0x100
+      };
+
+      enum { MaxSize = 512 };
+
+      DnsMessage();
+
+      unsigned short id() const { return mId; }
+      unsigned short& id() { return mId; }
+
+      bool response() const { return mResponse; }
+      bool& response() { return mResponse; }
+
+      bool truncated() const { return mTruncated; }
+      bool& truncated() { return mTruncated; }
+
+      unsigned int rcode() const { return mRcode; }
+      unsigned int& rcode() { return mRcode; }
+
+      // question
+      const std::string& name() const { return mName; }
+      std::string& name() { return mName; }
+
+      unsigned short type() const { return mType; }
+      unsigned short& type() { return mType; }
+
+      // answers
+      unsigned long ttl() const { return mTtl; }
+      unsigned long& ttl() { return mTtl; }
+
+      const std::vector<asio::ip::address>& addresses() const { return mAddresses; }
+      std::vector<asio::ip::address>& addresses() { return mAddresses; }
+
+      const std::vector<SrvRecord>& services() const { return mServices; }
+      std::vector<SrvRecord>& services() { return mServices; }
+
+      // zero if the authority section holds no SOA
+      unsigned long negativeTtl() const { return mNegativeTtl; }
+      unsigned long& negativeTtl() { return mNegativeTtl; }
+
+      // true if the message answers the question with at least one record
+      bool answered() const;
+
+      // true if the name can be encoded as a question
+      static bool valid(const std::string& name);
+
+      // Writes at most size bytes and returns the number of bytes the
+      // encoding needs, as Message::encode does.
+      std::size_t encode(char* buffer, std::size_t size) const;
+
+      // false if the message is malformed
+      bool decode(const char* data, std::size_t size);
+
+   private:
+      unsigned short mId;
+      bool mResponse;
+      bool mTruncated;
+      unsigned int mRcode;
+
+      std::string mName;
+      unsigned short mType;
+
+      unsigned long mTtl;
+
+      std::vector<asio::ip::address> mAddresses;
+      std::vector<SrvRecord> mServices;
+
+      unsigned long mNegativeTtl;
+};
+
+}
+
+#endif
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
@@ -0,0 +1,373 @@
+#include <fstream>
+#include <sstream>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+
+#include <rutil/Logger.hxx>
+#include <rutil/Random.hxx>
+
+#include "msrp/System.hxx"
+#include "msrp/AsyncLog.hxx"
+#include "msrp/DnsResolver.hxx"
+
+using namespace msrp;
+using namespace std;
+using namespace boost;
+using namespace asio;
+using namespace asio::ip;
+
+#define RESIPROCATE_SUBSYSTEM resip::Subsystem::DNS
+
+DnsResolver::DnsResolver(io_service& ios) :
+   mService(ios)
+{
+   ifstream conf("/etc/resolv.conf");
+
+   string line;
+   while (getline(conf, line))
+   {
+      istringstream is(line);
+
+      string key;
+      string server;
+
+      if (is >> key >> server && key == "nameserver")
+      {
+         try
+         {
+            const address a = address::from_string(server);
+
+            if (a.is_v4())
+            {
+               mServers.push_back(udp::endpoint(a, Port));
+            }
+         }
+         catch (const asio::error&)
+         {
+            MsrpWarningLog(<< "ignoring nameserver " << server);
+         }
+      }
+   }
+
+   if (mServers.empty())
+   {
+      mServers.push_back(udp::endpoint(address_v4::loopback(), Port));
+   }
+}
+
+DnsResolver::~DnsResolver()
+{}
+
+void
+DnsResolver::nameservers(const vector<udp::endpoint>& servers)
+{
+   if (servers.empty())
+   {
+      MsrpWarningLog(<< "ignoring empty nameserver list");
+      return;
+   }
+
+   mutex::scoped_lock lock(mMutex);
+
+   mServers = servers;
+}
+
+void
+DnsResolver::lookup(const string& name, DnsMessage::Type type, const Completion& done)
+{
+   DnsMessage answer;
+
+   if (mCache.find(name, type, answer))
+   {
+      MsrpDebugLog(<< "DNS cache hit " << name);
+
+      post(done, answer);
+
+      return;
+   }
+
+   if (!DnsMessage::valid(name))
+   {
+      answer.name() = name;
+      answer.type() = type;
+      answer.rcode() = DnsMessage::FormatError;
+
+      post(done, answer);
+
+      return;
+   }
+
+   const string key = DnsCache::key(name, type);
+
+   mutex::scoped_lock lock(mMutex);
+
+   if (const unsigned short* id = mInFlight.find(key))
+   {
+      MsrpDebugLog(<< "DNS lookup " << name << " joins query in flight");
+
+      mPending[*id]->waiters.push_back(done);
+
+      return;
+   }
+
+   const unsigned short id = allocateId();
+
+   shared_ptr<Pending> p(new Pending(mService));
+   p->question.id() = id;
+   p->question.name() = name;
+   p->question.type() = type;
+   p->waiters.push_back(done);
+
+   try
+   {
+      // !cb! port 0: the kernel picks a random ephemeral port
+      p->socket.open(udp::v4());
+      p->socket.bind(udp::endpoint(udp::v4(), 0));
+   }
+   catch (const asio::error& e)
+   {
+      MsrpErrLog(<< "DNS lookup " << name << " failed: " << e);
+
+      answer.name() = name;
+      answer.type() = type;
+      answer.rcode() = DnsMessage::ServerFailure;
+
+      post(done, answer);
+
+      return;
+   }
+
+   send(*p);
+   arm(id, *p);
+
+   mPending[id] = p;
+   mInFlight[key] = id;
+
+   receive(p);
+}
+
+void
+DnsResolver::post(const Completion& done, const DnsMessage& answer)
+{
+   mService.post(bind(done, answer));
+}
+
+unsigned short
+DnsResolver::allocateId() const
+{
+   for (;;)
+   {
+      const unsigned short id = static_cast<unsigned short>(resip::Random::getRandom());
+
+      if (mPending.find(id) == mPending.end())
+      {
+         return id;
+      }
+   }
+}
+
+const shared_ptr<DnsResolver::Pending>
+DnsResolver::retire(PendingMap::iterator i)
+{
+   const shared_ptr<Pending> p = i->second;
+
+   mInFlight.erase(DnsCache::key(p->question.name(), p->question.type()));
+   mPending.erase(i);
+
+   return p;
+}
+
+void
+DnsResolver::Pending::close()
+{
+   try
+   {
+      timer.cancel();
+   }
+   catch (const asio::error&) {}
+
+   try
+   {
+      socket.close();
+   }
+   catch (const asio::error&) {}
+}
+
+void
+DnsResolver::Pending::complete(const DnsMessage& answer) const
+{
+   for (vector<Completion>::const_iterator i = waiters.begin(); i != waiters.end(); ++i)
+   {
+      (*i)(answer);
+   }
+}
+
+void
+DnsResolver::send(Pending& p)
+{
+   char buffer[DnsMessage::MaxSize];
+
+   const size_t size = p.question.encode(buffer, sizeof(buffer));
+   assert(size <= sizeof(buffer));
+
+   const udp::endpoint& server = mServers[p.attempts % mServers.size()];
+
+   try
+   {
+      // !cb! UDP sends don't block for long; sending in place saves keeping
+      // the datagram alive for an async_send_to
+      p.socket.send_to(asio::buffer(buffer, size), server);
+   }
+   catch (const asio::error& e)
+   {
+      // the retransmission timer tries the next server
+      MsrpWarningLog(<< "DNS send to " << server << " failed: " << e);
+   }
+}
+
+void
+DnsResolver::arm(unsigned short id, Pending& p)
+{
+   p.timer.expires_from_now(posix_time::seconds(static_cast<long>(Timeout)));
+   p.timer.async_wait(bind(&DnsResolver::timeoutHandler, shared_from_this(), id, placeholders::error));
+}
+
+void
+DnsResolver::receive(const shared_ptr<Pending>& p)
+{
+   // !cb! the handler holds the query, so its buffer outlives the receive
+   p->socket.async_receive_from(asio::buffer(p->buffer, sizeof(p->buffer)), p->sender,
+      bind(&DnsResolver::receiveHandler, shared_from_this(), p,
+         placeholders::error,
+         placeholders::bytes_transferred));
+}
+
+void
+DnsResolver::receiveHandler(shared_ptr<Pending> p, const asio::error& e, size_t bytes)
+{
+   DnsMessage answer;
+
+   {
+      mutex::scoped_lock lock(mMutex);
+
+      PendingMap::iterator i = mPending.find(p->question.id());
+
+      if (i == mPending.end() || i->second != p)
+      {
+         // completed, timed out or stopped
+         return;
+      }
+
+      if (e)
+      {
+         // e.g. an ICMP port unreachable from a dead server; the
+         // retransmission timer tries the next one
+         MsrpWarningLog(<< "DNS receive: " << e);
+      }
+      else if (std::find(mServers.begin(), mServers.end(), p->sender) == mServers.end())
+      {
+         MsrpWarningLog(<< "DNS answer from unknown server " << p->sender);
+      }
+      else if (answer.decode(p->buffer, bytes) && answer.response()
+            && answer.id() == p->question.id()
+            && answer.type() == p->question.type()
+            && algorithm::iequals(answer.name(), p->question.name()))
+      {
+         retire(i);
+         p->close();
+      }
+
+      if (p->socket.is_open())
+      {
+         receive(p);
+
+         return;
+      }
+   }
+
+   MsrpDebugLog(<< "DNS answer for " << answer.name() << ": rcode " << answer.rcode()
+            << ", " << answer.addresses().size() + answer.services().size() << " records");
+
+   mCache.insert(answer);
+
+   p->complete(answer);
+}
+
+void
+DnsResolver::timeoutHandler(unsigned short id, const asio::error& e)
+{
+   if (e)
+   {
+      return;
+   }
+
+   shared_ptr<Pending> p;
+
+   {
+      mutex::scoped_lock lock(mMutex);
+
+      PendingMap::iterator i = mPending.find(id);
+      if (i == mPending.end())
+      {
+         return;
+      }
+
+      if (++i->second->attempts < Attempts)
+      {
+         send(*i->second);
+         arm(id, *i->second);
+
+         return;
+      }
+
+      p = retire(i);
+      p->close();
+   }
+
+   MsrpWarningLog(<< "DNS lookup " << p->question.name() << " timed out");
+
+   DnsMessage answer(p->question);
+   answer.response() = true;
+   answer.rcode() = DnsMessage::Timeout;
+
+   p->complete(answer);
+}
+
+void
+DnsResolver::stop()
+{
+   mutex::scoped_lock lock(mMutex);
+
+   for (PendingMap::iterator i = mPending.begin(); i != mPending.end(); ++i)
+   {
+      i->second->close();
+   }
+
+   mPending.clear();
+   mInFlight.clear();
+}
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
@@ -0,0 +1,154 @@
+#ifndef MSRP_DNSRESOLVER_HXX
+#define MSRP_DNSRESOLVER_HXX
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <asio.hpp>
+
+#include "msrp/DnsCache.hxx"
+#include "msrp/DnsMessage.hxx"
+#include "msrp/HashTable.hxx"
+
+namespace msrp
+{
+
+// !cb! Stub resolver that runs on the io_service like any other asio object:
+// answers and retransmission timers are ordinary asio handlers, and there is
+// no thread of its own.  Each query goes out on a socket of its own, bound
+// to an ephemeral port the kernel picks at random, and only an answer on
+// that socket, from a configured server, with the query's random ID and
+// question is accepted, so a spoofed answer has to guess the port as well as
+// the ID.  The socket is closed when the query completes, so
+// io_service::run() returns once they have all completed.  Handlers hold a
+// reference, so the resolver outlives its owner until they have run.
+//
+// Completions are always posted to the io_service, never called from inside
+// lookup(), even for an answer from the cache.
+//
+// Lookups for a name and type that is already being queried attach to the
+// query in flight, so a burst of sessions to one relay sends one query.
+//
+// Nameservers are read from /etc/resolv.conf; only IPv4 servers are used.
+// A truncated answer is used as it is rather than retried over TCP.
+
+class DnsResolver :
+   public boost::enable_shared_from_this<DnsResolver>,
+   private boost::noncopyable
+{
+   public:
+      enum
+      {
+         Port = 53,
+         Timeout = 2,   // seconds per attempt
+         Attempts = 3
+      };
+
+      // !cb! called once with the answer, which may come from the cache or be
+      // a local failure (DnsMessage::Timeout, FormatError for a bad name)
+      typedef boost::function1<void, const DnsMessage&> Completion;
+
+      DnsResolver(asio::io_service&);
+
+      ~DnsResolver();
+
+      // Servers to query, in order; each retransmission moves on to the next.
+      // An empty list is ignored and the current servers are kept.
+      void nameservers(const std::vector<asio::ip::udp::endpoint>&);
+
+      void lookup(const std::string& name, DnsMessage::Type, const Completion&);
+
+      // Drop pending queries without completing them and close their sockets.
+      void stop();
+
+      DnsCache& cache() { return mCache; }
+
+   private:
+      struct Pending
+      {
+         Pending(asio::io_service& ios) :
+            socket(ios), timer(ios), attempts(0)
+         {}
+
+         void complete(const DnsMessage&) const;
+
+         // closes the socket and cancels the timer
+         void close();
+
+         DnsMessage question;
+         asio::ip::udp::socket socket;
+         asio::deadline_timer timer;
+         unsigned int attempts;
+
+         asio::ip::udp::endpoint sender;
+         char buffer[DnsMessage::MaxSize];
+
+         // !cb! every lookup for the same (name, type) made while this one
+         // is in flight waits on it instead of sending its own query
+         std::vector<Completion> waiters;
+      };
+
+      typedef std::map<unsigned short, boost::shared_ptr<Pending> > PendingMap;
+
+      // in-flight query IDs by DnsCache::key()
+      typedef HashTable<std::string, unsigned short> InFlightMap;
+
+      // all of these are called with mMutex held
+      void send(Pending&);
+      void arm(unsigned short id, Pending&);
+      void receive(const boost::shared_ptr<Pending>&);
+      unsigned short allocateId() const;
+      const boost::shared_ptr<Pending> retire(PendingMap::iterator);
+
+      // complete from the io_service
+      void post(const Completion&, const DnsMessage&);
+
+      void receiveHandler(boost::shared_ptr<Pending>, const asio::error&, std::size_t);
+      void timeoutHandler(unsigned short id, const asio::error&);
+
+      mutable boost::mutex mMutex;
+
+      asio::io_service& mService;
+
+      std::vector<asio::ip::udp::endpoint> mServers;
+
+      PendingMap mPending;
+      InFlightMap mInFlight;
+
+      DnsCache mCache;
+};
+
+}
+
+#endif
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
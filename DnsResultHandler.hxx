@@ -1,47 +1,80 @@
 #ifndef MSRP_DNSRESULTHANDLER_HXX
 #define MSRP_DNSRESULTHANDLER_HXX
 
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+
 #include <asio.hpp>
 
-#include "DnsResultSinkImpl.hxx"
+#include "msrp/DnsMessage.hxx"
 
 namespace msrp
 {
 
+template<typename Record>
+struct DnsResult
+{
+   DnsResult() :
+      status(DnsMessage::NoError)
+   {}
+
+   std::string domain;
+
+   // DnsMessage::Rcode
+   unsigned int status;
+
+   std::vector<Record> records;
+};
+
+inline void
+records(const DnsMessage& m, std::vector<asio::ip::address>& r)
+{
+   r = m.addresses();
+}
+
+inline void
+records(const DnsMessage& m, std::vector<SrvRecord>& r)
+{
+   r = m.services();
+}
+
+// !cb! Turns an answer into a DnsResult for one query type and posts the
+// handler to the io_service, so that it never runs inside DnsService.
+
 template<
    typename Query,
-   typename Handler,
-   typename PostFunction
+   typename Handler
    >
-class DnsResultHandler : public DnsResultSinkImpl
+class DnsResultHandler
 {
    public:
-      DnsResultHandler(asio::io_service& fifo, const Handler& handler, const PostFunction& post) :
-         mFifo(fifo), mHandler(handler), mPost(post)
+      DnsResultHandler(asio::io_service& fifo, const Handler& handler) :
+         mFifo(fifo), mHandler(handler)
       {}
 
-      virtual ~DnsResultHandler()
-      {}
-
-   private:
-      virtual void onDnsResult(const resip::DNSResult<typename Query::Type>& result)
+      void operator()(const DnsMessage& m) const
       {
-         mFifo.post(boost::bind(mHandler, result));
+         DnsResult<typename Query::Record> result;
+
+         result.domain = m.name();
+         result.status = m.rcode();
+
+         records(m, result.records);
 
-         mPost(this);
+         mFifo.post(boost::bind(mHandler, result));
       }
 
+   private:
       asio::io_service& mFifo;
 
-      // !cb! std::unary_function<resip::DNSResult<Query::Type>, void>
+      // !cb! std::unary_function<DnsResult<Query::Record>, void>
       //
-      // It is important that your address vector parameter is not a ref&,
-      // and forces a copy, since this handler will be deleted by the time
-      // mHandler is called by the asio::io_service dispatcher.
-      const Handler mHandler;
-
-      // !cb! std::unary_function<resip::DnsResultSink*, void> (cleanup)
-      const PostFunction mPost;
+      // It is important that your result parameter is not a ref&, and forces
+      // a copy, since the result is gone by the time mHandler is called by
+      // the asio::io_service dispatcher.
+      Handler mHandler;
 };
 
 }
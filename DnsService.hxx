@@ -1,91 +1,95 @@
 #ifndef MSRP_DNSSERVICE_HXX
 #define MSRP_DNSSERVICE_HXX
 
-#include <cassert>
-#include <set>
 #include <string>
+#include <vector>
 
 #include <boost/bind.hpp>
-#include <boost/checked_delete.hpp>
-#include <boost/thread.hpp>
-#include <boost/thread/mutex.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <asio.hpp>
 
-#include <rutil/Logger.hxx>
-#include <rutil/dns/DnsStub.hxx>
-#include <rutil/dns/QueryTypes.hxx>
-
-#include <resip/stack/SelectInterruptor.hxx>
-
-#include "msrp/DnsResultHandler.hxx"
+#include "msrp/AsyncLog.hxx"
 #include "msrp/CoalesceDnsResults.hxx"
+#include "msrp/DnsCache.hxx"
+#include "msrp/DnsMessage.hxx"
+#include "msrp/DnsResolver.hxx"
+#include "msrp/DnsResultHandler.hxx"
+
+// !cb! Lines logged below belong to DNS whichever file includes this;
+// includers define their own subsystem after their includes.
+#define RESIPROCATE_SUBSYSTEM resip::Subsystem::DNS
 
 namespace msrp
 {
 
 struct Query
 {
-   typedef resip::RR_A A;
-   typedef resip::RR_SRV SRV;
-   typedef resip::RR_CNAME CNAME;
-   typedef resip::RR_NAPTR NAPTR;
+   struct A
+   {
+      typedef asio::ip::address Record;
+      static const DnsMessage::Type Type = DnsMessage::A;
+   };
+
+   struct SRV
+   {
+      typedef SrvRecord Record;
+      static const DnsMessage::Type Type = DnsMessage::SRV;
+   };
+
 #ifdef USE_IPV6
-   typedef resip::RR_AAAA AAAA;
+   struct AAAA
+   {
+      typedef asio::ip::address Record;
+      static const DnsMessage::Type Type = DnsMessage::AAAA;
+   };
 #endif
 };
 
-// !cb! DnsService is an adaptor that makes asio::io_service work with the
-// resip event processing model.  If there are active queries, a new thread
-// is spawned that does resip::DnsStub processing and posts results back to
-// io_service so that the handler can be executed in the correct context.
-// asio::io_service::work indicates to io_service that there is work pending.
-// Handler instances must be stored so that they can be garbage collected if
-// DnsService is destroyed before the query completes.
+// !cb! DnsService makes DnsResolver available as an io_service service and
+// turns its answers into typed results.  Answers are cached (see DnsCache),
+// and a cached answer never touches the network.  Handlers are posted to
+// the io_service, never called from inside query().
 
 class DnsService : public asio::io_service::service
 {
    public:
       DnsService(asio::io_service& ios) :
-         asio::io_service::service(ios), mStop(false)
+         asio::io_service::service(ios),
+         mResolver(new DnsResolver(ios))
       {}
 
       ~DnsService()
       {
-         if (mThread)
-         {
-            stop();
-         }
-
-         std::for_each(mHandlers.begin(), mHandlers.end(),
-            boost::checked_deleter<resip::DnsResultSink>());
+         mResolver->stop();
       }
 
       virtual void shutdown_service()
-      {}
+      {
+         mResolver->stop();
+      }
+
+      // Servers to query, in order; each retransmission moves on to the next.
+      void nameservers(const std::vector<asio::ip::udp::endpoint>& servers)
+      {
+         mResolver->nameservers(servers);
+      }
+
+      DnsCache& cache()
+      {
+         return mResolver->cache();
+      }
 
+      // The handler is called with a 'DnsResult<Query::Record>' argument.
       template<
          typename Query,
          typename Handler
          >
       void query(const std::string& name, Handler handler)
       {
-         GenericLog(resip::Subsystem::DNS, resip::Log::Info, << "DNS lookup " << name);
+         MsrpInfoLog(<< "DNS lookup " << name);
 
-         {
-            boost::mutex::scoped_lock lock(mMutex);
-
-            std::auto_ptr<resip::DnsResultSink> event(
-               new DnsResultHandler<Query, Handler, FreeHandler>(owner(),
-                  handler,
-                  FreeHandler(mHandlers)));
-
-            mHandlers.insert(event.get());
-
-            mStub.lookup<Query>(resip::Data::from(name), event.release());
-         }
-
-         work();
+         mResolver->lookup(name, Query::Type, DnsResultHandler<Query, Handler>(owner(), handler));
       }
 
       // Look up A (IP4) and AAAA (IP6) records for one host, and coalesce results.
@@ -95,143 +99,41 @@ class DnsService : public asio::io_service::service
       template<typename Handler>
       void multiquery(const std::string& name, Handler handler)
       {
-         GenericLog(resip::Subsystem::DNS, resip::Log::Info, << "DNS request: " << name);
+         MsrpInfoLog(<< "DNS request: " << name);
 
-         {
-            boost::mutex::scoped_lock lock(mMutex);
-
-            std::auto_ptr<resip::DnsResultSink> event(
-               new CoalesceDnsResults<Handler, FreeHandler>(owner(),
-                  handler,
-                  FreeHandler(mHandlers)));
+         unsigned int queries = 1;
+#ifdef USE_IPV6
+         ++queries;
+#endif
 
-            mHandlers.insert(event.get());
+         boost::shared_ptr<CoalesceDnsResults<Handler> > coalesce(
+            new CoalesceDnsResults<Handler>(owner(), handler, queries));
 
-            const resip::Data target(resip::Data::from(name));
+         const DnsResolver::Completion done(
+            boost::bind(&CoalesceDnsResults<Handler>::answer, coalesce, _1));
 
 #ifdef USE_IPV6
-            mStub.lookup<Query::AAAA>(target, event.get());
+         mResolver->lookup(name, DnsMessage::AAAA, done);
 #endif
 
-            mStub.lookup<Query::A>(target, event.release());
-         }
-
-         work();
+         mResolver->lookup(name, DnsMessage::A, done);
       }
 
    private:
       friend class SessionFactory;
 
-      void work()
-      {
-         if (mThread.get() == 0)
-         {
-            {
-               boost::mutex::scoped_lock lock(mMutex);
-
-               mStop = false;
-
-               mWork.reset(new asio::io_service::work(owner()));
-            }
-
-            assert(mThread.get() == 0);
-
-            mThread.reset(new boost::thread(boost::bind(&DnsService::run, this)));
-         }
-
-         mInterrupt.interrupt();
-      }
-
-      void run()
-      {
-         GenericLog(resip::Subsystem::DNS, resip::Log::Info, << "spawn process thread");
-
-         resip::FdSet set;
-
-         while (!mStop)
-         {
-            set.reset();
-
-            {
-               boost::mutex::scoped_lock lock(mMutex);
-
-               mInterrupt.buildFdSet(set);
-
-               mStub.buildFdSet(set);
-            }
-
-            timeval tv;
-            tv.tv_sec = 3600;
-            tv.tv_usec = 0;
-
-            set.select(tv);
-
-            {
-               boost::mutex::scoped_lock lock(mMutex);
-
-               mInterrupt.process(set);
-
-               mStub.process(set);
-            }
-         }
-
-         GenericLog(resip::Subsystem::DNS, resip::Log::Info, << "join process thread");
-      }
-
       void stop()
       {
-         if (mThread)
-         {
-            {
-               boost::mutex::scoped_lock lock(mMutex);
-
-               mStop = true;
-
-               mInterrupt.interrupt();
-            }
-
-            mThread->join();
-            mThread.reset();
-         }
-
-         mWork.reset();
+         mResolver->stop();
       }
 
-      typedef std::set<resip::DnsResultSink*> Handlers;
-
-      class FreeHandler : public std::unary_function<Handlers::value_type, void>
-      {
-         public:
-            FreeHandler(Handlers& h) :
-               mSet(h)
-            {}
-
-            void operator()(Handlers::value_type p) const
-            {
-               mSet.erase(p);
-
-               boost::checked_delete(p);
-            }
-
-         private:
-            Handlers& mSet;
-      };
-
-      mutable boost::mutex mMutex;
-
-      resip::DnsStub mStub;
-      resip::SelectInterruptor mInterrupt;
-
-      boost::scoped_ptr<boost::thread> mThread;
-      boost::scoped_ptr<asio::io_service::work> mWork;
-
-      Handlers mHandlers;
-
-      bool mStop;
+      boost::shared_ptr<DnsResolver> mResolver;
 };
 
 }
 
+#undef RESIPROCATE_SUBSYSTEM
+
 #endif
 
 // Copyright 2007 Chris Bond
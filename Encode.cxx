@@ -0,0 +1,204 @@
+#include <limits>
+
+#include "msrp/System.hxx"
+#include "msrp/Encode.hxx"
+
+using namespace msrp;
+using namespace std;
+
+size_t
+msrp::digits(unsigned int value)
+{
+   size_t n = 1;
+
+   while (value >= 10)
+   {
+      value /= 10;
+      ++n;
+   }
+
+   return n;
+}
+
+void
+Writer::write(unsigned int value, size_t width)
+{
+   char digits[numeric_limits<unsigned int>::digits10 + 1];
+   char* p = digits + sizeof(digits);
+
+   do
+   {
+      *--p = '0' + value % 10;
+      value /= 10;
+   }
+   while (value);
+
+   for (size_t n = digits + sizeof(digits) - p; n < width; ++n)
+   {
+      put('0');
+   }
+
+   write(p, digits + sizeof(digits) - p);
+}
+
+void
+msrp::encode(Writer& w, const Uri& uri)
+{
+   // !cb! must match operator<<(ostream&, const Uri&)
+   if (uri.empty())
+   {
+      return;
+   }
+
+   if (uri.scheme().empty())
+   {
+      w.write("msrp", 4);
+   }
+   else
+   {
+      w.write(uri.scheme());
+   }
+
+   w.put(':');
+
+   if (uri.delimiter())
+   {
+      w.write("//", 2);
+   }
+
+   if (!uri.user().empty())
+   {
+      w.write(uri.user());
+      w.put('@');
+   }
+
+   w.write(uri.host());
+
+   if (uri.port())
+   {
+      w.put(':');
+      w.write(uri.port());
+   }
+
+   if (!uri.session().empty())
+   {
+      w.put('/');
+      w.write(uri.session());
+   }
+
+   if (!uri.transport().empty())
+   {
+      w.put(';');
+      w.write(uri.transport());
+   }
+}
+
+void
+msrp::encode(Writer& w, const Path& path)
+{
+   Path::const_iterator i = path.begin();
+   while (i != path.end())
+   {
+      encode(w, *i);
+
+      if (++i != path.end())
+      {
+         w.put(' ');
+      }
+   }
+}
+
+void
+msrp::encode(Writer& w, const Mime& mime)
+{
+   w.write(mime.type());
+
+   if (!mime.subtype().empty())
+   {
+      w.put('/');
+      w.write(mime.subtype());
+   }
+
+   for (map<string, string>::const_iterator i = mime.params().begin();
+         i != mime.params().end(); ++i)
+   {
+      w.put(';');
+      w.write(i->first);
+
+      if (!i->second.empty())
+      {
+         w.put('=');
+         w.write(i->second);
+      }
+   }
+}
+
+void
+msrp::encode(Writer& w, const ByteRangeTuple& range)
+{
+   const ByteRangeTuple::size_type unknown =
+      numeric_limits<ByteRangeTuple::size_type>::max();
+
+   w.mark(Writer::RangeStartBegin);
+   w.write(range.start);
+   w.mark(Writer::RangeStartEnd);
+   w.put('-');
+
+   if (range.end == unknown)
+   {
+      w.put('*');
+   }
+   else
+   {
+      w.write(range.end);
+   }
+
+   w.put('/');
+
+   if (range.total == unknown)
+   {
+      w.put('*');
+   }
+   else
+   {
+      w.write(range.total);
+   }
+}
+
+void
+msrp::encode(Writer& w, const StatusTuple& status)
+{
+   w.write(status.ns());
+   w.put(' ');
+   w.write(status.code(), 3);
+
+   if (!status.phrase().empty())
+   {
+      w.put(' ');
+      w.write(status.phrase());
+   }
+}
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
@@ -0,0 +1,136 @@
+#ifndef MSRP_ENCODE_HXX
+#define MSRP_ENCODE_HXX
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#include "msrp/ByteRange.hxx"
+#include "msrp/Mime.hxx"
+#include "msrp/Status.hxx"
+#include "msrp/Uri.hxx"
+
+namespace msrp
+{
+
+// !cb! Writer is the sink for the direct encoders.  Constructed without a
+// buffer it only counts, so running an encoder twice gives the exact size
+// and then the bytes.  Output past the end of the buffer is dropped but
+// still counted, so size() always reports what the encoding needs (like
+// snprintf) and the caller can tell that the buffer was too small.
+
+class Writer
+{
+   public:
+      // Positions recorded while encoding a header, used to patch
+      // pre-encoded chunk headers (see OutgoingMessage::start).
+      enum Mark
+      {
+         TransactionBegin,
+         TransactionEnd,
+         RangeStartBegin,
+         RangeStartEnd,
+         Marks
+      };
+
+      Writer() :
+         mBuffer(0), mCapacity(0), mSize(0)
+      {
+         std::fill(mMarks, mMarks + Marks, 0);
+      }
+
+      Writer(char* buffer, std::size_t capacity) :
+         mBuffer(buffer), mCapacity(capacity), mSize(0)
+      {
+         std::fill(mMarks, mMarks + Marks, 0);
+      }
+
+      inline void put(const char c)
+      {
+         if (mSize < mCapacity)
+         {
+            mBuffer[mSize] = c;
+         }
+
+         ++mSize;
+      }
+
+      inline void write(const char* data, std::size_t size)
+      {
+         if (size == 0)
+         {
+            return;
+         }
+
+         if (mSize + size <= mCapacity)
+         {
+            std::memcpy(mBuffer + mSize, data, size);
+         }
+         else
+         {
+            mCapacity = 0;  // !cb! stop writing once we overflow
+         }
+
+         mSize += size;
+      }
+
+      inline void write(const std::string& s)
+      {
+         write(s.data(), s.size());
+      }
+
+      // decimal, left-padded with zeroes to at least width digits
+      void write(unsigned int value, std::size_t width = 0);
+
+      std::size_t size() const { return mSize; }
+
+      void mark(const Mark m) { mMarks[m] = mSize; }
+      std::size_t marked(const Mark m) const { return mMarks[m]; }
+
+      bool overflow() const { return mBuffer && mSize > mCapacity; }
+
+   private:
+      char* mBuffer;
+      std::size_t mCapacity;
+      std::size_t mSize;
+
+      std::size_t mMarks[Marks];
+};
+
+void encode(Writer&, const Uri&);
+void encode(Writer&, const Path&);
+void encode(Writer&, const Mime&);
+void encode(Writer&, const ByteRangeTuple&);
+void encode(Writer&, const StatusTuple&);
+
+// Exact size of the unsigned decimal representation.
+std::size_t digits(unsigned int value);
+
+}
+
+#endif
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
@@ -0,0 +1,235 @@
+#include <cstring>
+#include <limits>
+
+#include "msrp/FastParse.hxx"
+
+using namespace msrp;
+using namespace std;
+
+// Scan up to maxDigits decimal digits starting at first.  Returns the
+// position after the last digit, or 0 on no digits or overflow.
+static inline const char*
+scanUnsigned(const char* first, const char* last, unsigned int& value,
+      size_t maxDigits = numeric_limits<size_t>::max())
+{
+   const unsigned int limit = numeric_limits<unsigned int>::max();
+
+   const char* p = first;
+   unsigned int v = 0;
+
+   while (p != last && *p >= '0' && *p <= '9' && size_t(p - first) < maxDigits)
+   {
+      const unsigned int digit = *p - '0';
+
+      if (v > (limit - digit) / 10)
+      {
+         return 0;
+      }
+
+      v = v * 10 + digit;
+      ++p;
+   }
+
+   if (p == first)
+   {
+      return 0;
+   }
+
+   value = v;
+
+   return p;
+}
+
+static inline bool
+matches(const char* first, const char* last, const char* literal)
+{
+   const size_t size = strlen(literal);
+
+   return size_t(last - first) == size && memcmp(first, literal, size) == 0;
+}
+
+static inline bool
+blank(const char c)
+{
+   return c == ' ' || c == '\t';
+}
+
+bool
+parser::parseUnsigned(const char* first, const char* last, unsigned int& value)
+{
+   return scanUnsigned(first, last, value) == last;
+}
+
+bool
+parser::parseByteRange(const char* first, const char* last, ByteRangeTuple& range)
+{
+   const ByteRangeTuple::size_type unknown =
+      numeric_limits<ByteRangeTuple::size_type>::max();
+
+   ByteRangeTuple r;
+
+   const char* p = scanUnsigned(first, last, r.start);
+   if (!p || p == last || *p++ != '-')
+   {
+      return false;
+   }
+
+   if (p != last && *p == '*')
+   {
+      r.end = unknown;
+      ++p;
+   }
+   else if (!(p = scanUnsigned(p, last, r.end)))
+   {
+      return false;
+   }
+
+   if (p == last || *p++ != '/')
+   {
+      return false;
+   }
+
+   if (p != last && *p == '*')
+   {
+      r.total = unknown;
+      ++p;
+   }
+   else if (!(p = scanUnsigned(p, last, r.total)))
+   {
+      return false;
+   }
+
+   if (p != last)
+   {
+      return false;
+   }
+
+   range = r;
+
+   return true;
+}
+
+bool
+parser::parseMessageId(const char* first, const char* last, string& id)
+{
+   if (first == last)
+   {
+      return false;
+   }
+
+   for (const char* p = first; p != last; ++p)
+   {
+      const char c = *p;
+
+      if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+            || c == '.' || c == '-' || c == '+' || c == '%' || c == '='))
+      {
+         return false;
+      }
+   }
+
+   id.assign(first, last);
+
+   return true;
+}
+
+bool
+parser::parseSuccessReport(const char* first, const char* last, bool& success)
+{
+   if (matches(first, last, "yes"))
+   {
+      success = true;
+      return true;
+   }
+
+   if (matches(first, last, "no"))
+   {
+      success = false;
+      return true;
+   }
+
+   return false;
+}
+
+bool
+parser::parseFailureReport(const char* first, const char* last, int& failure)
+{
+   // FailureReport::Report enum
+   if (matches(first, last, "no"))
+   {
+      failure = 0;
+   }
+   else if (matches(first, last, "yes"))
+   {
+      failure = 1;
+   }
+   else if (matches(first, last, "partial"))
+   {
+      failure = 2;
+   }
+   else
+   {
+      return false;
+   }
+
+   return true;
+}
+
+bool
+parser::parseStatus(const char* first, const char* last, StatusTuple& status)
+{
+   unsigned int ns;
+   unsigned int code;
+
+   const char* p = scanUnsigned(first, last, ns, 3);
+   if (!p || p == last || !blank(*p))
+   {
+      return false;
+   }
+
+   while (p != last && blank(*p))
+   {
+      ++p;
+   }
+
+   // the code is followed by the phrase, or nothing
+   if (!(p = scanUnsigned(p, last, code, 3)) || (p != last && !blank(*p)))
+   {
+      return false;
+   }
+
+   while (p != last && blank(*p))
+   {
+      ++p;
+   }
+
+   status.ns() = ns;
+   status.code() = code;
+   status.phrase().assign(p, last);
+
+   return true;
+}
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
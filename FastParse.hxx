@@ -0,0 +1,62 @@
+#ifndef MSRP_FASTPARSE_HXX
+#define MSRP_FASTPARSE_HXX
+
+#include <string>
+
+#include "msrp/ByteRange.hxx"
+#include "msrp/Status.hxx"
+
+namespace msrp
+{
+
+namespace parser
+{
+
+// !cb! Hand-written scanners for the standard headers with trivial values.
+// They accept what the corresponding Spirit grammars accept, except that a
+// status code must be followed by a blank or nothing, and run without
+// grammar lookup or allocation.  Each returns false unless the whole of
+// [first, last) is consumed.
+//
+// parseMessageId and parseStatus still assign their string results into
+// the caller's string.  A pooled Message keeps its Message-ID's capacity
+// from one use to the next, so only the first long ID parsed into it
+// allocates; the Status phrase lives with the rarely used extended headers
+// and is allocated with them.
+
+bool parseUnsigned(const char* first, const char* last, unsigned int&);
+bool parseByteRange(const char* first, const char* last, ByteRangeTuple&);
+bool parseMessageId(const char* first, const char* last, std::string&);
+bool parseSuccessReport(const char* first, const char* last, bool&);
+bool parseFailureReport(const char* first, const char* last, int&);
+bool parseStatus(const char* first, const char* last, StatusTuple&);
+
+} // namespace parser
+
+}
+
+#endif
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
@@ -0,0 +1,271 @@
+#ifndef MSRP_HASHTABLE_HXX
+#define MSRP_HASHTABLE_HXX
+
+#include <cstddef>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace msrp
+{
+
+// FNV-1a, for traits that need to hash raw bytes
+inline std::size_t
+hashBytes(const char* data, std::size_t size)
+{
+   std::size_t h = static_cast<std::size_t>(2166136261u);
+
+   for (std::size_t i = 0; i < size; ++i)
+   {
+      h ^= static_cast<unsigned char>(data[i]);
+      h *= 16777619u;
+   }
+
+   return h;
+}
+
+// Default traits use the key's own hash() and operator==.  Traits may
+// overload hash() and equal() for other probe types, which lets a table be
+// searched without constructing a Key.
+template<typename Key>
+struct HashTraits
+{
+   static std::size_t hash(const Key& k) { return k.hash(); }
+   static bool equal(const Key& a, const Key& b) { return a == b; }
+};
+
+template<>
+struct HashTraits<std::string>
+{
+   static std::size_t hash(const std::string& k) { return hashBytes(k.data(), k.size()); }
+   static bool equal(const std::string& a, const std::string& b) { return a == b; }
+};
+
+// !cb! Open-addressing hash table with linear probing.  Erase shifts later
+// entries of the cluster back instead of leaving tombstones, so lookups
+// never degrade with churn.  Each slot caches its hash, which keeps probing
+// cheap and makes growing the table free of Key rehashes.  Pointers
+// returned by find() are invalidated by any insert or erase.
+
+template<typename Key, typename Value, typename Traits = HashTraits<Key> >
+class HashTable
+{
+   public:
+      HashTable() :
+         mSize(0)
+      {}
+
+      std::size_t size() const { return mSize; }
+      bool empty() const { return mSize == 0; }
+
+      void clear()
+      {
+         mSlots.clear();
+         mSize = 0;
+      }
+
+      void swap(HashTable& rhs)
+      {
+         mSlots.swap(rhs.mSlots);
+         std::swap(mSize, rhs.mSize);
+      }
+
+      template<typename Probe>
+      Value* find(const Probe& probe)
+      {
+         const std::size_t i = locate(probe, Traits::hash(probe));
+
+         return i == npos ? 0 : &mSlots[i].value;
+      }
+
+      template<typename Probe>
+      const Value* find(const Probe& probe) const
+      {
+         const std::size_t i = locate(probe, Traits::hash(probe));
+
+         return i == npos ? 0 : &mSlots[i].value;
+      }
+
+      // Insert or replace.
+      Value& set(const Key& key, const Value& value)
+      {
+         Value& v = (*this)[key];
+         v = value;
+
+         return v;
+      }
+
+      Value& operator[](const Key& key)
+      {
+         const std::size_t h = Traits::hash(key);
+
+         std::size_t i = locate(key, h);
+         if (i != npos)
+         {
+            return mSlots[i].value;
+         }
+
+         if ((mSize + 1) * 4 > mSlots.size() * 3)
+         {
+            grow();
+         }
+
+         i = h & mask();
+         while (mSlots[i].used)
+         {
+            i = (i + 1) & mask();
+         }
+
+         Slot& s = mSlots[i];
+         s.used = true;
+         s.hash = h;
+         s.key = key;
+         s.value = Value();
+
+         ++mSize;
+
+         return s.value;
+      }
+
+      template<typename Probe>
+      bool erase(const Probe& probe)
+      {
+         const std::size_t i = locate(probe, Traits::hash(probe));
+
+         if (i == npos)
+         {
+            return false;
+         }
+
+         eraseAt(i);
+
+         return true;
+      }
+
+      // Slot access for incremental walks over the table.  Erasing slot i
+      // may move a later entry into it, so a walk should look at i again.
+      std::size_t capacity() const { return mSlots.size(); }
+      bool occupied(std::size_t i) const { return mSlots[i].used; }
+      const Key& keyAt(std::size_t i) const { return mSlots[i].key; }
+      Value& valueAt(std::size_t i) { return mSlots[i].value; }
+
+      void eraseAt(std::size_t i)
+      {
+         // backward shift deletion
+         std::size_t j = i;
+
+         for (;;)
+         {
+            j = (j + 1) & mask();
+
+            if (!mSlots[j].used)
+            {
+               break;
+            }
+
+            const std::size_t home = mSlots[j].hash & mask();
+
+            // move j into the hole unless its home lies cyclically in (i, j]
+            if ((j > i && (home <= i || home > j)) || (j < i && (home <= i && home > j)))
+            {
+               mSlots[i] = mSlots[j];
+               i = j;
+            }
+         }
+
+         mSlots[i].used = false;
+         mSlots[i].key = Key();
+         mSlots[i].value = Value();
+
+         --mSize;
+      }
+
+   private:
+      enum { Initial = 16 };
+
+      static const std::size_t npos = static_cast<std::size_t>(-1);
+
+      struct Slot
+      {
+         Slot() : used(false), hash(0) {}
+
+         bool used;
+         std::size_t hash;
+         Key key;
+         Value value;
+      };
+
+      std::size_t mask() const { return mSlots.size() - 1; }
+
+      template<typename Probe>
+      std::size_t locate(const Probe& probe, std::size_t h) const
+      {
+         if (mSlots.empty())
+         {
+            return npos;
+         }
+
+         for (std::size_t i = h & mask(); mSlots[i].used; i = (i + 1) & mask())
+         {
+            if (mSlots[i].hash == h && Traits::equal(mSlots[i].key, probe))
+            {
+               return i;
+            }
+         }
+
+         return npos;
+      }
+
+      void grow()
+      {
+         std::vector<Slot> old;
+         old.swap(mSlots);
+
+         mSlots.resize(old.empty() ? Initial : old.size() * 2);
+
+         for (typename std::vector<Slot>::iterator s = old.begin(); s != old.end(); ++s)
+         {
+            if (s->used)
+            {
+               std::size_t i = s->hash & mask();
+               while (mSlots[i].used)
+               {
+                  i = (i + 1) & mask();
+               }
+
+               mSlots[i] = *s;
+            }
+         }
+      }
+
+      std::vector<Slot> mSlots;
+      std::size_t mSize;
+};
+
+}
+
+#endif
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
@@ -2,7 +2,9 @@
 #include <string>
 
 #include "msrp/System.hxx"
+#include "msrp/FastParse.hxx"
 #include "msrp/Header.hxx"
+#include "msrp/PathCache.hxx"
 
 using namespace msrp;
 using namespace std;
@@ -27,7 +29,162 @@ const string Authorization     ::Key = "Authorization";
 const string WWWAuthenticate   ::Key = "WWW-Authenticate";
 #endif
 
-const size_t ByteRange::Unknown = numeric_limits<size_t>::max();
+const unsigned int ByteRange::Unknown = numeric_limits<ByteRangeTuple::size_type>::max();
+
+namespace
+{
+
+// !cb! Paths repeat on every chunk of a session, so a parsed path is cached
+// by its text with its URIs interned; a hit costs a lookup and a refcount.
+template<typename FieldT>
+bool
+parsePath(const char* first, const char* last, Path& value)
+{
+   PathCache& cache = PathCache::instance();
+
+   if (cache.find(first, last, value))
+   {
+      return true;
+   }
+
+   Path parsed;
+   if (!LazyField::Storage<FieldT, Path, parser::Path>::parseValue(first, last, parsed))
+   {
+      return false;
+   }
+
+   Path interned;
+   for (Path::const_iterator i = parsed.begin(); i != parsed.end(); ++i)
+   {
+      Uri uri(*i);
+      uri.intern();
+
+      interned.push_back(uri);
+   }
+
+   cache.insert(first, last, interned);
+
+   value = interned;
+
+   return true;
+}
+
+}
+
+bool
+msrp::parsePathElement(const char* first, const char* last, size_t index, Uri& uri)
+{
+   const char* begin = first;
+   const char* end = first;
+
+   for (size_t n = 0; ; ++n)
+   {
+      begin = end;
+      while (begin != last && (*begin == ' ' || *begin == '\t'))
+      {
+         ++begin;
+      }
+
+      if (begin == last)
+      {
+         return false;
+      }
+
+      end = begin;
+      while (end != last && *end != ' ' && *end != '\t')
+      {
+         ++end;
+      }
+
+      if (n == index)
+      {
+         break;
+      }
+   }
+
+   // a single URI is a path of one, so it shares the path cache
+   Path path;
+   if (!parsePath<ToPath>(begin, end, path) || path.size() != 1)
+   {
+      throw ParseException(string(begin, end), codeContext());
+   }
+
+   uri = path.front();
+
+   return true;
+}
+
+bool
+FromPath::parseValue(const char* first, const char* last, Path& value)
+{
+   return parsePath<FromPath>(first, last, value);
+}
+
+bool
+ToPath::parseValue(const char* first, const char* last, Path& value)
+{
+   return parsePath<ToPath>(first, last, value);
+}
+
+bool
+UsePath::parseValue(const char* first, const char* last, Path& value)
+{
+   return parsePath<UsePath>(first, last, value);
+}
+
+bool
+ContentLength::parseValue(const char* first, const char* last, unsigned int& value)
+{
+   return parser::parseUnsigned(first, last, value);
+}
+
+bool
+ByteRange::parseValue(const char* first, const char* last, ByteRangeTuple& value)
+{
+   return parser::parseByteRange(first, last, value);
+}
+
+bool
+SuccessReport::parseValue(const char* first, const char* last, bool& value)
+{
+   return parser::parseSuccessReport(first, last, value);
+}
+
+bool
+FailureReport::parseValue(const char* first, const char* last, int& value)
+{
+   return parser::parseFailureReport(first, last, value);
+}
+
+bool
+MessageId::parseValue(const char* first, const char* last, string& value)
+{
+   return parser::parseMessageId(first, last, value);
+}
+
+bool
+Status::parseValue(const char* first, const char* last, StatusTuple& value)
+{
+   return parser::parseStatus(first, last, value);
+}
+
+bool
+Expires::parseValue(const char* first, const char* last, unsigned int& value)
+{
+   return parser::parseUnsigned(first, last, value);
+}
+
+bool
+MinExpires::parseValue(const char* first, const char* last, unsigned int& value)
+{
+   return parser::parseUnsigned(first, last, value);
+}
+
+bool
+MaxExpires::parseValue(const char* first, const char* last, unsigned int& value)
+{
+   return parser::parseUnsigned(first, last, value);
+}
 
 // Copyright 2007 Chris Bond
 // 
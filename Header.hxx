@@ -1,6 +1,7 @@
 #ifndef MSRP_HEADER_HXX
 #define MSRP_HEADER_HXX
 
+#include <cstddef>
 #include <string>
 
 #include <boost/spirit.hpp>
@@ -8,6 +9,7 @@
 #include "msrp/AuthParser.hxx"
 #include "msrp/AuthTuple.hxx"
 #include "msrp/ByteRange.hxx"
+#include "msrp/HeaderHash.hxx"
 #include "msrp/LazyField.hxx"
 #include "msrp/MessageId.hxx"
 #include "msrp/Mime.hxx"
@@ -18,6 +20,9 @@
 namespace msrp
 {
 
+// !cb! Headers with trivial values declare a parseValue that hides the Spirit
+// default in LazyField::Storage; see FastParse.hxx.
+
 struct ContentLength :
    public LazyField::Storage<
       ContentLength,
@@ -26,18 +31,25 @@ struct ContentLength :
    >
 {
    static const std::string Key;
+   static const HeaderHash::Slot Slot = HeaderHash::ContentLength;
+
+   static bool parseValue(const char*, const char*, unsigned int&);
 };
 
 struct ContentType :
    public LazyField::Storage<ContentType, Mime, parser::Mime>
 {
    static const std::string Key;
+   static const HeaderHash::Slot Slot = HeaderHash::ContentType;
 };
 
 struct ByteRange :
    public LazyField::Storage<ByteRange, ByteRangeTuple, parser::ByteRange>
 {
    static const std::string Key;
+   static const HeaderHash::Slot Slot = HeaderHash::ByteRange;
+
+   static bool parseValue(const char*, const char*, ByteRangeTuple&);
 
    static const unsigned int Unknown;
 };
@@ -46,12 +58,18 @@ struct SuccessReport :
    public LazyField::Storage<SuccessReport, bool, parser::SuccessReport>
 {
    static const std::string Key;
+   static const HeaderHash::Slot Slot = HeaderHash::SuccessReport;
+
+   static bool parseValue(const char*, const char*, bool&);
 };
 
 struct FailureReport :
    public LazyField::Storage<FailureReport, int, parser::FailureReport>
 {
    static const std::string Key;
+   static const HeaderHash::Slot Slot = HeaderHash::FailureReport;
+
+   static bool parseValue(const char*, const char*, int&);
 
    enum Report
    {
@@ -64,27 +82,47 @@ struct FailureReport :
 struct FromPath : public LazyField::Storage<FromPath, Path, parser::Path>
 {
    static const std::string Key;
+   static const HeaderHash::Slot Slot = HeaderHash::FromPath;
+
+   static bool parseValue(const char*, const char*, Path&);
 };
 
 struct ToPath : public LazyField::Storage<ToPath, Path, parser::Path>
 {
    static const std::string Key;
+   static const HeaderHash::Slot Slot = HeaderHash::ToPath;
+
+   static bool parseValue(const char*, const char*, Path&);
 };
 
 struct UsePath : public LazyField::Storage<UsePath, Path, parser::Path>
 {
    static const std::string Key;
+   static const HeaderHash::Slot Slot = HeaderHash::UsePath;
+
+   static bool parseValue(const char*, const char*, Path&);
 };
 
+// !cb! Parse only the URI at the given position of an unparsed path, so
+// routing on the first hop doesn't pay for the rest.  Returns false if the
+// path is shorter than that; throws ParseException if the URI is malformed.
+bool parsePathElement(const char* first, const char* last, std::size_t index, Uri&);
+
 struct MessageId :
    public LazyField::Storage<MessageId, std::string, parser::MessageId>
 {
    static const std::string Key;
+   static const HeaderHash::Slot Slot = HeaderHash::MessageId;
+
+   static bool parseValue(const char*, const char*, std::string&);
 };
 
 struct Status : public LazyField::Storage<Status, StatusTuple, parser::Status>
 {
    static const std::string Key;
+   static const HeaderHash::Slot Slot = HeaderHash::Status;
+
+   static bool parseValue(const char*, const char*, StatusTuple&);
 };
 
 struct Expires :
@@ -95,6 +133,9 @@ struct Expires :
    >
 {
    static const std::string Key;
+   static const HeaderHash::Slot Slot = HeaderHash::Expires;
+
+   static bool parseValue(const char*, const char*, unsigned int&);
 };
 
 struct MinExpires :
@@ -105,6 +146,9 @@ struct MinExpires :
    >
 {
    static const std::string Key;
+   static const HeaderHash::Slot Slot = HeaderHash::MinExpires;
+
+   static bool parseValue(const char*, const char*, unsigned int&);
 };
 
 struct MaxExpires :
@@ -115,6 +159,9 @@ struct MaxExpires :
    >
 {
    static const std::string Key;
+   static const HeaderHash::Slot Slot = HeaderHash::MaxExpires;
+
+   static bool parseValue(const char*, const char*, unsigned int&);
 };
 
 #ifdef ENABLE_AUTHTUPLE
@@ -123,18 +170,21 @@ struct WWWAuthenticate :
    public LazyField::Storage<WWWAuthenticate, AuthTuple, parser::Auth<true> >
 {
    static const std::string Key;
+   static const HeaderHash::Slot Slot = HeaderHash::WWWAuthenticate;
 };
 
 struct Authorization :
    public LazyField::Storage<Authorization, AuthTuple, parser::Auth<true> >
 {
    static const std::string Key;
+   static const HeaderHash::Slot Slot = HeaderHash::Authorization;
 };
 
 struct AuthenticationInfo :
    public LazyField::Storage<AuthenticationInfo, AuthTuple, parser::Auth<false> >
 {
    static const std::string Key;
+   static const HeaderHash::Slot Slot = HeaderHash::AuthenticationInfo;
 };
 
 #endif // ENABLE_AUTHTUPLE
@@ -0,0 +1,93 @@
+#include <cstring>
+
+#include "msrp/HeaderHash.hxx"
+
+using namespace msrp;
+using namespace std;
+
+static const char* const Names[HeaderHash::Count] =
+{
+   "",
+   "From-Path",
+   "To-Path",
+   "Use-Path",
+   "Message-ID",
+   "Content-Length",
+   "Content-Type",
+   "Byte-Range",
+   "Expires",
+   "Min-Expires",
+   "Max-Expires",
+   "Status",
+   "Success-Report",
+   "Failure-Report",
+   "WWW-Authenticate",
+   "Authentication-Info",
+   "Authorization"
+};
+
+static const size_t Lengths[HeaderHash::Count] =
+{
+   0, 9, 7, 8, 10, 14, 12, 10, 7, 11, 11, 6, 14, 14, 16, 19, 13
+};
+
+// indexed by (size + 6 * key[1] + key[size - 2]) & 63
+static const unsigned char Table[64] =
+{
+    0,  0,  0,  0,  0,  0, 13,  7,  0,  0,  0,  0,  0,  0, 14,  0,
+    0,  0,  0,  0,  0,  2,  6,  0,  0,  0,  0,  0,  5,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  9,  0,  0,  1,  0,  0,  0,  0,  3,  0,
+    0,  4,  0, 11,  0,  0, 10, 15,  0,  0, 16,  0,  8,  0, 12,  0
+};
+
+HeaderHash::Slot
+HeaderHash::lookup(const char* key, size_t size)
+{
+   if (size < 2)
+   {
+      return Extension;
+   }
+
+   const unsigned char* k = reinterpret_cast<const unsigned char*>(key);
+
+   const Slot slot = static_cast<Slot>(Table[(size + 6 * k[1] + k[size - 2]) & 63]);
+
+   if (slot == Extension
+         || Lengths[slot] != size
+         || memcmp(Names[slot], key, size) != 0)
+   {
+      return Extension;
+   }
+
+   return slot;
+}
+
+const char*
+HeaderHash::name(const Slot slot)
+{
+   return Names[slot];
+}
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
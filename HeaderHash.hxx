@@ -1,10 +1,50 @@
-#include "msrp/System.hxx"
-#include "msrp/Message.hxx"
-#include "msrp/MessagePool.hxx"
+#ifndef MSRP_HEADERHASH_HXX
+#define MSRP_HEADERHASH_HXX
 
-using namespace msrp;
+#include <cstddef>
 
-MessagePool MessagePool::Instance;
+namespace msrp
+{
+
+// !cb! Maps standard header names to a small integer slot with a perfect hash
+// so that the header table can compare one byte instead of a string.  The
+// hash and its table were found by a brute-force search over the names below;
+// if you add a header here, rerun the search and regenerate the table in
+// HeaderHash.cxx.  Anything that does not hash to a standard name is an
+// Extension header and is looked up by name.
+
+struct HeaderHash
+{
+   enum Slot
+   {
+      Extension = 0,
+      FromPath,
+      ToPath,
+      UsePath,
+      MessageId,
+      ContentLength,
+      ContentType,
+      ByteRange,
+      Expires,
+      MinExpires,
+      MaxExpires,
+      Status,
+      SuccessReport,
+      FailureReport,
+      WWWAuthenticate,
+      AuthenticationInfo,
+      Authorization,
+      Count
+   };
+
+   static Slot lookup(const char* key, std::size_t size);
+
+   static const char* name(const Slot);
+};
+
+}
+
+#endif
 
 // Copyright 2007 Chris Bond
 // 
@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <cstring>
+
+#include "msrp/HeaderTable.hxx"
+
+using namespace msrp;
+using namespace std;
+using namespace boost;
+
+HeaderTable::HeaderTable() :
+   mViewCount(0),
+   mBase(0),
+   mBaseSize(0)
+{}
+
+char*
+HeaderTable::slice(size_t size)
+{
+   if (mViewCount)
+   {
+      materialise();
+   }
+
+   // !cb! A recycled message keeps its arena; if a copy of the message
+   // still refers to it we have to start a new one.
+   if (!mArena || !mArena.unique())
+   {
+      mArena.reset(new Arena);
+   }
+   else
+   {
+      mArena->reset();
+   }
+
+   char* base = static_cast<char*>(mArena->allocate(size));
+
+   mBase = base;
+   mBaseSize = size;
+
+   return base;
+}
+
+void
+HeaderTable::insert(const Range& key, const Range& value)
+{
+   const HeaderHash::Slot slot = HeaderHash::lookup(key.begin(), key.size());
+
+   // !cb! The first occurrence of a header wins, as it did when these were
+   // inserted straight into a map.
+   if ((slot == HeaderHash::Extension ? findView(key.begin(), key.size()) : findView(slot)) >= 0
+         || (!mStrings.empty() && mStrings.count(string(key.begin(), key.end()))))
+   {
+      return;
+   }
+
+   const char* const end = mBase + mBaseSize;
+
+   if (mViewCount < Inline
+         && mBaseSize <= 0xffff
+         && key.begin() >= mBase && key.end() <= end
+         && value.begin() >= mBase && value.end() <= end
+         && key.size() <= 0xff)
+   {
+      View& v = mViews[mViewCount++];
+
+      v.key = key.begin() - mBase;
+      v.keySize = key.size();
+      v.value = value.begin() - mBase;
+      v.valueSize = value.size();
+      v.slot = slot;
+   }
+   else
+   {
+      mStrings.insert(make_pair(
+         string(key.begin(), key.end()),
+         string(value.begin(), value.end())));
+   }
+}
+
+int
+HeaderTable::findView(const char* key, size_t size) const
+{
+   for (size_t i = 0; i < mViewCount; ++i)
+   {
+      const View& v = mViews[i];
+
+      if (v.keySize == size && memcmp(mBase + v.key, key, size) == 0)
+      {
+         return i;
+      }
+   }
+
+   return -1;
+}
+
+int
+HeaderTable::findView(const HeaderHash::Slot slot) const
+{
+   for (size_t i = 0; i < mViewCount; ++i)
+   {
+      if (mViews[i].slot == slot)
+      {
+         return i;
+      }
+   }
+
+   return -1;
+}
+
+void
+HeaderTable::eraseView(size_t index)
+{
+   // keep arrival order so that re-encoded messages match their source
+   copy(&mViews[index + 1], &mViews[mViewCount], &mViews[index]);
+
+   --mViewCount;
+}
+
+bool
+HeaderTable::find(const string& key, Range& r) const
+{
+   const int i = findView(key.data(), key.size());
+   if (i >= 0)
+   {
+      r = value(mViews[i]);
+      return true;
+   }
+
+   map<string, string>::const_iterator s = mStrings.find(key);
+   if (s != mStrings.end())
+   {
+      r = Range(s->second.data(), s->second.data() + s->second.size());
+      return true;
+   }
+
+   return false;
+}
+
+bool
+HeaderTable::exists(const string& key) const
+{
+   return findView(key.data(), key.size()) >= 0 || mStrings.find(key) != mStrings.end();
+}
+
+void
+HeaderTable::erase(const string& key)
+{
+   const int i = findView(key.data(), key.size());
+   if (i >= 0)
+   {
+      eraseView(i);
+   }
+   else
+   {
+      mStrings.erase(key);
+   }
+}
+
+bool
+HeaderTable::find(const HeaderHash::Slot slot, Range& r) const
+{
+   const int i = findView(slot);
+   if (i >= 0)
+   {
+      r = value(mViews[i]);
+      return true;
+   }
+
+   return !mStrings.empty() && find(HeaderHash::name(slot), r);
+}
+
+bool
+HeaderTable::exists(const HeaderHash::Slot slot) const
+{
+   return findView(slot) >= 0
+      || (!mStrings.empty() && mStrings.count(HeaderHash::name(slot)));
+}
+
+void
+HeaderTable::erase(const HeaderHash::Slot slot)
+{
+   const int i = findView(slot);
+   if (i >= 0)
+   {
+      eraseView(i);
+   }
+   else if (!mStrings.empty())
+   {
+      mStrings.erase(HeaderHash::name(slot));
+   }
+}
+
+const string*
+HeaderTable::get(const string& key)
+{
+   const int i = findView(key.data(), key.size());
+   if (i >= 0)
+   {
+      const Range r = value(mViews[i]);
+
+      string& s = mStrings[key];
+      s.assign(r.begin(), r.end());
+
+      eraseView(i);
+
+      return &s;
+   }
+
+   map<string, string>::const_iterator s = mStrings.find(key);
+   if (s == mStrings.end())
+   {
+      return 0;
+   }
+
+   return &s->second;
+}
+
+string&
+HeaderTable::operator[](const string& key)
+{
+   const string* s = get(key);
+   if (s)
+   {
+      return const_cast<string&>(*s);
+   }
+
+   return mStrings[key];
+}
+
+void
+HeaderTable::materialise()
+{
+   for (size_t i = 0; i < mViewCount; ++i)
+   {
+      const Range k = key(mViews[i]);
+      const Range v = value(mViews[i]);
+
+      mStrings.insert(make_pair(
+         string(k.begin(), k.end()),
+         string(v.begin(), v.end())));
+   }
+
+   mViewCount = 0;
+   mBase = 0;
+   mBaseSize = 0;
+   mArena.reset();
+}
+
+void
+HeaderTable::clear()
+{
+   mViewCount = 0;
+   mBase = 0;
+   mBaseSize = 0;
+
+   if (mArena)
+   {
+      if (mArena.unique())
+      {
+         mArena->reset();
+      }
+      else
+      {
+         mArena.reset();
+      }
+   }
+
+   mStrings.clear();
+}
+
+HeaderTable::const_iterator
+HeaderTable::begin() const
+{
+   return const_iterator(this, 0, mStrings.begin());
+}
+
+HeaderTable::const_iterator
+HeaderTable::end() const
+{
+   return const_iterator(this, mViewCount, mStrings.end());
+}
+
+HeaderTable::const_iterator::const_iterator(const HeaderTable* table, size_t view, StringIterator string) :
+   mTable(table),
+   mView(view),
+   mString(string)
+{
+   load();
+}
+
+HeaderTable::const_iterator&
+HeaderTable::const_iterator::operator++()
+{
+   if (mView < mTable->mViewCount)
+   {
+      ++mView;
+   }
+   else
+   {
+      ++mString;
+   }
+
+   load();
+
+   return *this;
+}
+
+void
+HeaderTable::const_iterator::load()
+{
+   if (mView < mTable->mViewCount)
+   {
+      const View& v = mTable->mViews[mView];
+
+      mField.first = mTable->key(v);
+      mField.second = mTable->value(v);
+   }
+   else if (mString != mTable->mStrings.end())
+   {
+      mField.first = Range(mString->first.data(), mString->first.data() + mString->first.size());
+      mField.second = Range(mString->second.data(), mString->second.data() + mString->second.size());
+   }
+}
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
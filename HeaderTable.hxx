@@ -0,0 +1,173 @@
+#ifndef MSRP_HEADERTABLE_HXX
+#define MSRP_HEADERTABLE_HXX
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+
+#include <boost/range.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "msrp/Arena.hxx"
+#include "msrp/HeaderHash.hxx"
+
+namespace msrp
+{
+
+// !cb! Storage for unparsed header fields.  Headers read off the wire are
+// kept as (key, value) views into a single copy of the header block (the
+// slice), so parsing a message costs one arena allocation instead of two
+// strings and a map node per header.  Views are stored as 16-bit offsets
+// from the start of the slice so that the table stays small and can be
+// copied trivially.  The slice lives in a refcounted Arena; copies of a
+// table share it, so views can never outlive their storage.  A header is
+// copied into a string only when it is modified through the string
+// interface, when it lies outside the slice, or when the inline view slots
+// run out.
+
+class HeaderTable
+{
+   public:
+      typedef boost::iterator_range<const char*> Range;
+      typedef std::pair<Range, Range> Field;
+
+      enum { Inline = 16 };
+
+      HeaderTable();
+
+      // Allocate a slice of the given size for the raw header block and
+      // return it for the caller to fill.  Any existing views are
+      // materialised first.
+      char* slice(std::size_t size);
+
+      // Add a header.  Ranges inside the slice are kept as views, anything
+      // else is copied.
+      void insert(const Range& key, const Range& value);
+
+      bool find(const std::string& key, Range& value) const;
+      bool exists(const std::string& key) const;
+      void erase(const std::string& key);
+
+      // Standard headers are matched on their perfect hash slot.
+      bool find(const HeaderHash::Slot, Range& value) const;
+      bool exists(const HeaderHash::Slot) const;
+      void erase(const HeaderHash::Slot);
+
+      // Materialise a header as a string; returns 0 if the header is absent.
+      const std::string* get(const std::string& key);
+
+      // Materialise a header as a string, creating it if absent.
+      std::string& operator[](const std::string& key);
+
+      // Copy every view into a string and release the slice.
+      void materialise();
+
+      // Drop all headers.  The arena is kept for reuse unless another table
+      // still refers to it.
+      void clear();
+
+      bool empty() const { return mViewCount == 0 && mStrings.empty(); }
+      std::size_t size() const { return mViewCount + mStrings.size(); }
+
+      // Iterates views in arrival order, then materialised headers.
+      class const_iterator
+      {
+         public:
+            const_iterator() : mTable(0), mView(0) {}
+
+            const Field& operator*() const { return mField; }
+            const Field* operator->() const { return &mField; }
+
+            const_iterator& operator++();
+
+            bool operator==(const const_iterator& rhs) const
+            {
+               return mView == rhs.mView && mString == rhs.mString;
+            }
+
+            bool operator!=(const const_iterator& rhs) const
+            {
+               return !(*this == rhs);
+            }
+
+         private:
+            friend class HeaderTable;
+
+            typedef std::map<std::string, std::string>::const_iterator StringIterator;
+
+            const_iterator(const HeaderTable*, std::size_t, StringIterator);
+
+            void load();
+
+            const HeaderTable* mTable;
+            std::size_t mView;
+            StringIterator mString;
+            Field mField;
+      };
+
+      const_iterator begin() const;
+      const_iterator end() const;
+
+   private:
+      struct View
+      {
+         unsigned short key;
+         unsigned short value;
+         unsigned short valueSize;
+         unsigned char keySize;
+         unsigned char slot;
+      };
+
+      int findView(const char* key, std::size_t size) const;
+      int findView(const HeaderHash::Slot) const;
+      void eraseView(std::size_t);
+
+      Range key(const View& v) const
+      {
+         return Range(mBase + v.key, mBase + v.key + v.keySize);
+      }
+
+      Range value(const View& v) const
+      {
+         return Range(mBase + v.value, mBase + v.value + v.valueSize);
+      }
+
+      View mViews[Inline];
+      unsigned char mViewCount;
+
+      const char* mBase;
+      std::size_t mBaseSize;
+
+      boost::shared_ptr<Arena> mArena;
+
+      std::map<std::string, std::string> mStrings;
+};
+
+}
+
+#endif
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
@@ -0,0 +1,142 @@
+#include "msrp/System.hxx"
+#include "msrp/Histogram.hxx"
+
+using namespace msrp;
+
+unsigned long
+Histogram::count() const
+{
+   unsigned long n = 0;
+
+   for (std::size_t i = 0; i < Buckets; ++i)
+   {
+      n += mCounts[i].load();
+   }
+
+   return n;
+}
+
+Histogram::Value
+Histogram::percentile(double fraction) const
+{
+   unsigned long counts[Buckets];
+   unsigned long n = 0;
+
+   // one pass over a snapshot, so concurrent recording can't run it off
+   // the end
+   for (std::size_t i = 0; i < Buckets; ++i)
+   {
+      counts[i] = mCounts[i].load();
+      n += counts[i];
+   }
+
+   if (n == 0)
+   {
+      return 0;
+   }
+
+   unsigned long rank = static_cast<unsigned long>(fraction * n + 0.5);
+   if (rank == 0)
+   {
+      rank = 1;
+   }
+
+   unsigned long seen = 0;
+
+   for (std::size_t i = 0; i < Buckets; ++i)
+   {
+      seen += counts[i];
+
+      if (seen >= rank)
+      {
+         return i + 1 < Buckets ? lowest(i + 1) - 1 : lowest(i);
+      }
+   }
+
+   return max();
+}
+
+Histogram::Value
+Histogram::max() const
+{
+   for (std::size_t i = Buckets; i > 0; --i)
+   {
+      if (mCounts[i - 1].load())
+      {
+         return i < Buckets ? lowest(i) - 1 : lowest(i - 1);
+      }
+   }
+
+   return 0;
+}
+
+void
+Histogram::clear()
+{
+   for (std::size_t i = 0; i < Buckets; ++i)
+   {
+      mCounts[i].store(0);
+   }
+}
+
+std::size_t
+Histogram::index(Value v)
+{
+   if (v >> MaxBits)
+   {
+      return Buckets - 1;
+   }
+
+   // position of the highest set bit, found by halving
+   unsigned int msb = 0;
+
+   for (unsigned int shift = 32; shift > 0; shift >>= 1)
+   {
+      if (v >> (msb + shift))
+      {
+         msb += shift;
+      }
+   }
+
+   // values below 2 * Sub have msb <= SubBits and map to themselves
+   const unsigned int e = msb > SubBits ? msb - SubBits : 0;
+
+   return static_cast<std::size_t>(e * Sub + (v >> e));
+}
+
+Histogram::Value
+Histogram::lowest(std::size_t bucket)
+{
+   if (bucket < 2 * Sub)
+   {
+      return bucket;
+   }
+
+   const unsigned int e = bucket / Sub - 1;
+
+   return static_cast<Value>(bucket - e * Sub) << e;
+}
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
@@ -0,0 +1,86 @@
+#ifndef MSRP_HISTOGRAM_HXX
+#define MSRP_HISTOGRAM_HXX
+
+#include <cstddef>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "msrp/Atomic.hxx"
+
+namespace msrp
+{
+
+// !cb! Log-linear histogram in the style of HdrHistogram.  Values below
+// 2 * Sub get a bucket each; above that every power of two is split into
+// Sub buckets, so a recorded value is known to within 1/Sub (6%) at any
+// magnitude.  Recording is one atomic increment and never allocates, so
+// any number of threads can record into one histogram.  Values at or
+// above 2^MaxBits are counted in the top bucket.
+
+class Histogram : private boost::noncopyable
+{
+   public:
+      typedef boost::uint64_t Value;
+
+      enum
+      {
+         SubBits = 4,
+         Sub = 1 << SubBits,
+         MaxBits = 40,
+         Buckets = (MaxBits - SubBits + 1) * Sub
+      };
+
+      Histogram() {}
+
+      void record(Value v)
+      {
+         mCounts[index(v)].fetchAdd(1);
+      }
+
+      unsigned long count() const;
+
+      // highest value equivalent to the recorded value at or below which
+      // the given fraction of values fall
+      Value percentile(double fraction) const;
+
+      Value max() const;
+
+      void clear();
+
+      static std::size_t index(Value);
+
+      // smallest value counted in a bucket
+      static Value lowest(std::size_t bucket);
+
+   private:
+      Atomic<unsigned long> mCounts[Buckets];
+};
+
+}
+
+#endif
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
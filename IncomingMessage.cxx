@@ -3,8 +3,10 @@
 #include <rutil/Logger.hxx>
 
 #include "msrp/System.hxx"
+#include "msrp/AsyncLog.hxx"
 #include "msrp/IncomingMessage.hxx"
 #include "msrp/Message.hxx"
+#include "msrp/ObjectPool.hxx"
 #include "msrp/Session.hxx"
 
 #define RESIPROCATE_SUBSYSTEM resip::Subsystem::NONE
@@ -14,10 +16,39 @@ using namespace std;
 using namespace boost;
 using namespace asio;
 
+IncomingMessage::IncomingMessage() :
+   mFailureReports(FailureReport::Yes), mFragmentStart(0), mFragmentSize(0)
+{}
+
 IncomingMessage::IncomingMessage(shared_ptr<Session> s, const Message& m) :
-   MessageSessionBase(m), mSession(s), mFragmentSize(0)
+   mFragmentStart(0), mFragmentSize(0)
+{
+   reset(s, m);
+}
+
+IncomingMessage::~IncomingMessage()
+{}
+
+shared_ptr<IncomingMessage>
+IncomingMessage::factory(shared_ptr<Session> s, const Message& m)
+{
+   shared_ptr<IncomingMessage> ms = ObjectPool<IncomingMessage>::instance().allocate();
+
+   ms->reset(s, m);
+
+   return ms;
+}
+
+void
+IncomingMessage::reset(shared_ptr<Session> s, const Message& m)
 {
+   MessageSessionBase::reset(m);
+
+   mSession = s;
+   mReports = SuccessReporting();
    mFailureReports = FailureReport::Yes;
+   mFragmentStart = 0;
+   mFragmentSize = 0;
 
    try
    {
@@ -36,8 +67,19 @@ IncomingMessage::IncomingMessage(shared_ptr<Session> s, const Message& m) :
    {}
 }
 
-IncomingMessage::~IncomingMessage()
-{}
+void
+IncomingMessage::clear()
+{
+   MessageSessionBase::clear();
+
+   mSession.reset();
+
+   // !cb! cheaper than constructing the signals again
+   mContext.disconnect_all_slots();
+   mContentsEvent.disconnect_all_slots();
+   mSendReport.disconnect_all_slots();
+   mInterrupt.disconnect_all_slots();
+}
 
 void
 IncomingMessage::cancel()
@@ -55,11 +97,11 @@ IncomingMessage::cancel()
    }
    catch (const ParseException&)
    {
-      ErrLog(<< "cannot create response for invalid request");
+      MsrpErrLog(<< "cannot create response for invalid request");
    }
    catch (const bad_weak_ptr&)
    {
-      ErrLog(<< "session is defunct, cannot cancel message");
+      MsrpErrLog(<< "session is defunct, cannot cancel message");
    }
 }
 
@@ -222,6 +264,8 @@ IncomingMessage::completed()
    {
       successReport();
    }
+
+   release();
 }
 
 void
@@ -235,9 +279,24 @@ IncomingMessage::interrupt()
    {
       onInterrupt()();
    }
-   else if (!onComplete().empty())
+   else
    {
-      onComplete()();
+      if (!onComplete().empty())
+      {
+         onComplete()();
+      }
+
+      release();
+   }
+}
+
+void
+IncomingMessage::release()
+{
+   shared_ptr<Session> s(mSession.lock());
+   if (s)
+   {
+      s->onIncomingComplete(*this);
    }
 }
 
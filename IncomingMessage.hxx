@@ -16,6 +16,8 @@ class Demultiplex;
 class Message;
 class Session;
 
+template<typename T> class ObjectPool;
+
 class IncomingMessage :
    public boost::noncopyable,
    public MessageSessionBase
@@ -76,6 +78,10 @@ class IncomingMessage :
 
       IncomingMessage(boost::shared_ptr<Session>, const Message&);
 
+      // recycled through an ObjectPool
+      static boost::shared_ptr<IncomingMessage> factory(boost::shared_ptr<Session>,
+            const Message&);
+
       virtual ~IncomingMessage();
 
       // send a 413 rejection response
@@ -99,6 +105,14 @@ class IncomingMessage :
    private:
       friend class Demultiplex;
       friend class Session;
+      friend class ObjectPool<IncomingMessage>;
+
+      IncomingMessage();
+
+      void reset(boost::shared_ptr<Session>, const Message&);
+
+      // called by ObjectPool on release
+      void clear();
 
       bool process(boost::shared_ptr<const Message>);
 
@@ -110,6 +124,9 @@ class IncomingMessage :
 
       void successReport();
 
+      // leave the session's bookkeeping
+      void release();
+
       boost::weak_ptr<Session> mSession;
 
       SuccessReporting mReports;
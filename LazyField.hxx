@@ -11,6 +11,7 @@
 #include <boost/spirit/actor.hpp>
 
 #include "msrp/Exception.hxx"
+#include "msrp/HeaderTable.hxx"
 #include "msrp/ParseException.hxx"
 #include "msrp/ParserFactory.hxx"
 
@@ -32,23 +33,40 @@ struct LazyField
          mParsed(false)
       {}
 
-      inline void parse(const std::string& s)
+      // Spirit fallback; header types with a hand-written parser declare
+      // their own parseValue, which hides this one.
+      static bool parseValue(const char* first, const char* last, T& value)
       {
          const Grammar& grammar = ParserFactory<Grammar>::get();
 
          boost::spirit::parse_info<> pi = boost::spirit::parse(
-            &s.c_str()[0],
-            &s.c_str()[s.size()],
-            grammar[boost::spirit::assign_a(mValue)]);
+            first,
+            last,
+            grammar[boost::spirit::assign_a(value)]);
+
+         return pi.full;
+      }
 
-         if (!pi.full)
+      static void parse(const char* first, const char* last, T& value)
+      {
+         if (!FieldT::parseValue(first, last, value))
          {
-            throw ParseException(s, codeContext());
+            throw ParseException(std::string(first, last), codeContext());
          }
+      }
+
+      inline void parse(const char* first, const char* last)
+      {
+         parse(first, last, mValue);
 
          mParsed = true;
       }
 
+      inline void parse(const std::string& s)
+      {
+         parse(s.data(), s.data() + s.size());
+      }
+
       typedef std::map<std::string, std::string> Map;
 
       inline T& get(Map& map)
@@ -87,6 +105,40 @@ struct LazyField
          return mValue;
       }
 
+      inline T& get(HeaderTable& headers)
+      {
+         if (!parsed())
+         {
+            HeaderTable::Range r;
+            if (headers.find(FieldT::Slot, r))
+            {
+               parse(r.begin(), r.end());
+
+               headers.erase(FieldT::Slot);
+            }
+         }
+
+         return value();
+      }
+
+      inline const T& getConst(const HeaderTable& headers) const
+      {
+         if (!parsed())
+         {
+            HeaderTable::Range r;
+            if (!headers.find(FieldT::Slot, r))
+            {
+               throw ParseException(FieldT::Key, codeContext());
+            }
+
+            const_cast<Storage&>(*this).parse(r.begin(), r.end());
+
+            const_cast<HeaderTable&>(headers).erase(FieldT::Slot);
+         }
+
+         return mValue;
+      }
+
       inline T& value()
       {
          mParsed = true;
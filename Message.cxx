@@ -1,10 +1,14 @@
-#include <iomanip>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include <boost/spirit.hpp>
 
 #include <rutil/Logger.hxx>
 #include <rutil/Random.hxx>
 
 #include "msrp/System.hxx"
-#include "msrp/Parse.hxx"
+#include "msrp/Encode.hxx"
 #include "msrp/Message.hxx"
 #include "msrp/MessagePool.hxx"
 #include "msrp/ParseException.hxx"
@@ -18,11 +22,39 @@ using namespace std;
 using namespace boost;
 
 shared_ptr<Message>
-Message::factory(const asio::const_buffer& buffer)
+Message::factory(const asio::const_buffer& buffer, const HeaderMode headerMode)
 {
    shared_ptr<Message> m = factory();
 
-   Parse(*m, buffer, ParserFactory<parser::Message>::get());
+   // !cb! The receive buffer is reused as soon as we return, so the header
+   // block is copied once into the message's arena and the header table
+   // keeps views into that.
+   const size_t size = asio::buffer_size(buffer);
+
+   char* slice = m->mHeaders.slice(size);
+   memcpy(slice, asio::buffer_cast<const char*>(buffer), size);
+
+   const parser::Message& grammar = ParserFactory<parser::Message>::get();
+
+   spirit::parse_info<> info;
+   {
+      const parser::Message::Target target(grammar, m.get());
+
+      info = spirit::parse(slice, slice + size, grammar);
+   }
+
+   if (!info.full)
+   {
+      stringstream ss;
+      ss << "Parse failure (context: \"" << string(info.stop, slice + size) << "\")";
+
+      throw ParseException(ss.str(), codeContext());
+   }
+
+   if (headerMode == CopyHeaders)
+   {
+      m->mHeaders.materialise();
+   }
 
    return m;
 }
@@ -34,11 +66,102 @@ Message::factory()
 }
 
 Message::Message() :
+   mRevision(0),
+   mParsed(0),
+   mContentLength(0),
+   mFailureReport(FailureReport::Yes),
+   mSuccessReport(false),
+   mExtended(0),
    mStatusCode(0),
    mMethod(SEND),
    mStatus(Complete)
 {}
 
+Message::Message(const Message& rhs) :
+   mHeaders(rhs.mHeaders),
+   mRevision(rhs.mRevision),
+   mParsed(rhs.mParsed),
+   mFromPath(rhs.mFromPath),
+   mToPath(rhs.mToPath),
+   mMessageId(rhs.mMessageId),
+   mContentType(rhs.mContentType),
+   mByteRange(rhs.mByteRange),
+   mContentLength(rhs.mContentLength),
+   mFailureReport(rhs.mFailureReport),
+   mSuccessReport(rhs.mSuccessReport),
+   mExtended(rhs.mExtended ? new Extended(*rhs.mExtended) : 0),
+   mStatusCode(rhs.mStatusCode),
+   mTransaction(rhs.mTransaction),
+   mStatusPhrase(rhs.mStatusPhrase),
+   mContents(rhs.mContents),
+   mMethod(rhs.mMethod),
+   mStatus(rhs.mStatus)
+{}
+
+Message::~Message()
+{
+   delete mExtended;
+}
+
+Message&
+Message::operator=(const Message& rhs)
+{
+   if (this != &rhs)
+   {
+      Message copy(rhs);
+
+      std::swap(mExtended, copy.mExtended);
+
+      mHeaders = copy.mHeaders;
+      mRevision = copy.mRevision + 1;
+      mParsed = copy.mParsed;
+      mFromPath.swap(copy.mFromPath);
+      mToPath.swap(copy.mToPath);
+      mMessageId.swap(copy.mMessageId);
+      mContentType = copy.mContentType;
+      mByteRange = copy.mByteRange;
+      mContentLength = copy.mContentLength;
+      mFailureReport = copy.mFailureReport;
+      mSuccessReport = copy.mSuccessReport;
+      mStatusCode = copy.mStatusCode;
+      mTransaction.swap(copy.mTransaction);
+      mStatusPhrase.swap(copy.mStatusPhrase);
+      mContents = copy.mContents;
+      mMethod = copy.mMethod;
+      mStatus = copy.mStatus;
+   }
+
+   return *this;
+}
+
+void
+Message::clear()
+{
+   mHeaders.clear();
+
+   mRevision = 0;
+   mParsed = 0;
+
+   mFromPath.clear();
+   mToPath.clear();
+   mMessageId.clear();
+   mContentType = Mime();
+   mByteRange = ByteRangeTuple();
+   mContentLength = 0;
+   mFailureReport = FailureReport::Yes;
+   mSuccessReport = false;
+
+   delete mExtended;
+   mExtended = 0;
+
+   mStatusCode = 0;
+   mTransaction.clear();
+   mStatusPhrase.clear();
+   mContents = resip::Data();
+   mMethod = SEND;
+   mStatus = Complete;
+}
+
 shared_ptr<Message>
 Message::response(unsigned int code, const string& phrase) const
 {
@@ -87,57 +210,70 @@ Message::response(unsigned int code, const string& phrase) const
    return r;
 }
 
-ostream&
-Message::encodeHeader(ostream& os) const
+// !cb! Standard header lines are written straight into the Writer; only the
+// auth tuples, which are rare, still go through their ostream inserters.
+
+static inline void
+line(Writer& w, const string& key)
+{
+   w.write(key);
+   w.write(": ", 2);
+}
+
+static inline void
+crlf(Writer& w)
+{
+   w.write("\r\n", 2);
+}
+
+#ifdef ENABLE_AUTHTUPLE
+static void
+encodeAuth(Writer& w, const string& key, const AuthTuple& tuple)
 {
-   const string crlf("\r\n");
-   const string colon(": ");
+   ostringstream ss;
+   ss << tuple;
 
+   line(w, key);
+   w.write(ss.str());
+   crlf(w);
+}
+#endif
+
+void
+Message::encodeHeader(Writer& w) const
+{
    assert(!transaction().empty());
 
    assert(exists<ToPath>());
    assert(exists<FromPath>());
 
-   os << "MSRP ";
-   os << transaction();
-   os << ' ';
+   w.write("MSRP ", 5);
+   w.mark(Writer::TransactionBegin);
+   w.write(transaction());
+   w.mark(Writer::TransactionEnd);
+   w.put(' ');
 
    switch (method())
    {
       case Message::AUTH:
-         os << "AUTH";
+         w.write("AUTH", 4);
          break;
 
       case Message::SEND:
-         os << "SEND";
+         w.write("SEND", 4);
          break;
 
       case Message::REPORT:
-         os << "REPORT";
+         w.write("REPORT", 6);
          break;
 
       case Message::Response:
-         if (statusCode() < 100)
-         {
-            std::ios::fmtflags flags = os.flags();
-
-            os.setf(ios_base::right);
-            os << std::setw(3)
-               << std::setfill('0')
-               << std::dec
-               << statusCode();
-
-            os.flags(flags);
-         }
-         else
-         {
-            os << statusCode();
-         }
+         w.write(statusCode(), 3);
 
          if (!statusPhrase().empty())
          {
-            os << ' ';
-            os << statusPhrase();
+            w.put(' ');
+            w.write(statusPhrase());
          }
 
          break;
@@ -146,137 +282,143 @@ Message::encodeHeader(ostream& os) const
          abort();
    }
 
-   os << crlf;
+   crlf(w);
 
    // To-Path
-   os << ToPath::Key
-      << colon
-      << header<ToPath>()
-      << crlf;
+   line(w, ToPath::Key);
+   encode(w, header<ToPath>());
+   crlf(w);
 
    // From-Path
-   os << FromPath::Key
-      << colon
-      << header<FromPath>()
-      << crlf;
+   line(w, FromPath::Key);
+   encode(w, header<FromPath>());
+   crlf(w);
 
    // Message-ID
-   if (lazyStorage<MessageId>().parsed())
+   if (parsed<MessageId>())
    {
-      os << MessageId::Key
-         << colon
-         << header<MessageId>()
-         << crlf;
+      line(w, MessageId::Key);
+      w.write(header<MessageId>());
+      crlf(w);
    }
 
    // Success-Report
-   if (lazyStorage<SuccessReport>().parsed())
+   if (parsed<SuccessReport>())
    {
-      os << SuccessReport::Key << colon;
+      line(w, SuccessReport::Key);
 
       if (header<SuccessReport>())
       {
-         os << "yes";
+         w.write("yes", 3);
       }
       else
       {
-         os << "no";
+         w.write("no", 2);
       }
 
-      os << crlf;
+      crlf(w);
    }
 
    // Failure-Report
-   if (lazyStorage<FailureReport>().parsed())
+   if (parsed<FailureReport>())
    {
-      os << FailureReport::Key << colon;
+      line(w, FailureReport::Key);
 
       switch (header<FailureReport>())
       {
          case FailureReport::Yes:
-            os << "yes";
+            w.write("yes", 3);
             break;
          case FailureReport::No:
-            os << "no";
+            w.write("no", 2);
             break;
          case FailureReport::Partial:
-            os << "partial";
+            w.write("partial", 7);
             break;
       }
 
-      os << crlf;
+      crlf(w);
    }
 
    // Content-Type
-   if (lazyStorage<ContentType>().parsed())
+   if (parsed<ContentType>())
    {
-      os << ContentType::Key
-         << colon
-         << header<ContentType>()
-         << crlf;
+      line(w, ContentType::Key);
+      encode(w, header<ContentType>());
+      crlf(w);
    }
 
    // Content-Length
-   if (lazyStorage<ContentLength>().parsed())
+   if (parsed<ContentLength>())
    {
-      os << ContentLength::Key
-         << colon
-         << header<ContentLength>()
-         << crlf;
+      line(w, ContentLength::Key);
+      w.write(header<ContentLength>());
+      crlf(w);
    }
 
    // Byte-Range
-   if (lazyStorage<ByteRange>().parsed())
+   if (parsed<ByteRange>())
    {
-      os << ByteRange::Key
-         << colon
-         << header<ByteRange>()
-         << crlf;
+      line(w, ByteRange::Key);
+      encode(w, header<ByteRange>());
+      crlf(w);
    }
 
    // Status
-   if (lazyStorage<Status>().parsed())
+   if (parsed<Status>())
    {
-      os << msrp::Status::Key
-         << colon
-         << header<Status>()
-         << crlf;
+      line(w, msrp::Status::Key);
+      encode(w, header<Status>());
+      crlf(w);
    }
 
 #ifdef ENABLE_AUTHTUPLE
    // WWW-Authenticate
-   if (lazyStorage<WWWAuthenticate>().parsed())
+   if (parsed<WWWAuthenticate>())
    {
-      os << WWWAuthenticate::Key
-         << colon
-         << header<WWWAuthenticate>()
-         << crlf;
+      encodeAuth(w, WWWAuthenticate::Key, header<WWWAuthenticate>());
    }
    // Authentication-Info
-   else if (lazyStorage<AuthenticationInfo>().parsed())
+   else if (parsed<AuthenticationInfo>())
    {
-      os << AuthenticationInfo::Key
-         << colon
-         << header<AuthenticationInfo>()
-         << crlf;
+      encodeAuth(w, AuthenticationInfo::Key, header<AuthenticationInfo>());
    }
    // Authorization
-   else if (lazyStorage<Authorization>().parsed())
+   else if (parsed<Authorization>())
    {
-      os << Authorization::Key
-         << colon
-         << header<Authorization>()
-         << crlf;
+      encodeAuth(w, Authorization::Key, header<Authorization>());
    }
 #endif // ENABLE_AUTHTUPLE
 
    // remaining unparsed headers
-   for (map<string, string>::const_iterator i = mHeaders.begin(); i != mHeaders.end(); ++i)
+   for (HeaderTable::const_iterator i = mHeaders.begin(); i != mHeaders.end(); ++i)
+   {
+      w.write(i->first.begin(), i->first.size());
+      w.write(": ", 2);
+      w.write(i->second.begin(), i->second.size());
+      crlf(w);
+   }
+}
+
+size_t
+Message::encodeHeader(char* buffer, size_t size) const
+{
+   Writer w(buffer, size);
+   encodeHeader(w);
+
+   return w.size();
+}
+
+ostream&
+Message::encodeHeader(ostream& os) const
+{
+   Writer counter;
+   encodeHeader(counter);
+
+   vector<char> buffer(counter.size());
+   if (!buffer.empty())
    {
-      os << i->first
-         << colon
-         << i->second
-         << crlf;
+      os.write(&buffer[0], encodeHeader(&buffer[0], buffer.size()));
    }
 
    return os;
@@ -306,41 +448,86 @@ Message::preparse()
 #endif
 }
 
+// end-line: "-------" transaction flag
+static void
+encodeEndLine(Writer& w, const Message& m)
+{
+   w.write("-------", 7);
+   w.write(m.transaction());
+
+   switch (m.status())
+   {
+      case Message::Continued:
+         w.put('+');
+         break;
+      case Message::Complete:
+         w.put('$');
+         break;
+      case Message::Interrupted:
+         w.put('#');
+         break;
+      default:
+         abort();
+   }
+}
+
+void
+Message::encodeContents(Writer& w) const
+{
+   if (!contents().empty())
+   {
+      crlf(w);
+      w.write(contents().data(), contents().size());
+   }
+
+   if (status() != Message::Streaming)
+   {
+      encodeEndLine(w, *this);
+   }
+}
+
+size_t
+Message::encodeContents(char* buffer, size_t size) const
+{
+   Writer w(buffer, size);
+   encodeContents(w);
+
+   return w.size();
+}
+
 ostream&
 Message::encodeContents(ostream& os) const
 {
+   // !cb! contents may be large; stream them rather than copying
    if (!contents().empty())
    {
       os << "\r\n";
       os << contents();
    }
 
-   if (status() == Message::Streaming)
+   if (status() != Message::Streaming)
    {
-      return os;
-   }
+      vector<char> buffer(transaction().size() + 8);
 
-   os << "-------";
-   os << transaction();
+      Writer w(&buffer[0], buffer.size());
+      encodeEndLine(w, *this);
 
-   switch (status())
-   {
-      case Message::Continued:
-         os << '+';
-         break;
-      case Message::Complete:
-         os << '$';
-         break;
-      case Message::Interrupted:
-         os << '#';
-         break;
-      default:
-         abort();
+      os.write(&buffer[0], w.size());
    }
 
    return os;
 }
 
+size_t
+Message::encode(char* buffer, size_t size) const
+{
+   Writer w(buffer, size);
+   encodeHeader(w);
+   encodeContents(w);
+
+   return w.size();
+}
+
 ostream&
 msrp::operator<<(ostream& os, const Message& msg)
 {
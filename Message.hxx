@@ -1,7 +1,6 @@
 #ifndef MSRP_MESSAGE_HXX
 #define MSRP_MESSAGE_HXX
 
-#include <map>
 #include <ostream>
 #include <string>
 
@@ -12,6 +11,7 @@
 #include <rutil/Data.hxx>
 
 #include "msrp/Header.hxx"
+#include "msrp/HeaderTable.hxx"
 #include "msrp/ParseException.hxx"
 
 namespace msrp
@@ -22,6 +22,8 @@ namespace parser
 struct Message;
 }
 
+class Writer;
+
 class Message
 {
    public:
@@ -41,34 +43,51 @@ class Message
          Streaming
       };
 
+      // Unparsed headers either refer into a shared copy of the header block
+      // (OverlayHeaders) or are copied into strings (CopyHeaders).
+      enum HeaderMode
+      {
+         CopyHeaders,
+         OverlayHeaders
+      };
+
       // !cb! You may choose to instantiate Message in any way you like--the
       // constructor is public--but if you use the factory method, you get the
       // advantage of allocating from an object pool specialized for Message
       // objects.  In a relay situation especially, this results in reduced
       // CPU consumption and decreased heap fragmentation.  The object is
-      // automatically freed back to the pool on destruction.  You can also
+      // automatically recycled by the pool on destruction.  You can also
       // avoid the exception-throwing lazy parser code by calling preparse().
 
       // parse a message from network buffer contents
-      static boost::shared_ptr<Message> factory(const asio::const_buffer&);
+      static boost::shared_ptr<Message> factory(const asio::const_buffer&,
+            const HeaderMode = OverlayHeaders);
       static boost::shared_ptr<Message> factory();
 
       Message();
+      Message(const Message&);
+      ~Message();
+
+      Message& operator=(const Message&);
+
+      // Return the message to its default-constructed state, keeping any
+      // storage that can be reused.  Used by MessagePool when recycling.
+      void clear();
 
       // Create a response template from this message.
       boost::shared_ptr<Message> response(unsigned int code, const std::string& phrase) const;
 
       const std::string& transaction() const { return mTransaction; }
-      std::string& transaction() { return mTransaction; }
+      std::string& transaction() { ++mRevision; return mTransaction; }
 
       const unsigned int statusCode() const { return mStatusCode; }
-      unsigned int& statusCode() { return mStatusCode; }
+      unsigned int& statusCode() { ++mRevision; return mStatusCode; }
 
       const std::string& statusPhrase() const { return mStatusPhrase; }
-      std::string& statusPhrase() { return mStatusPhrase; }
+      std::string& statusPhrase() { ++mRevision; return mStatusPhrase; }
 
       const Method& method() const { return mMethod; }
-      Method& method() { return mMethod; }
+      Method& method() { ++mRevision; return mMethod; }
 
       const MsgStatus status() const { return mStatus; }
       MsgStatus& status() { return mStatus; }
@@ -79,52 +98,138 @@ class Message
       template<typename HeaderT>
       const typename HeaderT::Value& header() const
       {
-         return lazyStorage<HeaderT>().getConst(mHeaders);
+         if (!parsed<HeaderT>())
+         {
+            HeaderTable::Range r;
+            if (!mHeaders.find(HeaderT::Slot, r))
+            {
+               throw ParseException(HeaderT::Key, codeContext());
+            }
+
+            Message& nc = const_cast<Message&>(*this);
+
+            HeaderT::parse(r.begin(), r.end(), nc.storage<HeaderT>());
+
+            mHeaders.erase(HeaderT::Slot);
+            mParsed |= bit<HeaderT>();
+         }
+
+         return const_cast<Message&>(*this).storage<HeaderT>();
       }
 
       template<typename HeaderT>
       typename HeaderT::Value& header()
       {
-         return lazyStorage<HeaderT>().get(mHeaders);
+         ++mRevision;
+
+         typename HeaderT::Value& value = storage<HeaderT>();
+
+         if (!parsed<HeaderT>())
+         {
+            HeaderTable::Range r;
+            if (mHeaders.find(HeaderT::Slot, r))
+            {
+               HeaderT::parse(r.begin(), r.end(), value);
+
+               mHeaders.erase(HeaderT::Slot);
+            }
+
+            mParsed |= bit<HeaderT>();
+         }
+
+         return value;
       }
 
       template<typename HeaderT>
       typename HeaderT::Value& headerRef()
       {
-         return lazyStorage<HeaderT>().value();
+         ++mRevision;
+         mParsed |= bit<HeaderT>();
+
+         return storage<HeaderT>();
       }
 
       template<typename HeaderT>
       bool exists() const
       {
-         return lazyStorage<HeaderT>().parsed() || exists(HeaderT::Key);
+         return parsed<HeaderT>() || mHeaders.exists(HeaderT::Slot);
+      }
+
+      // true if the header has been parsed or assigned
+      template<typename HeaderT>
+      bool parsed() const
+      {
+         return (mParsed & bit<HeaderT>()) != 0;
+      }
+
+      // The unparsed value of a header, if it is present and has not been
+      // parsed or assigned yet.  Lets a caller match a header without
+      // parsing or copying it.
+      template<typename HeaderT>
+      bool raw(HeaderTable::Range& value) const
+      {
+         return !parsed<HeaderT>() && mHeaders.find(HeaderT::Slot, value);
+      }
+
+      // The URI at the given position of a path header.  An unparsed header
+      // is scanned for that URI alone and left unparsed, so the full path is
+      // only built when header<>() asks for it.  Returns false if the header
+      // is absent or too short.
+      template<typename HeaderT>
+      bool pathAt(std::size_t index, Uri& uri) const
+      {
+         HeaderTable::Range r;
+         if (raw<HeaderT>(r))
+         {
+            return parsePathElement(r.begin(), r.end(), index, uri);
+         }
+
+         if (!parsed<HeaderT>())
+         {
+            return false;
+         }
+
+         const Path& path = const_cast<Message&>(*this).storage<HeaderT>();
+         if (index >= path.size())
+         {
+            return false;
+         }
+
+         uri = path[index];
+
+         return true;
       }
 
       // extension headers
       const std::string& header(const std::string& key) const
       {
-         using std::map;
-         using std::string;
-
-         map<string, string>::const_iterator i = mHeaders.find(key);
-         if (i == mHeaders.end())
+         // !cb! materialises the header, mHeaders is mutable
+         const std::string* value = mHeaders.get(key);
+         if (!value)
          {
             throw ParseException(key, codeContext());
          }
 
-         return i->second;
+         return *value;
       }
 
       std::string& header(const std::string& key)
       {
+         ++mRevision;
          return mHeaders[key];
       }
 
       bool exists(const std::string& key) const
       {
-         return mHeaders.find(key) != mHeaders.end();
+         return mHeaders.exists(key);
       }
 
+      // !cb! Bumped by every non-const accessor that can change the encoded
+      // header (status and contents excluded), so callers can tell whether a
+      // previous encoding is still valid.  Read headers through a const
+      // reference to avoid spurious changes.
+      unsigned int revision() const { return mRevision; }
+
       // Parse all header contents up front.  This may be desirable in
       // applications where performance is not critical and you don't
       // want to worry about surrounding all header<> calls in try-catch
@@ -135,6 +240,17 @@ class Message
       // message IDs if they are not already set.
       bool prepare();
 
+      // !cb! Direct encoding.  The char* forms write at most size bytes and
+      // return the number of bytes the encoding needs, so a null buffer
+      // gives the exact size and a result larger than size means the buffer
+      // was too small.  The ostream forms are thin wrappers over these.
+      void encodeHeader(Writer&) const;
+      void encodeContents(Writer&) const;
+
+      std::size_t encodeHeader(char* buffer, std::size_t size) const;
+      std::size_t encodeContents(char* buffer, std::size_t size) const;
+      std::size_t encode(char* buffer, std::size_t size) const;
+
       std::ostream& encodeHeader(std::ostream&) const;
       std::ostream& encodeContents(std::ostream&) const;
 
@@ -142,41 +258,67 @@ class Message
       friend struct parser::Message;
 
       // unparsed
-      mutable std::map<std::string, std::string> mHeaders;
-
-      // parsed
-      #define DefineHeader(h) h lazy##h
-      DefineHeader(FromPath);           // From-Path
-      DefineHeader(ToPath);             // To-Path
-      DefineHeader(UsePath);            // Use-Path
-      DefineHeader(MessageId);          // Message-ID
-      DefineHeader(ContentLength);      // Content-Length
-      DefineHeader(ContentType);        // Content-Type
-      DefineHeader(ByteRange);          // Byte-Range
-      DefineHeader(Expires);            // Expires
-      DefineHeader(MinExpires);         // Min-Expires
-      DefineHeader(Status);             // Status
-      DefineHeader(SuccessReport);      // Success-Report
-      DefineHeader(FailureReport);      // Failure-Report
+      mutable HeaderTable mHeaders;
+
+      unsigned int mRevision;
+
+      // !cb! Parsed header values.  The parsed state of every header is kept
+      // in one bitmap indexed by HeaderHash slot, and headers that are rare
+      // on the relay path live out of line in Extended, which is only
+      // allocated when one of them is used.
+      struct Extended
+      {
+         Extended() :
+            mExpires(0),
+            mMinExpires(0)
+         {}
+
+         Path mUsePath;
+         unsigned int mExpires;
+         unsigned int mMinExpires;
+         StatusTuple mStatus;
 #ifdef ENABLE_AUTHTUPLE
-      DefineHeader(WWWAuthenticate);    // WWW-Authenticate
-      DefineHeader(AuthenticationInfo); // Authentication-Info
-      DefineHeader(Authorization);      // Authorization
+         AuthTuple mWWWAuthenticate;
+         AuthTuple mAuthenticationInfo;
+         AuthTuple mAuthorization;
 #endif
-      #undef DefineHeader
+      };
+
+      Extended& extended()
+      {
+         if (!mExtended)
+         {
+            mExtended = new Extended;
+         }
+
+         return *mExtended;
+      }
 
       template<typename HeaderT>
-      const HeaderT& lazyStorage() const
+      static unsigned int bit()
       {
-         return const_cast<Message*>(this)->lazyStorage<HeaderT>();
+         return 1u << HeaderT::Slot;
       }
 
       template<typename HeaderT>
-      HeaderT& lazyStorage()
+      typename HeaderT::Value& storage()
       {
          std::abort();
       }
 
+      mutable unsigned int mParsed;
+
+      Path mFromPath;
+      Path mToPath;
+      std::string mMessageId;
+      Mime mContentType;
+      ByteRangeTuple mByteRange;
+      unsigned int mContentLength;
+      int mFailureReport;
+      bool mSuccessReport;
+
+      Extended* mExtended;
+
       unsigned int mStatusCode;
 
       std::string mTransaction;
@@ -192,28 +334,28 @@ class Message
 std::ostream&
 operator<<(std::ostream&, const Message&);
 
-#define HeaderLinkage(h) \
-   template<> inline h& \
-   Message::lazyStorage<h>() \
+#define HeaderLinkage(h, member) \
+   template<> inline h::Value& \
+   Message::storage<h>() \
    { \
-      return lazy##h; \
+      return member; \
    }
-HeaderLinkage(FromPath);
-HeaderLinkage(ToPath);
-HeaderLinkage(UsePath);
-HeaderLinkage(MessageId);
-HeaderLinkage(ContentLength);
-HeaderLinkage(ContentType);
-HeaderLinkage(ByteRange);
-HeaderLinkage(Expires);
-HeaderLinkage(MinExpires);
-HeaderLinkage(Status);
-HeaderLinkage(SuccessReport);
-HeaderLinkage(FailureReport);
+HeaderLinkage(FromPath, mFromPath);
+HeaderLinkage(ToPath, mToPath);
+HeaderLinkage(UsePath, extended().mUsePath);
+HeaderLinkage(MessageId, mMessageId);
+HeaderLinkage(ContentLength, mContentLength);
+HeaderLinkage(ContentType, mContentType);
+HeaderLinkage(ByteRange, mByteRange);
+HeaderLinkage(Expires, extended().mExpires);
+HeaderLinkage(MinExpires, extended().mMinExpires);
+HeaderLinkage(Status, extended().mStatus);
+HeaderLinkage(SuccessReport, mSuccessReport);
+HeaderLinkage(FailureReport, mFailureReport);
 #ifdef ENABLE_AUTHTUPLE
-HeaderLinkage(WWWAuthenticate);
-HeaderLinkage(AuthenticationInfo);
-HeaderLinkage(Authorization);
+HeaderLinkage(WWWAuthenticate, extended().mWWWAuthenticate);
+HeaderLinkage(AuthenticationInfo, extended().mAuthenticationInfo);
+HeaderLinkage(Authorization, extended().mAuthorization);
 #endif
 #undef HeaderLinkage
 
@@ -2,18 +2,19 @@
 #include <cassert>
 #include <cctype>
 #include <cstring>
+#include <map>
 #include <utility>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <boost/algorithm/string.hpp>
 
-#include <boost/spirit/phoenix.hpp>
-
 #include <rutil/Logger.hxx>
 
 #include "msrp/System.hxx"
 #include "msrp/MessageBuffer.hxx"
+#include "msrp/Mutex.hxx"
 #include "msrp/ParseException.hxx"
 
 #define RESIPROCATE_SUBSYSTEM resip::Subsystem::NONE
@@ -24,39 +25,137 @@ using namespace std;
 using namespace asio;
 
 // !cb! Amount of data to withhold from the buffer owner to avoid mistaking an
-// end token for contents before an entire message has been received.  Should
-// be the maximum size of a transaction ID plus the 7-dash end token delimiter.
-const size_t MessageBuffer::Safety = 32;
+// end token for contents before an entire message has been received: the
+// 7-dash delimiter, a transaction ID of up to 32 characters (RFC 4975) and
+// the continuation flag.
+const size_t MessageBuffer::Safety = 7 + 32 + 1;
+
+// !cb! Buffer extents are shared between every MessageBuffer in the process
+// and recycled by size, so that a burst of large messages on a few
+// connections doesn't leave each of them holding its own worst-case buffer.
+class ExtentPool
+{
+   public:
+      ~ExtentPool()
+      {
+         for (FreeMap::iterator i = mFree.begin(); i != mFree.end(); ++i)
+         {
+            for (vector<char*>::iterator j = i->second.begin(); j != i->second.end(); ++j)
+            {
+               delete[] *j;
+            }
+         }
+      }
+
+      char* allocate(size_t size)
+      {
+         {
+            ScopedLock lock(mMutex);
+
+            FreeMap::iterator i = mFree.find(size);
+            if (i != mFree.end() && !i->second.empty())
+            {
+               char* extent = i->second.back();
+               i->second.pop_back();
+
+               return extent;
+            }
+         }
+
+         return new char[size];
+      }
+
+      void free(char* extent, size_t size)
+      {
+         {
+            ScopedLock lock(mMutex);
+
+            vector<char*>& extents = mFree[size];
+            if (extents.size() < Retain)
+            {
+               extents.push_back(extent);
+
+               return;
+            }
+         }
+
+         delete[] extent;
+      }
+
+   private:
+      // idle extents kept per size class
+      static const size_t Retain = 16;
+
+      typedef map<size_t, vector<char*> > FreeMap;
+      FreeMap mFree;
 
-MessageBuffer::MessageBuffer(size_t size) :
-   mBufferSize(size), mStored(0), mState(Status)
+      Mutex mMutex;
+};
+
+static ExtentPool Extents;
+
+MessageBuffer::MessageBuffer(size_t size, size_t limit) :
+   mBuffer(0), mBufferSize(size), mInitialSize(size),
+   mLimit(max(size, limit)), mStored(0), mState(Status)
 {
-   mBuffer.reset(new char[mBufferSize]);
+   mBuffer = Extents.allocate(mBufferSize);
 
    reset();
+}
+
+MessageBuffer::~MessageBuffer()
+{
+   Extents.free(mBuffer, mBufferSize);
+}
+
+mutable_buffer
+MessageBuffer::mutableBuffer()
+{
+   if (mStored == mBufferSize && mState != Complete)
+   {
+      // !cb! Out of space with a message still in progress; SEND contents
+      // would have been drained by erase(), so this is a large AUTH, REPORT
+      // or response that has to be held until it is complete.
+      if (mBufferSize >= mLimit)
+      {
+         throw Exception("message exceeds buffer limit", codeContext());
+      }
+
+      resize(min(mBufferSize * 2, mLimit));
+   }
+
+   return mutable_buffer(&mBuffer[mStored], mBufferSize - mStored);
+}
 
-   // status line parser
-   mParser = spirit::str_p("MSRP")
-      >> +spirit::blank_p
-      >> (
-            +( spirit::alpha_p
-             | spirit::digit_p
-             | '.' | '-' | '+' | '%' | '='
-           )
-         )[phoenix::var(mTid) = phoenix::construct_<string>(phoenix::arg1, phoenix::arg2)]
-      >> spirit::blank_p
-      >> (
-            boost::spirit::str_p("AUTH")
-               [phoenix::var(mMethod) = phoenix::val(Message::AUTH)]
-          | boost::spirit::str_p("SEND")
-               [phoenix::var(mMethod) = phoenix::val(Message::SEND)]
-          | boost::spirit::str_p("REPORT")
-               [phoenix::var(mMethod) = phoenix::val(Message::REPORT)]
-          | +(boost::spirit::anychar_p - boost::spirit::eol_p)
-               [phoenix::var(mMethod) = phoenix::val(Message::Response)]
-         )
-      >> spirit::ch_p('\r')
-      >> spirit::ch_p('\n');
+void
+MessageBuffer::resize(size_t size)
+{
+   assert(size >= mStored);
+
+   char* buffer = Extents.allocate(size);
+
+   memcpy(buffer, mBuffer, mStored);
+
+   rebase(mStatusRange, mBuffer, buffer);
+   rebase(mHeaderRange, mBuffer, buffer);
+   rebase(mContentRange, mBuffer, buffer);
+   rebase(mTokenRange, mBuffer, buffer);
+
+   Extents.free(mBuffer, mBufferSize);
+
+   mBuffer = buffer;
+   mBufferSize = size;
+}
+
+void
+MessageBuffer::rebase(iterator_range<const_iterator>& r, const char* from, const char* to)
+{
+   if (begin(r) != 0)
+   {
+      r = make_iterator_range<const_iterator>(
+         to + distance(from, begin(r)),
+         to + distance(from, end(r)));
+   }
 }
 
 void
@@ -68,10 +167,10 @@ MessageBuffer::read(size_t size)
    }
    else
    {
-      if (mStored == mBufferSize)
+      if (mStored + size > mBufferSize)
       {
-         // Use MessageBuffer::erase to free up buffer space after preparsing.
-         throw Exception("buffer space exhausted, call erase", codeContext());
+         // Only read into the space returned by mutableBuffer().
+         throw Exception("read exceeds buffer space", codeContext());
       }
    }
 
@@ -90,8 +189,8 @@ MessageBuffer::read(size_t size)
    mStored += size;
 
    iterator_range<const_iterator> range = make_iterator_range<const_iterator>(
-         &mBuffer.get()[pos],
-         &mBuffer.get()[mStored]);
+         &mBuffer[pos],
+         &mBuffer[mStored]);
 
    // !cb! iterator advances after each successful delimiter search
    switch (mState)
@@ -176,14 +275,14 @@ MessageBuffer::reset()
    {
       const_iterator i = end(mTokenRange);
 
-      while (i < mBuffer.get() + mStored && isspace(*i))
+      while (i < mBuffer + mStored && isspace(*i))
       {
          ++i;
       }
 
       mStored -= offset(i);
 
-      memmove(mBuffer.get(), i, mStored);
+      memmove(mBuffer, i, mStored);
    }
    else
    {
@@ -195,6 +294,12 @@ MessageBuffer::reset()
    mState = Status;
 
    resetRanges();
+
+   // hand the extra space from an oversized message back to the pool
+   if (mBufferSize > mInitialSize && mStored <= mInitialSize)
+   {
+      resize(mInitialSize);
+   }
 }
 
 void
@@ -215,7 +320,7 @@ MessageBuffer::setContentRange()
 
          if (s)
          {
-            mContentRange = make_iterator_range(mBuffer.get(), &mBuffer.get()[s]);
+            mContentRange = make_iterator_range(mBuffer, &mBuffer[s]);
          }
       }
       else if (!empty(mHeaderRange))
@@ -225,7 +330,7 @@ MessageBuffer::setContentRange()
          if (s > Safety)
          {
             mContentRange = make_iterator_range(end(mHeaderRange),
-               const_cast<const_iterator>(&mBuffer.get()[mStored - Safety]));
+               const_cast<const_iterator>(&mBuffer[mStored - Safety]));
          }
       }
    }
@@ -233,25 +338,112 @@ MessageBuffer::setContentRange()
    mStatus = Message::Streaming;
 }
 
+namespace
+{
+
+bool
+isTidChar(const char c)
+{
+   return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+      || c == '.' || c == '-' || c == '+' || c == '%' || c == '=';
+}
+
+bool
+isBlank(const char c)
+{
+   return c == ' ' || c == '\t';
+}
+
+// true if [first, last) is exactly the given method name; -1 if it only
+// starts with it, which the status line grammar rejects
+int
+matchMethod(const char* first, const char* last, const char* method)
+{
+   const size_t size = strlen(method);
+
+   if (static_cast<size_t>(last - first) < size || memcmp(first, method, size) != 0)
+   {
+      return 0;
+   }
+
+   return static_cast<size_t>(last - first) == size ? 1 : -1;
+}
+
+}
+
+// !cb! Hand-written scanner for
+//    "MSRP" 1*blank transact-id blank (method / status-code phrase) CRLF
+// which used to be a Spirit rule built in every constructor.
 bool
 MessageBuffer::getTransaction(iterator_range<const_iterator>& i)
 {
-   spirit::parse_info<> result = spirit::parse(begin(i), end(i), mParser);
+   const_iterator p = begin(i);
+   const const_iterator last = end(i);
 
-   if (result.hit)
+   if (last - p < 4 || memcmp(p, "MSRP", 4) != 0)
    {
-      if (!mTid.empty())
-      {
-         mStatusRange = make_iterator_range(begin(i), result.stop);
+      return false;
+   }
 
-         // !cb! result.stop iterator is within begin(i) and end(i)
-         i = make_iterator_range(result.stop, end(i));
+   p += 4;
 
-         return true;
+   const const_iterator blanks = p;
+   while (p != last && isBlank(*p))
+   {
+      ++p;
+   }
+
+   const const_iterator tid = p;
+   while (p != last && isTidChar(*p))
+   {
+      ++p;
+   }
+
+   if (blanks == tid || tid == p || p == last || !isBlank(*p))
+   {
+      return false;
+   }
+
+   const const_iterator tidEnd = p++;
+
+   const const_iterator line = p;
+   while (p != last && *p != '\r' && *p != '\n')
+   {
+      ++p;
+   }
+
+   if (line == p || last - p < 2 || p[0] != '\r' || p[1] != '\n')
+   {
+      return false;
+   }
+
+   const char* const Methods[] = { "AUTH", "SEND", "REPORT" };
+   const Message::Method Values[] = { Message::AUTH, Message::SEND, Message::REPORT };
+
+   mMethod = Message::Response;
+
+   for (size_t m = 0; m < sizeof(Methods) / sizeof(Methods[0]); ++m)
+   {
+      const int match = matchMethod(line, p, Methods[m]);
+
+      if (match < 0)
+      {
+         return false;
+      }
+      else if (match > 0)
+      {
+         mMethod = Values[m];
+         break;
       }
    }
 
-   return false;
+   mTid.assign(tid, tidEnd);
+
+   mStatusRange = make_iterator_range(begin(i), p + 2);
+
+   i = make_iterator_range(p + 2, last);
+
+   return true;
 }
 
 bool
@@ -339,7 +531,9 @@ MessageBuffer::getEndToken(iterator_range<const_iterator>& r)
 
       advance(keypos, -7);
 
-      if (strncmp(keypos, marker.c_str(), marker.size()) == 0)
+      // the flag must have arrived too, or the token is incomplete
+      if (keypos + marker.size() < end(r)
+            && strncmp(keypos, marker.c_str(), marker.size()) == 0)
       {
          mTokenRange = make_iterator_range(keypos, keypos + marker.size() + 1); // + 1 = [+$#]
 
@@ -356,7 +550,7 @@ MessageBuffer::getEndToken(iterator_range<const_iterator>& r)
             else
             {
                // !cb! erase has been called; content spans entire buffer
-               mContentRange = make_iterator_range(const_cast<const_iterator>(mBuffer.get()),
+               mContentRange = make_iterator_range(const_cast<const_iterator>(mBuffer),
                      begin(mTokenRange));
             }
          }
@@ -404,28 +598,37 @@ MessageBuffer::contents() const
 size_t
 MessageBuffer::offset(const_iterator i) const
 {
-   return distance(const_cast<const_iterator>(mBuffer.get()), i);
+   return distance(const_cast<const_iterator>(mBuffer), i);
 }
 
 void
 MessageBuffer::erase()
 {
-   if (mState == Content)
+   if (mState == Content && empty(mTokenRange))
    {
-      if (empty(mTokenRange) && !empty(mContentRange))
+      // !cb! keep whatever hasn't been handed out as contents yet: the
+      // withheld tail, or everything after the headers if the contents
+      // were too short to release any of it
+      size_t off = 0;
+
+      if (!empty(mContentRange))
       {
-         const size_t off = offset(end(mContentRange));
+         off = offset(end(mContentRange));
+      }
+      else if (!empty(mHeaderRange))
+      {
+         off = offset(end(mHeaderRange));
+      }
 
-         if (off < mStored && off + Safety == mStored)
-         {
-            memmove(mBuffer.get(), &mBuffer.get()[off], Safety);
+      if (off < mStored)
+      {
+         memmove(mBuffer, &mBuffer[off], mStored - off);
 
-            mStored = Safety;
+         mStored -= off;
 
-            resetRanges();
+         resetRanges();
 
-            return;
-         }
+         return;
       }
    }
 
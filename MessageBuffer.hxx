@@ -7,9 +7,8 @@
 #include <stdexcept>
 #include <string>
 
-#include <boost/scoped_ptr.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
-#include <boost/spirit.hpp>
 #include <boost/range.hpp>
 
 #include <asio/buffer.hpp>
@@ -20,7 +19,7 @@
 namespace msrp
 {
 
-class MessageBuffer
+class MessageBuffer : private boost::noncopyable
 {
    public:
       struct Exception : public msrp::Exception
@@ -30,16 +29,32 @@ class MessageBuffer
          {}
       };
 
-      MessageBuffer(std::size_t size = 65536);
+      // !cb! The buffer starts out at `size' bytes and grows on demand, in
+      // extents drawn from a shared pool, up to `limit' bytes.  SEND requests
+      // are drained with erase() as they arrive, so only AUTH, REPORT and
+      // responses should ever cause it to grow; the extra space is returned to
+      // the pool once the oversized message has been reset out of the buffer.
+      MessageBuffer(std::size_t size = 65536, std::size_t limit = 1048576);
 
-      asio::mutable_buffer mutableBuffer()
+      ~MessageBuffer();
+
+      // free space for the next read; grows the buffer if it is full
+      asio::mutable_buffer mutableBuffer();
+
+      asio::const_buffer buffer() const
       {
-         return asio::mutable_buffer(&mBuffer.get()[mStored], mBufferSize - mStored);
+         return asio::const_buffer(mBuffer, mStored);
       }
 
-      asio::const_buffer buffer() const
+      // current allocation and the most it may grow to
+      std::size_t capacity() const
+      {
+         return mBufferSize;
+      }
+
+      std::size_t limit() const
       {
-         return asio::const_buffer(mBuffer.get(), mStored);
+         return mLimit;
       }
 
       // contents in context of the message
@@ -95,9 +110,11 @@ class MessageBuffer
    private:
       typedef const char* const_iterator;
 
-      boost::scoped_ptr<char> mBuffer;
+      char* mBuffer;
 
       std::size_t mBufferSize;
+      std::size_t mInitialSize;
+      std::size_t mLimit;
       std::size_t mStored;
 
       State mState;
@@ -109,8 +126,6 @@ class MessageBuffer
       // transaction ID
       std::string mTid;
 
-      boost::spirit::rule<> mParser;
-
       boost::iterator_range<const_iterator> mStatusRange;
       boost::iterator_range<const_iterator> mHeaderRange;
       boost::iterator_range<const_iterator> mContentRange;
@@ -124,6 +139,11 @@ class MessageBuffer
 
       std::size_t offset(const_iterator i) const;
 
+      // move the buffer contents into a new extent of `size' bytes
+      void resize(std::size_t size);
+
+      void rebase(boost::iterator_range<const_iterator>&, const char* from, const char* to);
+
       // erase pointers into the buffer without erasing the buffer
       void resetRanges();
 
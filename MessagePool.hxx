@@ -1,63 +1,14 @@
 #ifndef MSRP_MESSAGEPOOL_HXX
 #define MSRP_MESSAGEPOOL_HXX
 
-#include <boost/pool/object_pool.hpp>
-
-#include <boost/shared_ptr.hpp>
+#include "msrp/Message.hxx"
+#include "msrp/ObjectPool.hxx"
 
 namespace msrp
 {
 
-class Message;
-
-// Use MessagePool to decrease heap fragmentation, speed message allocation,
-// and decrease the working set size in applications that allocate a lot of
-// messages concurrently.  Note: It is very important that Message objects
-// allocated by MessagePool not outlive the pool itself, or the destructor
-// will crash.  A check should be probably be added and an exception thrown
-// in this case (in debug mode).
-
-class MessagePool
-{
-   public:
-      static MessagePool& instance()
-      {
-         return Instance;
-      }
-
-      class Destructor
-      {
-         public:
-            Destructor(boost::object_pool<Message>& pool) :
-               mPool(pool)
-            {}
-
-            void operator()(Message* m)
-            {
-               mPool.destroy(m);
-            }
-
-         private:
-            boost::object_pool<Message>& mPool;
-      };
-
-      inline boost::shared_ptr<Message> allocate()
-      {
-         boost::shared_ptr<Message> msg(mPool.construct(), Destructor(mPool));
-
-         if (msg.get() == 0)
-         {
-            throw std::bad_alloc();
-         }
-
-         return msg;
-      }
-
-   private:
-      boost::object_pool<Message> mPool;
-
-      static MessagePool Instance;
-};
+// Message::factory() allocates from MessagePool::instance(); see ObjectPool.
+typedef ObjectPool<Message> MessagePool;
 
 }
 
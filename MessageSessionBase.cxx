@@ -4,9 +4,32 @@ using namespace msrp;
 using namespace std;
 using namespace boost;
 
+MessageSessionBase::MessageSessionBase() :
+   mSize(0), mTransferred(0), mComplete(false), mInterrupted(false)
+{}
+
 MessageSessionBase::MessageSessionBase(const Message& m) :
-   mMessage(m), mSize(0), mTransferred(0), mComplete(false), mInterrupted(false)
+   mSize(0), mTransferred(0), mComplete(false), mInterrupted(false)
 {
+   reset(m);
+}
+
+MessageSessionBase::~MessageSessionBase()
+{}
+
+void
+MessageSessionBase::reset(const Message& m)
+{
+   mMessage = m;
+   mMessageId.clear();
+
+   mSize = 0;
+   mTransferred = 0;
+   mComplete = false;
+   mInterrupted = false;
+
+   mLastTransfer = posix_time::ptime();
+
    try
    {
       if (mMessage.exists<ByteRange>())
@@ -21,10 +44,25 @@ MessageSessionBase::MessageSessionBase(const Message& m) :
    }
    catch (const ParseException&)
    {}
+
+   intern();
 }
 
-MessageSessionBase::~MessageSessionBase()
-{}
+void
+MessageSessionBase::clear()
+{
+   mMessage.clear();
+   mMessageId.clear();
+
+   mSize = 0;
+   mTransferred = 0;
+   mComplete = false;
+   mInterrupted = false;
+
+   mLastTransfer = posix_time::ptime();
+
+   mCompleteEvent.disconnect_all_slots();
+}
 
 size_t
 MessageSessionBase::size() const
@@ -74,19 +112,24 @@ MessageSessionBase::message() const
    return mMessage;
 }
 
-const string
+const string&
 MessageSessionBase::messageId() const
 {
-   ScopedLock lock(mMutex);
+   return mMessageId;
+}
 
+void
+MessageSessionBase::intern()
+{
    try
    {
-      return message().header<MessageId>();
+      if (mMessage.exists<MessageId>())
+      {
+         mMessageId = mMessage.header<MessageId>();
+      }
    }
    catch (const ParseException&)
    {}
-
-   return std::string();
 }
 
 signal0<void>&
@@ -30,17 +30,32 @@ class MessageSessionBase
       const Message& message() const;
       Message& message();
 
-      const std::string messageId() const;
+      // interned when the session is created
+      const std::string& messageId() const;
 
       boost::signal0<void>& onComplete();
 
       const boost::posix_time::ptime& lastTransfer() const;
 
    protected:
+      // for ObjectPool; reset() before use
+      MessageSessionBase();
+
+      // start over with a new message, as the constructor does
+      void reset(const Message&);
+
+      // drop the message and disconnect every slot, keeping storage
+      void clear();
+
+      // copy the Message-ID out of mMessage
+      void intern();
+
       mutable Mutex mMutex;
 
       Message mMessage;
 
+      std::string mMessageId;
+
       std::size_t mSize;
       std::size_t mTransferred;
 
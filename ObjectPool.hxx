@@ -0,0 +1,417 @@
+#ifndef MSRP_OBJECTPOOL_HXX
+#define MSRP_OBJECTPOOL_HXX
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+#include "msrp/Atomic.hxx"
+
+namespace msrp
+{
+
+// Use ObjectPool to decrease heap fragmentation, speed allocation, and
+// decrease the working set size in applications that allocate a lot of
+// short-lived objects concurrently.  T must be default-constructible and
+// have a clear() that returns it to its default state, keeping any storage
+// that can be reused; the pool calls it when an object is released, so an
+// object is constructed once and then recycled.  Note: It is very important
+// that objects allocated by a pool not outlive the pool itself, or the
+// destructor will crash.  The pool returned by instance() is never
+// destroyed.
+
+// !cb! Each thread allocates from its own shard, a plain vector of cleared
+// objects, so the common case takes no lock and no atomic beyond the usage
+// counters.  An object freed on another thread is pushed onto its owning
+// shard's remote stack and collected by the owner the next time its cache
+// runs dry.  Shards that grow past Retain spill half their cache to a global
+// free list, which empty shards take from.  Both stacks are push-by-CAS and
+// drain-by-exchange, so there is no ABA problem.  When a thread exits its
+// shard is orphaned and handed to the next new thread rather than deleted,
+// so remote frees never point at freed memory.
+//
+// trim() can't touch another live thread's cache, so it bumps a trim count
+// instead; each thread compares the count with its shard's on release and
+// empties its own cache when it has moved on.
+
+template<typename T>
+class ObjectPool : private boost::noncopyable
+{
+   public:
+      static ObjectPool& instance()
+      {
+         static ObjectPool* pool = new ObjectPool;
+
+         return *pool;
+      }
+
+      ObjectPool() :
+         mShard(&ObjectPool::orphan)
+      {}
+
+      ~ObjectPool();
+
+      boost::shared_ptr<T> allocate();
+
+      // Delete cached objects held by the calling thread, the global free
+      // list and orphaned shards.  Returns the number of objects freed.
+      // Other running threads empty their own caches the next time they
+      // release an object; a thread that never does keeps up to Retain.
+      std::size_t trim();
+
+      // objects handed out and not yet released
+      std::size_t inUse() const { return mInUse.load(); }
+
+      // highest inUse() seen
+      std::size_t highWater() const { return mHighWater.load(); }
+
+      // objects allocated from the heap, in use or cached
+      std::size_t allocated() const { return mAllocated.load(); }
+
+   private:
+      struct Shard;
+
+      struct Slot
+      {
+         T object;
+         Shard* owner;
+         Slot* next;
+      };
+
+      struct Shard
+      {
+         Shard(ObjectPool& p) : pool(p), trims(0) {}
+
+         ObjectPool& pool;
+         std::vector<Slot*> cache;
+         Atomic<Slot*> remote;
+
+         // mTrims as of the last time this shard was emptied
+         long trims;
+      };
+
+      class Destructor
+      {
+         public:
+            Destructor(Slot* slot) :
+               mSlot(slot)
+            {}
+
+            void operator()(T*)
+            {
+               mSlot->owner->pool.release(mSlot);
+            }
+
+         private:
+            Slot* mSlot;
+      };
+
+      enum { Retain = 1024 };
+
+      Shard& shard();
+      void refill(Shard&);
+      void release(Slot*);
+
+      // empty a shard's cache and remote stack
+      std::size_t trim(Shard&);
+
+      static void orphan(Shard*);
+
+      static void push(Atomic<Slot*>&, Slot* first, Slot* last);
+      static std::size_t destroy(Slot* list);
+      static std::size_t destroy(std::vector<Slot*>& cache);
+
+      boost::thread_specific_ptr<Shard> mShard;
+
+      Atomic<Slot*> mGlobal;
+
+      Atomic<long> mInUse;
+      Atomic<long> mHighWater;
+      Atomic<long> mAllocated;
+
+      // calls to trim() so far
+      Atomic<long> mTrims;
+
+      // guards mShards and mOrphans; the pool is shared between threads
+      // whether or not MSRP_REENTRANT is defined
+      boost::mutex mMutex;
+
+      std::vector<Shard*> mShards;
+      std::vector<Shard*> mOrphans;
+};
+
+template<typename T>
+ObjectPool<T>::~ObjectPool()
+{
+   // !cb! don't let thread_specific_ptr orphan our shard into a dying pool
+   mShard.release();
+
+   destroy(mGlobal.exchange(0));
+
+   for (typename std::vector<Shard*>::iterator i = mShards.begin(); i != mShards.end(); ++i)
+   {
+      Shard* shard = *i;
+
+      destroy(shard->cache);
+      destroy(shard->remote.exchange(0));
+
+      delete shard;
+   }
+}
+
+template<typename T>
+void
+ObjectPool<T>::orphan(Shard* shard)
+{
+   ObjectPool& pool = shard->pool;
+
+   boost::mutex::scoped_lock lock(pool.mMutex);
+
+   pool.mOrphans.push_back(shard);
+}
+
+template<typename T>
+typename ObjectPool<T>::Shard&
+ObjectPool<T>::shard()
+{
+   Shard* shard = mShard.get();
+
+   if (!shard)
+   {
+      boost::mutex::scoped_lock lock(mMutex);
+
+      if (!mOrphans.empty())
+      {
+         shard = mOrphans.back();
+         mOrphans.pop_back();
+      }
+      else
+      {
+         shard = new Shard(*this);
+         mShards.push_back(shard);
+      }
+
+      shard->trims = mTrims.load();
+
+      mShard.reset(shard);
+   }
+
+   return *shard;
+}
+
+template<typename T>
+void
+ObjectPool<T>::push(Atomic<Slot*>& stack, Slot* first, Slot* last)
+{
+   Slot* head;
+
+   do
+   {
+      head = stack.load();
+      last->next = head;
+   }
+   while (!stack.compareExchange(head, first));
+}
+
+template<typename T>
+std::size_t
+ObjectPool<T>::destroy(Slot* list)
+{
+   std::size_t count = 0;
+
+   while (list)
+   {
+      Slot* next = list->next;
+      delete list;
+      list = next;
+
+      ++count;
+   }
+
+   return count;
+}
+
+template<typename T>
+std::size_t
+ObjectPool<T>::destroy(std::vector<Slot*>& cache)
+{
+   const std::size_t count = cache.size();
+
+   for (typename std::vector<Slot*>::iterator i = cache.begin(); i != cache.end(); ++i)
+   {
+      delete *i;
+   }
+
+   cache.clear();
+   std::vector<Slot*>(cache).swap(cache);
+
+   return count;
+}
+
+template<typename T>
+void
+ObjectPool<T>::refill(Shard& shard)
+{
+   // objects this thread allocated and others freed first, then whatever
+   // other shards have spilled
+   Slot* list = shard.remote.exchange(0);
+
+   if (!list)
+   {
+      list = mGlobal.exchange(0);
+   }
+
+   while (list)
+   {
+      shard.cache.push_back(list);
+      list = list->next;
+   }
+}
+
+template<typename T>
+boost::shared_ptr<T>
+ObjectPool<T>::allocate()
+{
+   Shard& shard = this->shard();
+
+   if (shard.cache.empty())
+   {
+      refill(shard);
+   }
+
+   Slot* slot;
+
+   if (!shard.cache.empty())
+   {
+      slot = shard.cache.back();
+      shard.cache.pop_back();
+   }
+   else
+   {
+      slot = new Slot;
+      mAllocated.fetchAdd(1);
+   }
+
+   slot->owner = &shard;
+
+   const long used = mInUse.fetchAdd(1) + 1;
+
+   long high = mHighWater.load();
+   while (used > high && !mHighWater.compareExchange(high, used))
+   {
+      high = mHighWater.load();
+   }
+
+   return boost::shared_ptr<T>(&slot->object, Destructor(slot));
+}
+
+template<typename T>
+void
+ObjectPool<T>::release(Slot* slot)
+{
+   slot->object.clear();
+
+   mInUse.fetchSub(1);
+
+   Shard* owner = slot->owner;
+
+   if (owner != mShard.get())
+   {
+      push(owner->remote, slot, slot);
+      return;
+   }
+
+   owner->cache.push_back(slot);
+
+   if (owner->cache.size() > Retain)
+   {
+      // spill the older half to the global list
+      const std::size_t spill = owner->cache.size() / 2;
+
+      for (std::size_t i = 0; i + 1 < spill; ++i)
+      {
+         owner->cache[i]->next = owner->cache[i + 1];
+      }
+
+      push(mGlobal, owner->cache[0], owner->cache[spill - 1]);
+
+      owner->cache.erase(owner->cache.begin(), owner->cache.begin() + spill);
+   }
+
+   if (owner->trims != mTrims.load())
+   {
+      mAllocated.fetchSub(trim(*owner));
+   }
+}
+
+template<typename T>
+std::size_t
+ObjectPool<T>::trim(Shard& shard)
+{
+   shard.trims = mTrims.load();
+
+   return destroy(shard.cache) + destroy(shard.remote.exchange(0));
+}
+
+template<typename T>
+std::size_t
+ObjectPool<T>::trim()
+{
+   mTrims.fetchAdd(1);
+
+   std::size_t freed = 0;
+
+   Shard* current = mShard.get();
+   if (current)
+   {
+      freed += trim(*current);
+   }
+
+   freed += destroy(mGlobal.exchange(0));
+
+   {
+      // orphans are only ever touched under the lock
+      boost::mutex::scoped_lock lock(mMutex);
+
+      for (typename std::vector<Shard*>::iterator i = mOrphans.begin(); i != mOrphans.end(); ++i)
+      {
+         freed += trim(**i);
+      }
+   }
+
+   mAllocated.fetchSub(freed);
+
+   return freed;
+}
+
+}
+
+#endif
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
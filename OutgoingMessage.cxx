@@ -1,9 +1,8 @@
-#include <sstream>
-
 #include <rutil/Logger.hxx>
 
 #include "msrp/System.hxx"
 #include "msrp/Message.hxx"
+#include "msrp/ObjectPool.hxx"
 #include "msrp/OutgoingMessage.hxx"
 #include "msrp/Session.hxx"
 
@@ -14,13 +13,70 @@ using namespace std;
 using namespace boost;
 using namespace asio;
 
-OutgoingMessage::OutgoingMessage(shared_ptr<Session> s, const Message& m) :
-   MessageSessionBase(m), mSession(s)
+OutgoingMessage::OutgoingMessage() :
+   mFragment(0), mTemplateRevision(0), mChunks(0)
 {}
 
+OutgoingMessage::OutgoingMessage(shared_ptr<Session> s, const Message& m) :
+   mFragment(0), mTemplateRevision(0), mChunks(0)
+{
+   reset(s, m);
+}
+
 OutgoingMessage::~OutgoingMessage()
 {}
 
+shared_ptr<OutgoingMessage>
+OutgoingMessage::factory(shared_ptr<Session> s, const Message& m)
+{
+   shared_ptr<OutgoingMessage> msg = ObjectPool<OutgoingMessage>::instance().allocate();
+
+   msg->reset(s, m);
+
+   return msg;
+}
+
+void
+OutgoingMessage::reset(shared_ptr<Session> s, const Message& m)
+{
+   MessageSessionBase::reset(m);
+
+   mSession = s;
+
+   // reports are routed on the Message-ID, so it has to be fixed now
+   if (mMessageId.empty())
+   {
+      mMessage.prepare();
+
+      intern();
+   }
+}
+
+void
+OutgoingMessage::clear()
+{
+   MessageSessionBase::clear();
+
+   mSession.reset();
+
+   // the scratch vectors keep their capacity for the next message
+   mQueued.clear();
+   mFragment = 0;
+   mEncoded.clear();
+   mTemplate.clear();
+   mTemplateRevision = 0;
+   mTransaction.clear();
+   mChunks = 0;
+
+   mTimeline.attach(0);
+   mTimeline.clear();
+
+   // !cb! cheaper than constructing the signals again
+   mContext.disconnect_all_slots();
+   mReport.disconnect_all_slots();
+   mData.disconnect_all_slots();
+}
+
 void
 OutgoingMessage::cancel()
 {
@@ -96,6 +152,8 @@ OutgoingMessage::process(shared_ptr<const Message> m)
 {
    ScopedLock lock(mMutex);
 
+   mTimeline.mark(Trace::Reported);
+
    if (!onReport().empty())
    {
       onReport()(*m);
@@ -106,6 +164,27 @@ OutgoingMessage::process(shared_ptr<const Message> m)
    return false;
 }
 
+// Width of the chunk counter appended to the base transaction ID, and the
+// longest transaction ID RFC 4975 allows, which the base is cut to fit.
+static const size_t ChunkDigits = 8;
+static const size_t MaxTransaction = 32;
+
+void
+OutgoingMessage::chunkTransaction(string& tid) const
+{
+   static const char hex[] = "0123456789abcdef";
+
+   tid.assign(mTransaction);
+   tid.resize(mTransaction.size() + ChunkDigits);
+
+   unsigned int chunk = mChunks;
+   for (size_t i = tid.size(); i > mTransaction.size(); --i)
+   {
+      tid[i - 1] = hex[chunk & 0xf];
+      chunk >>= 4;
+   }
+}
+
 void
 OutgoingMessage::start()
 {
@@ -117,22 +196,84 @@ OutgoingMessage::start()
 
    Message& m = message();
 
-   m.header<ByteRange>().start = transferred() + 1;
-   m.header<ByteRange>().end = ByteRange::Unknown;
+   // anything that modified the message since the last chunk invalidates
+   // the template
+   bool stale = mTemplate.empty() || m.revision() != mTemplateRevision;
+
+   if (mTransaction.empty())
+   {
+      m.prepare();
+      mTransaction = m.transaction().substr(0, MaxTransaction - ChunkDigits);
+   }
+
+   ++mChunks;
+
+   mTimeline.mark(Trace::Scheduled);
+
+   // every chunk is a new transaction
+   chunkTransaction(m.transaction());
+
+   ByteRangeTuple& range = m.header<ByteRange>();
+   range.start = transferred() + 1;
+   range.end = ByteRange::Unknown;
 
    if (!mContext.empty())
    {
+      const unsigned int revision = m.revision();
+
       onContextRequired()(m);
+
+      stale = stale || m.revision() != revision;
+   }
+
+   if (stale)
+   {
+      // header plus the blank line before contents
+      const size_t size = m.encodeHeader(0, 0) + 2;
+
+      mTemplate.resize(size);
+
+      Writer w(&mTemplate[0], size);
+      m.encodeHeader(w);
+      w.write("\r\n", 2);
+
+      for (size_t i = 0; i < Writer::Marks; ++i)
+      {
+         mMarks[i] = w.marked(static_cast<Writer::Mark>(i));
+      }
+
+      ::send(session(), const_buffer(&mTemplate[0], size));
    }
+   else
+   {
+      // !cb! Only the transaction ID and Byte-Range start changed, both
+      // under our control: copy the template around them.
+      const size_t tidBegin = mMarks[Writer::TransactionBegin];
+      const size_t tidEnd = mMarks[Writer::TransactionEnd];
+      const size_t rangeBegin = mMarks[Writer::RangeStartBegin];
+      const size_t rangeEnd = mMarks[Writer::RangeStartEnd];
 
-   stringstream stream;
+      assert(tidEnd - tidBegin == m.transaction().size());
+      assert(rangeBegin >= tidEnd);
 
-   m.encodeHeader(stream);
+      const size_t size = mTemplate.size()
+         - (rangeEnd - rangeBegin) + digits(range.start);
 
-   stream << '\r'
-          << '\n';
+      mEncoded.resize(size);
+
+      Writer w(&mEncoded[0], size);
+      w.write(&mTemplate[0], tidBegin);
+      w.write(m.transaction());
+      w.write(&mTemplate[tidEnd], rangeBegin - tidEnd);
+      w.write(range.start);
+      w.write(&mTemplate[rangeEnd], mTemplate.size() - rangeEnd);
+
+      assert(w.size() == size);
+
+      ::send(session(), const_buffer(&mEncoded[0], size));
+   }
 
-   ::send(session(), const_buffer(stream.str().c_str(), stream.str().size()));
+   mTemplateRevision = m.revision();
 
    mFragment = 0;
 }
@@ -158,21 +299,31 @@ OutgoingMessage::end(shared_ptr<Connection> c)
       m.status() = Message::Continued;
    }
 
-   stringstream stream;
-
    m.contents().clear();
-   m.encodeContents(stream);
 
-   ::send(c, const_buffer(stream.str().c_str(), stream.str().size()));
+   const size_t size = m.encodeContents(0, 0);
+
+   mEncoded.resize(size);
+   m.encodeContents(&mEncoded[0], size);
+
+   ::send(c, const_buffer(&mEncoded[0], size));
 
    if (complete() || interrupted())
    {
+      mTimeline.mark(Trace::LastByte);
+
       c->scheduler().erase(shared_from_this());
 
       if (!onComplete().empty())
       {
          onComplete()();
       }
+
+      shared_ptr<Session> s(mSession.lock());
+      if (s)
+      {
+         s->onOutgoingComplete(*this);
+      }
    }
 }
 
@@ -279,6 +430,8 @@ OutgoingMessage::StreamFunctor::operator()(const const_buffer& b)
 
    mOutgoing.mFragment += buffer_size(b);
 
+   mOutgoing.mTimeline.mark(Trace::FirstByte);
+
    mOutgoing.mLastTransfer = posix_time::microsec_clock::local_time();
 
    // !cb! If all data has been sent, end the outgoing message.
@@ -2,6 +2,8 @@
 #define MSRP_OUTGOINGMESSAGE_HXX
 
 #include <cassert>
+#include <string>
+#include <vector>
 
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/function.hpp>
@@ -11,8 +13,10 @@
 #include <rutil/Data.hxx>
 
 #include "msrp/Connection.hxx"
+#include "msrp/Encode.hxx"
 #include "msrp/MessageSessionBase.hxx"
 #include "msrp/Scheduler.hxx"
+#include "msrp/Trace.hxx"
 
 namespace msrp
 {
@@ -20,6 +24,8 @@ namespace msrp
 class Message;
 class Session;
 
+template<typename T> class ObjectPool;
+
 class OutgoingMessage :
    public boost::noncopyable,
    public boost::enable_shared_from_this<OutgoingMessage>,
@@ -42,6 +48,10 @@ class OutgoingMessage :
 
       OutgoingMessage(boost::shared_ptr<Session>, const Message&);
 
+      // recycled through an ObjectPool
+      static boost::shared_ptr<OutgoingMessage> factory(boost::shared_ptr<Session>,
+            const Message&);
+
       virtual ~OutgoingMessage();
 
       // !cb! Interrupt the outgoing data stream, cancelling the message.
@@ -66,6 +76,14 @@ class OutgoingMessage :
       friend class Scheduler;
       friend class Scheduler::Thread;
       friend class StreamContext;
+      friend class ObjectPool<OutgoingMessage>;
+
+      OutgoingMessage();
+
+      void reset(boost::shared_ptr<Session>, const Message&);
+
+      // called by ObjectPool on release
+      void clear();
 
       // process an incoming report
       bool process(boost::shared_ptr<const Message>);
@@ -83,6 +101,27 @@ class OutgoingMessage :
 
       std::size_t mFragment;
 
+      // encoding scratch space for chunk headers and end-lines
+      std::vector<char> mEncoded;
+
+      // !cb! Chunk headers differ only in transaction ID and Byte-Range
+      // start, so the context message is encoded once into mTemplate with
+      // the positions of those fields recorded, and later chunks are patched
+      // from it.  The template is rebuilt when the context message is
+      // modified anywhere other than those two fields in start().
+      std::vector<char> mTemplate;
+      std::size_t mMarks[Writer::Marks];
+      unsigned int mTemplateRevision;
+
+      // per-chunk transaction IDs are mTransaction plus a fixed-width counter
+      std::string mTransaction;
+      unsigned int mChunks;
+
+      // stages from Session::stream() to the report
+      Trace::Timeline mTimeline;
+
+      void chunkTransaction(std::string&) const;
+
       boost::shared_ptr<Session> session() const;
 
       boost::weak_ptr<Session> mSession;
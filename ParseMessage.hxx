@@ -1,11 +1,9 @@
 #ifndef MSRP_PARSEMESSAGE_HXX
 #define MSRP_PARSEMESSAGE_HXX
 
+#include <boost/noncopyable.hpp>
 #include <boost/spirit.hpp>
 #include <boost/spirit/actor.hpp>
-#include <boost/spirit/attribute/closure.hpp>
-#include <boost/spirit/phoenix/primitives.hpp>
-#include <boost/spirit/phoenix/binders.hpp>
 
 #include <resip/stack/Symbols.hxx>
 
@@ -17,68 +15,137 @@ namespace msrp
 namespace parser
 {
 
-struct MessageClosure : boost::spirit::closure<MessageClosure, msrp::Message>
-{
-   member1 msg;
-};
+// !cb! The message grammar writes straight into the Message being parsed
+// (target) rather than into a closure that is then copied, so a parse costs
+// no Message construction or assignment.  Set target for each parse with a
+// Target, so that a throwing action can't leave the per-thread grammar
+// pointing at a message that is about to be freed.
 
-struct Message : boost::spirit::grammar<Message, MessageClosure::context_t>
+struct Message : boost::spirit::grammar<Message>
 {
+   Message() :
+      target(0)
+   {}
+
+   mutable msrp::Message* target;
+
+   class Target : private boost::noncopyable
+   {
+      public:
+         Target(const Message& grammar, msrp::Message* m) :
+            mGrammar(grammar)
+         {
+            mGrammar.target = m;
+         }
+
+         ~Target()
+         {
+            mGrammar.target = 0;
+         }
+
+      private:
+         const Message& mGrammar;
+   };
+
    template<typename ScannerT>
    struct definition
    {
-      template<typename Actor, typename T>
-         inline boost::spirit::ref_value_actor<T, Actor>
-      assign_property(T& ref)
+      struct transaction_action
       {
-         return boost::spirit::ref_value_actor<T, Actor>(ref);
-      }
+         transaction_action(const Message& self) : mSelf(self) {}
+
+         template<typename Iterator>
+         inline void operator()(Iterator first, Iterator last) const
+         {
+            mSelf.target->transaction().assign(first, last);
+         }
+
+         const Message& mSelf;
+      };
+
+      struct phrase_action
+      {
+         phrase_action(const Message& self) : mSelf(self) {}
 
-      // !cb! actors required to disambiguate Message method calls
+         template<typename Iterator>
+         inline void operator()(Iterator first, Iterator last) const
+         {
+            mSelf.target->statusPhrase().assign(first, last);
+         }
+
+         const Message& mSelf;
+      };
 
-      struct transaction_actor
+      struct status_action
       {
-         template<typename T, typename Iterator>
-         inline void act(T& ref, Iterator const& first, Iterator const& last) const
+         status_action(const Message& self) : mSelf(self) {}
+
+         inline void operator()(unsigned int code) const
          {
-            ref().transaction().assign(first, last);
+            mSelf.target->statusCode() = code;
          }
+
+         const Message& mSelf;
       };
- 
-      struct phrase_actor
+
+      struct method_action
       {
-         template<typename T, typename Iterator>
-         inline void act(T& ref, Iterator const& first, Iterator const& last) const
+         method_action(const Message& self) : mSelf(self) {}
+
+         inline void operator()(msrp::Message::Method method) const
          {
-            ref().statusPhrase().assign(first, last);
+            mSelf.target->method() = method;
          }
+
+         const Message& mSelf;
       };
- 
-      struct status_actor
+
+      struct response_action
       {
-         template<typename T, typename Value>
-         inline void act(T& ref, const Value& v) const
+         response_action(const Message& self) : mSelf(self) {}
+
+         template<typename Iterator>
+         inline void operator()(Iterator, Iterator) const
          {
-            ref().statusCode() = v;
+            mSelf.target->method() = msrp::Message::Response;
          }
+
+         const Message& mSelf;
       };
 
-      struct method_actor
+      // Header keys and values are recorded as views into the buffer being
+      // parsed; see HeaderTable.
+
+      struct key_action
       {
-         template<typename T, typename Value>
-         inline void act(T& ref, const Value& value) const
+         key_action(HeaderTable::Range& key) :
+            mKey(key)
+         {}
+
+         template<typename Iterator>
+         inline void operator()(Iterator first, Iterator last) const
          {
-            ref().method() = value;
+            mKey = HeaderTable::Range(first, last);
          }
+
+         HeaderTable::Range& mKey;
       };
 
-      struct response_actor
+      struct value_action
       {
-         template<typename T, typename Iterator>
-         inline void act(T& ref, Iterator const&, Iterator const&) const
+         value_action(const Message& self, const HeaderTable::Range& key) :
+            mSelf(self),
+            mKey(key)
+         {}
+
+         template<typename Iterator>
+         inline void operator()(Iterator first, Iterator last) const
          {
-            ref().method() = msrp::Message::Response;
+            mSelf.target->mHeaders.insert(mKey, HeaderTable::Range(first, last));
          }
+
+         const Message& mSelf;
+         const HeaderTable::Range& mKey;
       };
 
       definition(const Message& self)
@@ -86,11 +153,10 @@ struct Message : boost::spirit::grammar<Message, MessageClosure::context_t>
          base = (
              status = boost::spirit::str_p("MSRP")
                 >> +boost::spirit::blank_p
-                >> transaction
-                      [assign_property<transaction_actor>(self.msg)]
+                >> transaction[transaction_action(self)]
                 >> +boost::spirit::blank_p
                 >> (
-                     response[assign_property<response_actor>(self.msg)] | request
+                     response[response_action(self)] | request
                    )
                 >> resip::Symbols::CRLF
                 >> *header
@@ -102,33 +168,30 @@ struct Message : boost::spirit::grammar<Message, MessageClosure::context_t>
                 boost::spirit::digit_p | '.' | '-' | '+' | '%' | '='
                 ),
  
-             request = methods[assign_property<method_actor>(self.msg)],
+             request = methods[method_action(self)],
  
              response =
-                boost::spirit::uint_p[assign_property<status_actor>(self.msg)]
+                boost::spirit::uint_p[status_action(self)]
                 >> +boost::spirit::blank_p
                 >> (
                    +(boost::spirit::anychar_p - boost::spirit::eol_p)
                    )
-                   [assign_property<phrase_actor>(self.msg)],
+                   [phrase_action(self)],
  
              header =
                 (boost::spirit::alpha_p >> *(boost::spirit::alnum_p | '-'))
-                     [boost::spirit::assign_a(headerKey)]
+                     [key_action(headerKey)]
                 >> resip::Symbols::COLON
                 >> resip::Symbols::SPACE
                 >> (
                     *(boost::spirit::anychar_p - boost::spirit::eol_p)
                    )
-                   [boost::spirit::insert_at_a(
-                      phoenix::bind(&msrp::Message::mHeaders)(self.msg)(),
-                      headerKey)
-                   ]
+                   [value_action(self, headerKey)]
                 >> resip::Symbols::CRLF
          );
       }
 
-      std::string headerKey;
+      HeaderTable::Range headerKey;
 
       boost::spirit::rule<ScannerT> base;
       boost::spirit::subrule<0> status;
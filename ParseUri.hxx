@@ -43,7 +43,7 @@ struct Uri : boost::spirit::grammar<Uri, UriClosure::context_t>
          template<typename T, typename Iterator>
          inline void act(T& ref, Iterator const& first, Iterator const& last) const
          {
-            ref().scheme().assign(first, last);
+            ref().scheme(std::string(first, last));
          }
       };
 
@@ -52,7 +52,7 @@ struct Uri : boost::spirit::grammar<Uri, UriClosure::context_t>
          template<typename T, typename Iterator>
          inline void act(T& ref, Iterator const&, Iterator const&) const
          {
-            ref().delimiter() = true;
+            ref().delimiter(true);
          }
       };
 
@@ -61,7 +61,7 @@ struct Uri : boost::spirit::grammar<Uri, UriClosure::context_t>
          template<typename T, typename Iterator>
          inline void act(T& ref, Iterator const& first, Iterator const& last) const
          {
-            ref().host().assign(first, last);
+            ref().host(std::string(first, last));
          }
       };
 
@@ -70,7 +70,7 @@ struct Uri : boost::spirit::grammar<Uri, UriClosure::context_t>
          template<typename T, typename Iterator>
          inline void act(T& ref, Iterator const& first, Iterator const& last) const
          {
-            ref().session().assign(first, last);
+            ref().session(std::string(first, last));
          }
       };
 
@@ -79,7 +79,7 @@ struct Uri : boost::spirit::grammar<Uri, UriClosure::context_t>
          template<typename T, typename Value>
          inline void act(T& ref, const Value& p) const
          {
-            ref().port() = static_cast<unsigned short>(p);
+            ref().port(static_cast<unsigned short>(p));
          }
       };
 
@@ -88,7 +88,7 @@ struct Uri : boost::spirit::grammar<Uri, UriClosure::context_t>
          template<typename T, typename Iterator>
          inline void act(T& ref, Iterator const&, Iterator const&) const
          {
-            ref().transport() = std::string("tcp");
+            ref().transport("tcp");
          }
       };
 
@@ -97,7 +97,7 @@ struct Uri : boost::spirit::grammar<Uri, UriClosure::context_t>
          template<typename T, typename Iterator>
          inline void act(T& ref, Iterator const& first, Iterator const& last) const
          {
-            ref().user().assign(first, last - 1);
+            ref().user(std::string(first, last - 1));
          }
       };
 
@@ -4,6 +4,7 @@
 #include "msrp/AuthParser.hxx"
 #include "msrp/ByteRange.hxx"
 #include "msrp/LiteralBoolean.hxx"
+#include "msrp/Message.hxx"
 #include "msrp/ParserFactory.hxx"
 #include "msrp/ParseUri.hxx"
 #include "msrp/ParseMessage.hxx"
@@ -14,34 +15,59 @@ using namespace msrp;
 using namespace boost;
 
 template<typename ParserT>
-scoped_ptr<ParserT> ParserFactory<ParserT>::Instance;
+typename ParserFactory<ParserT>::Holder ParserFactory<ParserT>::Instance;
 
-template scoped_ptr<spirit::uint_parser<> > ParserFactory<spirit::uint_parser<> >::Instance;
+#define MSRP_PARSER_INSTANCE(P) \
+   template ParserFactory<P >::Holder ParserFactory<P >::Instance
 
-template scoped_ptr<spirit::uint_parser<unsigned, 16> >
-   ParserFactory<spirit::uint_parser<unsigned, 16> >::Instance;
+typedef spirit::uint_parser<unsigned, 16> HexParser;
+typedef spirit::uint_parser<unsigned, 16, 8, 8> Hex8Parser;
 
-template scoped_ptr<spirit::uint_parser<unsigned, 16, 8, 8> >
-   ParserFactory<spirit::uint_parser<unsigned, 16, 8, 8> >::Instance;
+MSRP_PARSER_INSTANCE(spirit::uint_parser<>);
+MSRP_PARSER_INSTANCE(HexParser);
+MSRP_PARSER_INSTANCE(Hex8Parser);
 
 #ifdef ENABLE_AUTHTUPLE
-template scoped_ptr<parser::Auth<true> >
-   ParserFactory<parser::Auth<true> >::Instance;
-template scoped_ptr<parser::Auth<false> >
-   ParserFactory<parser::Auth<false> >::Instance;
-template scoped_ptr<QopParser> ParserFactory<QopParser>::Instance;
+MSRP_PARSER_INSTANCE(parser::Auth<true>);
+MSRP_PARSER_INSTANCE(parser::Auth<false>);
+MSRP_PARSER_INSTANCE(QopParser);
 #endif
 
-template scoped_ptr<parser::LiteralBoolean> ParserFactory<parser::LiteralBoolean>::Instance;
-template scoped_ptr<parser::ByteRange> ParserFactory<parser::ByteRange>::Instance;
-template scoped_ptr<parser::FailureReport> ParserFactory<parser::FailureReport>::Instance;
-template scoped_ptr<parser::Message> ParserFactory<parser::Message>::Instance;
-template scoped_ptr<parser::MessageId> ParserFactory<parser::MessageId>::Instance;
-template scoped_ptr<parser::Mime> ParserFactory<parser::Mime>::Instance;
-template scoped_ptr<parser::Path> ParserFactory<parser::Path>::Instance;
-template scoped_ptr<parser::Status> ParserFactory<parser::Status>::Instance;
-template scoped_ptr<parser::SuccessReport> ParserFactory<parser::SuccessReport>::Instance;
-template scoped_ptr<parser::Uri> ParserFactory<parser::Uri>::Instance;
+MSRP_PARSER_INSTANCE(parser::LiteralBoolean);
+MSRP_PARSER_INSTANCE(parser::ByteRange);
+MSRP_PARSER_INSTANCE(parser::FailureReport);
+MSRP_PARSER_INSTANCE(parser::Message);
+MSRP_PARSER_INSTANCE(parser::MessageId);
+MSRP_PARSER_INSTANCE(parser::Mime);
+MSRP_PARSER_INSTANCE(parser::Path);
+MSRP_PARSER_INSTANCE(parser::Status);
+MSRP_PARSER_INSTANCE(parser::SuccessReport);
+MSRP_PARSER_INSTANCE(parser::Uri);
+
+#undef MSRP_PARSER_INSTANCE
+
+void
+msrp::initializeParsers()
+{
+   static const char Warmup[] =
+      "MSRP init SEND\r\n"
+      "To-Path: msrp://127.0.0.1:2855/init;tcp\r\n"
+      "From-Path: msrp://127.0.0.1:2855/init;tcp\r\n"
+      "Message-ID: init\r\n"
+      "Byte-Range: 1-4/4\r\n"
+      "Content-Type: text/plain\r\n"
+      "\r\n";
+
+   shared_ptr<Message> m = Message::factory(
+      asio::const_buffer(Warmup, sizeof(Warmup) - 1));
+
+   // the lazy fields are parsed on first access
+   m->header<ToPath>();
+   m->header<FromPath>();
+   m->header<MessageId>();
+   m->header<ByteRange>();
+   m->header<ContentType>();
+}
 
 // Copyright 2007 Chris Bond
 // 
@@ -1,32 +1,61 @@
 #ifndef MSRP_PARSERFACTORY_HXX
 #define MSRP_PARSERFACTORY_HXX
 
+#ifdef MSRP_REENTRANT
+#include <boost/thread/tss.hpp>
+#else
 #include <boost/scoped_ptr.hpp>
+#endif
 
 #include "msrp/Exception.hxx"
 #include "msrp/Report.hxx"
 
+#if defined(MSRP_REENTRANT) && !defined(BOOST_SPIRIT_THREADSAFE)
+#error MSRP_REENTRANT builds must also define BOOST_SPIRIT_THREADSAFE
+#endif
+
 namespace msrp
 {
 
+// !cb! Spirit grammars and their closures keep state for the parse in
+// progress (parser::Message even points at the message it is filling in),
+// so with MSRP_REENTRANT each thread gets its own instance of every parser.
+// Instances are created on first use in a thread; call initializeParsers()
+// in every thread that runs the io_service, before it does, to build and
+// warm them up ahead of any traffic.  SessionFactory::run() does this.
+
 template<typename Parser>
 class ParserFactory
 {
    public:
       static const Parser& get()
       {
-         if (Instance.get() == 0)
+         Parser* parser = Instance.get();
+
+         if (parser == 0)
          {
-            Instance.reset(new Parser);
+            parser = new Parser;
+            Instance.reset(parser);
          }
 
-         return *Instance;
+         return *parser;
       }
 
    private:
-      static boost::scoped_ptr<Parser> Instance;
+#ifdef MSRP_REENTRANT
+      typedef boost::thread_specific_ptr<Parser> Holder;
+#else
+      typedef boost::scoped_ptr<Parser> Holder;
+#endif
+
+      static Holder Instance;
 };
 
+// Build the calling thread's parsers and run a representative message
+// through them, so that no grammar definition is built on the first real
+// message.  Throws ParseException if the grammars reject the message.
+void initializeParsers();
+
 }
 
 #endif
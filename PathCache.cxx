@@ -0,0 +1,101 @@
+#ifdef MSRP_REENTRANT
+#include <boost/thread/tss.hpp>
+#endif
+
+#include "msrp/PathCache.hxx"
+
+using namespace msrp;
+using namespace std;
+using namespace boost;
+
+PathCache&
+PathCache::instance()
+{
+   // !cb! never destroyed; paths may be parsed during static destruction
+#ifdef MSRP_REENTRANT
+   static thread_specific_ptr<PathCache>* caches = new thread_specific_ptr<PathCache>;
+
+   PathCache* cache = caches->get();
+
+   if (cache == 0)
+   {
+      cache = new PathCache;
+      caches->reset(cache);
+   }
+#else
+   static PathCache* cache = new PathCache;
+#endif
+
+   return *cache;
+}
+
+bool
+PathCache::find(const char* first, const char* last, Path& path)
+{
+   const HeaderTable::Range text(first, last);
+
+   if (const Path* p = mCurrent.find(text))
+   {
+      path = *p;
+
+      return true;
+   }
+
+   if (const Path* p = mPrevious.find(text))
+   {
+      path = *p;
+
+      add(string(first, last), path);
+
+      return true;
+   }
+
+   return false;
+}
+
+void
+PathCache::insert(const char* first, const char* last, const Path& path)
+{
+   add(string(first, last), path);
+}
+
+size_t
+PathCache::size() const
+{
+   return mCurrent.size() + mPrevious.size();
+}
+
+void
+PathCache::add(const string& text, const Path& path)
+{
+   if (mCurrent.size() >= Generation)
+   {
+      mPrevious.swap(mCurrent);
+      mCurrent.clear();
+   }
+
+   mCurrent.set(text, path);
+}
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
@@ -0,0 +1,96 @@
+#ifndef MSRP_PATHCACHE_HXX
+#define MSRP_PATHCACHE_HXX
+
+#include <cstddef>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include "msrp/HashTable.hxx"
+#include "msrp/HeaderTable.hxx"
+#include "msrp/Uri.hxx"
+
+namespace msrp
+{
+
+// !cb! Parsed From-Path and To-Path values keyed by their text.  Every
+// chunk of a session carries the same paths, so a hit skips the parser and
+// hands back URIs that are already interned.  Entries live in two
+// generations: a hit in the old one moves it forward, and when the current
+// one fills up the old one is dropped, so the cache stays bounded and keeps
+// whatever is still in use.  With MSRP_REENTRANT each thread has a cache of
+// its own, as it has its own parsers, so a lookup takes no lock; the URIs in
+// it are still interned process-wide.
+
+class PathCache : private boost::noncopyable
+{
+   public:
+      enum { Generation = 512 };
+
+      // the calling thread's cache
+      static PathCache& instance();
+
+      bool find(const char* first, const char* last, Path&);
+      void insert(const char* first, const char* last, const Path&);
+
+      std::size_t size() const;
+
+   private:
+      struct TextTraits
+      {
+         static std::size_t hash(const std::string& s)
+         {
+            return hashBytes(s.data(), s.size());
+         }
+
+         static std::size_t hash(const HeaderTable::Range& r)
+         {
+            return hashBytes(r.begin(), r.size());
+         }
+
+         static bool equal(const std::string& a, const std::string& b)
+         {
+            return a == b;
+         }
+
+         static bool equal(const std::string& a, const HeaderTable::Range& b)
+         {
+            return a.size() == static_cast<std::size_t>(b.size())
+               && a.compare(0, a.size(), b.begin(), b.size()) == 0;
+         }
+      };
+
+      typedef HashTable<std::string, Path, TextTraits> Table;
+
+      void add(const std::string&, const Path&);
+
+      Table mCurrent;
+      Table mPrevious;
+};
+
+}
+
+#endif
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
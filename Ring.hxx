@@ -0,0 +1,152 @@
+#ifndef MSRP_RING_HXX
+#define MSRP_RING_HXX
+
+#include <cassert>
+#include <cstddef>
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+
+#include "msrp/Atomic.hxx"
+
+namespace msrp
+{
+
+// !cb! Bounded multi-producer, multi-consumer queue after Dmitry Vyukov's.
+// Each cell carries a sequence number saying whose turn it is: a producer
+// claims the cell at the tail when its sequence equals the tail position,
+// a consumer the cell at the head when it is one past the head.  Neither
+// side ever waits for the other, and push() fails instead of blocking
+// when the ring is full.  The capacity must be a power of two; T must be
+// default-constructible and assignable.
+
+template<typename T>
+class Ring : private boost::noncopyable
+{
+   public:
+      explicit Ring(std::size_t capacity) :
+         mCells(new Cell[capacity]), mMask(capacity - 1), mHead(0), mTail(0)
+      {
+         assert(capacity >= 2 && (capacity & mMask) == 0);
+
+         for (std::size_t i = 0; i < capacity; ++i)
+         {
+            mCells[i].sequence.store(i);
+         }
+      }
+
+      bool push(const T& value)
+      {
+         Cell* cell;
+         std::size_t pos = mTail.load();
+
+         for (;;)
+         {
+            cell = &mCells[pos & mMask];
+
+            const long diff = static_cast<long>(cell->sequence.load() - pos);
+
+            if (diff == 0)
+            {
+               if (mTail.compareExchange(pos, pos + 1))
+               {
+                  break;
+               }
+            }
+            else if (diff < 0)
+            {
+               // full
+               return false;
+            }
+
+            pos = mTail.load();
+         }
+
+         cell->value = value;
+         cell->sequence.store(pos + 1);
+
+         return true;
+      }
+
+      bool pop(T& value)
+      {
+         Cell* cell;
+         std::size_t pos = mHead.load();
+
+         for (;;)
+         {
+            cell = &mCells[pos & mMask];
+
+            const long diff = static_cast<long>(cell->sequence.load() - (pos + 1));
+
+            if (diff == 0)
+            {
+               if (mHead.compareExchange(pos, pos + 1))
+               {
+                  break;
+               }
+            }
+            else if (diff < 0)
+            {
+               // empty
+               return false;
+            }
+
+            pos = mHead.load();
+         }
+
+         value = cell->value;
+         cell->value = T();
+         cell->sequence.store(pos + mMask + 1);
+
+         return true;
+      }
+
+      std::size_t capacity() const
+      {
+         return mMask + 1;
+      }
+
+   private:
+      struct Cell
+      {
+         Atomic<std::size_t> sequence;
+         T value;
+      };
+
+      boost::scoped_array<Cell> mCells;
+      const std::size_t mMask;
+
+      // head and tail on separate cache lines
+      Atomic<std::size_t> mHead;
+      char mPad[64];
+      Atomic<std::size_t> mTail;
+};
+
+}
+
+#endif
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
@@ -3,6 +3,7 @@
 #include <rutil/Logger.hxx>
 
 #include "msrp/System.hxx"
+#include "msrp/AsyncLog.hxx"
 #include "msrp/Connection.hxx"
 #include "msrp/IncomingMessage.hxx"
 #include "msrp/OutgoingMessage.hxx"
@@ -91,7 +92,7 @@ Session::process(shared_ptr<const Message> m)
       }
       else
       {
-         WarningLog(<< "no single message handler; dropped");
+         MsrpWarningLog(<< "no single message handler; dropped");
 
          return shared_ptr<IncomingMessage>();
       }
@@ -99,21 +100,28 @@ Session::process(shared_ptr<const Message> m)
 
    if (mSession.empty())
    {
-      WarningLog(<< "no message session handler; message dropped");
+      MsrpWarningLog(<< "no message session handler; message dropped");
    }
    else
    {
-      shared_ptr<IncomingMessage> ms(new IncomingMessage(shared_from_this(), *m));
+      shared_ptr<IncomingMessage> ms(IncomingMessage::factory(shared_from_this(), *m));
+
+      // a message still in progress keeps its Message-ID; replacing it
+      // would drop the only reference to it
+      if (mIncoming.find(ms->messageId()))
+      {
+         MsrpWarningLog(<< "duplicate Message-ID " << ms->messageId() << "; message dropped");
+
+         return shared_ptr<IncomingMessage>();
+      }
 
       // !cb! Query the session and ask it to handle this new message session.
       // It can choose to accept or reject it.  If it accepts, we return the
       // session to Demultiplex and add it to the in-routes.
       if (mSession(ms))
       {
-         mIncoming.push_back(ms);
-
-         // remove the session from mIncoming when complete
-         ms->onComplete().connect(bind(&Session::onIncomingComplete, this, ms->messageId()));
+         // removed by onIncomingComplete()
+         mIncoming.set(ms->messageId(), ms);
 
          return ms;
       }
@@ -156,14 +164,23 @@ Session::stream(const Message& m)
       throw Exception("session not connected", codeContext());
    }
 
-   shared_ptr<OutgoingMessage> msg(new OutgoingMessage(shared_from_this(), m));
+   shared_ptr<OutgoingMessage> msg(OutgoingMessage::factory(shared_from_this(), m));
    assert(msg);
 
-   // remove the session from mOutgoing when complete
-   msg->onComplete().connect(bind(&Session::onOutgoingComplete, this, msg->messageId()));
+   if (mOutgoing.find(msg->messageId()))
+   {
+      throw Exception("duplicate Message-ID " + msg->messageId(), codeContext());
+   }
+
+   // removed by onOutgoingComplete()
+   mOutgoing.set(msg->messageId(), msg);
 
    shared_ptr<Connection> c(connection());
 
+   msg->mTimeline.attach(&c->trace());
+   msg->mTimeline.expectReport(m.exists<SuccessReport>() && m.header<SuccessReport>());
+   msg->mTimeline.mark(Trace::Queued);
+
    // outgoing message scheduler
    c->scheduler().queue(msg);
 
@@ -180,50 +197,45 @@ Session::stream(const Message& m)
 }
 
 void
-Session::onIncomingComplete(const string& id)
+Session::onIncomingComplete(const IncomingMessage& ms)
 {
    ScopedLock lock(mMutex);
 
-   vector<shared_ptr<IncomingMessage> >::iterator i = mIncoming.begin();
+   const shared_ptr<IncomingMessage>* i = mIncoming.find(ms.messageId());
 
-   for (; i != mIncoming.end(); ++i)
+   if (i && i->get() == &ms)
    {
-      if (i->get()->messageId() == id)
-      {
-         mIncoming.erase(i);
-         break;
-      }
+      mIncoming.erase(ms.messageId());
    }
 }
 
 void
-Session::onOutgoingComplete(const string& id)
+Session::onOutgoingComplete(const OutgoingMessage& msg)
 {
    ScopedLock lock(mMutex);
 
-   vector<shared_ptr<OutgoingMessage> >::iterator i = mOutgoing.begin();
+   const shared_ptr<OutgoingMessage>* i = mOutgoing.find(msg.messageId());
 
-   for (; i != mOutgoing.end(); ++i)
+   if (!i || i->get() != &msg)
    {
-      if (i->get()->messageId() == id)
-      {
-         shared_ptr<Connection> c(connection());
-         if (c)
-         {
-            // outgoing message scheduler
-            c->scheduler().erase(*i);
-
-            // !cb! Incoming report demuxer.  This is not correct.  We should
-            // store whether or not we expect reports back from the peer, and
-            // not remove the OutgoingMessage until we have received the final
-            // report if so.
-            c->demultiplexer().remove(*i);
-         }
-
-         mOutgoing.erase(i);
-
-         break;
-      }
+      return;
+   }
+
+   // keep the message alive until it is out of every container
+   const shared_ptr<OutgoingMessage> m(*i);
+
+   mOutgoing.erase(msg.messageId());
+
+   shared_ptr<Connection> c(connection());
+   if (c)
+   {
+      // outgoing message scheduler
+      c->scheduler().erase(m);
+
+      // !cb! The report route stays: the final REPORT only arrives after
+      // the last byte has gone out.  The demuxer holds a weak_ptr, so the
+      // entry lasts as long as the application keeps the message and is
+      // swept once it lets go.
    }
 }
 
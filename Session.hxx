@@ -12,6 +12,7 @@
 #include <rutil/Data.hxx>
 
 #include "msrp/Exception.hxx"
+#include "msrp/HashTable.hxx"
 #include "msrp/Message.hxx"
 #include "msrp/Mutex.hxx"
 #include "msrp/Uri.hxx"
@@ -43,7 +44,8 @@ class Session :
 
       const Path& address() const;
 
-      // !cb! create an outgoing message session with an initial context message
+      // !cb! create an outgoing message session with an initial context message;
+      // throws Exception if the Message-ID is already in use on this session
       boost::shared_ptr<OutgoingMessage> stream(const Message&);
 
       // !cb! fill in message headers like To-Path and From-Path
@@ -70,15 +72,21 @@ class Session :
 
       Path mPath;
 
+      // !cb! Message sessions in progress, by their interned Message-ID.  The
+      // messages call back on completion, so removal is a single hash probe
+      // and needs no signal connection per message.  Each table holds one
+      // message per Message-ID: a new message that reuses the ID of one in
+      // progress is refused, and a message only removes its own entry.
+
       // incoming messages
-      std::vector<boost::shared_ptr<IncomingMessage> > mIncoming;
+      HashTable<std::string, boost::shared_ptr<IncomingMessage> > mIncoming;
 
-      void onIncomingComplete(const std::string&);
+      void onIncomingComplete(const IncomingMessage&);
 
       // outgoing messages
-      std::vector<boost::shared_ptr<OutgoingMessage> > mOutgoing;
+      HashTable<std::string, boost::shared_ptr<OutgoingMessage> > mOutgoing;
 
-      void onOutgoingComplete(const std::string&);
+      void onOutgoingComplete(const OutgoingMessage&);
 
       boost::signal1<void, boost::shared_ptr<const Message> > mMessage;
       boost::signal1<bool, boost::shared_ptr<IncomingMessage> > mSession;
@@ -1,11 +1,18 @@
+#include <algorithm>
+
 #include <rutil/Inserter.hxx>
 #include <rutil/Logger.hxx>
 
 #include "msrp/System.hxx"
+#include "msrp/AsyncLog.hxx"
+#include "msrp/BlockPool.hxx"
 #include "msrp/Connection.hxx"
 #include "msrp/DnsService.hxx"
+#include "msrp/ParserFactory.hxx"
 #include "msrp/Session.hxx"
 #include "msrp/SessionFactory.hxx"
+#include "msrp/TargetHealth.hxx"
+#include "msrp/TargetSelector.hxx"
 
 using namespace msrp;
 using namespace std;
@@ -26,36 +33,73 @@ SessionFactory::~SessionFactory()
 io_service&
 SessionFactory::service()
 {
-   ScopedLock lock(mMutex);
-
    return mService;
 }
 
+DnsService&
+SessionFactory::dns()
+{
+   return mDns;
+}
+
+void
+SessionFactory::run()
+{
+   initializeParsers();
+
+   mService.run();
+}
+
 //ConnectionPool&
 //SessionFactory::connections()
 //{
-//   ScopedLock lock(mMutex);
-//
 //   return *mPool;
 //}
 
+Mutex&
+SessionFactory::stripe(const tcp::endpoint& target)
+{
+   return mStripes[HashTraits<tcp::endpoint>::hash(target) % Stripes];
+}
+
+shared_ptr<Connection>
+SessionFactory::pooled(const tcp::endpoint& target) const
+{
+   shared_ptr<Connection> c = mPool->lookup(target);
+
+   if (!c)
+   {
+      // accepted connections are only known by their peer
+      c = mPool->find(target);
+   }
+
+   return c;
+}
+
 shared_ptr<Session>
 SessionFactory::answer(const ip::tcp::endpoint& target, const Uri& self)
 {
-   ScopedLock lock(mMutex);
+   // !cb! Pool hits take no lock at all.  A miss serialises on the target's
+   // stripe and looks again, so that concurrent sessions to one peer share
+   // a connection while sessions to other peers are created in parallel.
+   shared_ptr<Connection> connection = mPool->lookup(target);
 
-   shared_ptr<Connection> connection = mPool->find(target);
-   if (connection)
+   if (!connection)
    {
-      return Session::factory(connection, self);
-   }
+      ScopedLock lock(stripe(target));
 
-   vector<ip::tcp::endpoint> endpoints;
-   endpoints.push_back(target);
+      connection = pooled(target);
 
-   connection = Connection::createAnswer(mService, endpoints, shared_ptr<ssl::context>());
+      if (!connection)
+      {
+         vector<ip::tcp::endpoint> endpoints;
+         endpoints.push_back(target);
 
-   mPool->add(connection);
+         connection = Connection::createAnswer(mService, endpoints, shared_ptr<ssl::context>());
+
+         mPool->add(connection);
+      }
+   }
 
    return Session::factory(connection, self);
 }
@@ -63,22 +107,9 @@ SessionFactory::answer(const ip::tcp::endpoint& target, const Uri& self)
 shared_ptr<Session>
 SessionFactory::answer(const Uri& peer, const Uri& self, Callback handler)
 {
-   ScopedLock lock(mMutex);
-
    try
    {
-      const ip::tcp::endpoint target = peer.endpoint();
-
-      shared_ptr<Connection> c = mPool->find(target);
-
-      if (c)
-      {
-         return Session::factory(c, self);
-      }
-      else
-      {
-         return answer(target, self);
-      }
+      return answer(peer.endpoint(), self);
    }
    catch (const asio::error&)
    {}
@@ -108,8 +139,6 @@ SessionFactory::answer(const Uri& peer, const Uri& self, Callback handler)
 shared_ptr<Session>
 SessionFactory::offer(const ip::tcp::endpoint& bind, const Uri& self)
 {
-   ScopedLock lock(mMutex);
-
    shared_ptr<Connection> connection(Connection::createOffer(mService, bind, shared_ptr<ssl::context>()));
 
    mPool->add(connection);
@@ -117,16 +146,6 @@ SessionFactory::offer(const ip::tcp::endpoint& bind, const Uri& self)
    return Session::factory(connection, self);
 }
 
-void
-SessionFactory::onSrvResult(const RequestInfo, const DNSResult<DnsSrvRecord>&)
-{
-   // !cb! use msrp::TargetSelector to select a targets, perform DNS
-   // queries on all targets, and add all the resulting endpoints to
-   // the Connection target list.
-
-   std::abort();
-}
-
 const vector<tcp::endpoint>
 makeEndpoints(const vector<ip::address>& addrs, unsigned short port)
 {
@@ -141,50 +160,201 @@ makeEndpoints(const vector<ip::address>& addrs, unsigned short port)
 }
 
 void
-SessionFactory::onDnsResult(const RequestInfo request, const vector<ip::address>& addrs)
+SessionFactory::onSrvResult(const RequestInfo request, const DnsResult<SrvRecord>& result)
 {
-   ScopedLock lock(mMutex);
-
-   const vector<tcp::endpoint> endpoints = makeEndpoints(addrs, request.peer.port());
+   // RFC 2782: a lone target of "." means the service is not available
+   vector<SrvRecord> records;
+   for (vector<SrvRecord>::const_iterator i = result.records.begin(); i != result.records.end(); ++i)
+   {
+      if (!i->target().empty() && i->target() != ".")
+      {
+         records.push_back(*i);
+      }
+   }
 
-   if (endpoints.empty())
+   if (records.empty())
    {
-      // DNS error
       request.handler(shared_ptr<Session>(), asio::error::host_not_found);
 
       return;
    }
 
-   for (vector<tcp::endpoint>::const_iterator i = endpoints.begin(); i != endpoints.end(); ++i)
+   // each record once, by priority and then weighted at random within it,
+   // with targets that have been failing or slow to connect pushed back
+   TargetSelector selector(records, bind(&SessionFactory::health, this, _1));
+
+   const size_t fanout = std::min<size_t>(records.size(), SrvFanout);
+
+   shared_ptr<SrvLookup> lookup(new SrvLookup);
+   lookup->request = request;
+   lookup->outstanding = fanout;
+
+   for (size_t i = 0; i < fanout; ++i)
+   {
+      const SrvRecord target = selector.next();
+
+      mDns.multiquery(target.target(),
+            bind(&SessionFactory::onSrvTargetResult, this, lookup, target.port(), _1));
+   }
+}
+
+void
+SessionFactory::onSrvTargetResult(shared_ptr<SrvLookup> lookup, unsigned short port,
+      const vector<ip::address>& addrs)
+{
+   const vector<tcp::endpoint> endpoints = makeEndpoints(addrs, port);
+
+   // !cb! the handler is called after the lock is released, since it may
+   // well start another lookup or block on something of its own
+   shared_ptr<Connection> created;
+   bool failed = false;
+   asio::error error;
+
+   {
+      ScopedLock lock(lookup->mutex);
+
+      --lookup->outstanding;
+
+      if (!endpoints.empty())
+      {
+         if (lookup->connection)
+         {
+            lookup->connection->pushTargets(endpoints);
+         }
+         else
+         {
+            try
+            {
+               lookup->connection = connect(endpoints);
+
+               created = lookup->connection;
+            }
+            catch (const Connection::Exception& e)
+            {
+               MsrpErrLog(<< "onSrvTargetResult: Connection::Exception caught: " << e);
+
+               if (lookup->outstanding == 0)
+               {
+                  failed = true;
+                  error = asio::error::connection_aborted;
+               }
+            }
+         }
+      }
+      else if (lookup->outstanding == 0 && !lookup->connection)
+      {
+         // DNS error on every target
+         failed = true;
+         error = asio::error::host_not_found;
+      }
+   }
+
+   if (created)
+   {
+      lookup->request.handler(Session::factory(created, lookup->request.self), asio::error());
+   }
+   else if (failed)
+   {
+      lookup->request.handler(shared_ptr<Session>(), error);
+   }
+}
+
+double
+SessionFactory::health(const SrvRecord& record)
+{
+   vector<ip::address> addrs;
+
+   DnsMessage m;
+   if (mDns.cache().find(record.target(), DnsMessage::A, m))
+   {
+      addrs = m.addresses();
+   }
+#ifdef USE_IPV6
+   if (mDns.cache().find(record.target(), DnsMessage::AAAA, m))
+   {
+      addrs.insert(addrs.end(), m.addresses().begin(), m.addresses().end());
+   }
+#endif
+
+   if (addrs.empty())
+   {
+      // not resolved yet, so nothing is known about it
+      return 1.0;
+   }
+
+   double best = 0;
+
+   for (vector<ip::address>::const_iterator i = addrs.begin(); i != addrs.end(); ++i)
+   {
+      best = std::max(best, TargetHealth::instance().health(tcp::endpoint(*i, record.port())));
+   }
+
+   return best;
+}
+
+shared_ptr<Connection>
+SessionFactory::connect(const vector<tcp::endpoint>& targets)
+{
+   vector<tcp::endpoint> endpoints(targets);
+   TargetHealth::instance().order(endpoints);
+
+   shared_ptr<Connection> c;
+
+   for (vector<tcp::endpoint>::const_iterator i = endpoints.begin(); !c && i != endpoints.end(); ++i)
+   {
+      c = mPool->lookup(*i);
+   }
+
+   if (!c)
    {
-      shared_ptr<Connection> c = mPool->find(*i);
-      if (c)
+      // as in answer(), misses serialise on the stripe of the preferred target
+      ScopedLock lock(stripe(endpoints.front()));
+
+      for (vector<tcp::endpoint>::const_iterator i = endpoints.begin(); !c && i != endpoints.end(); ++i)
+      {
+         c = pooled(*i);
+      }
+
+      if (!c)
       {
-         // ?cb? almost certainly not correct behaviour?  One of the endpoints returned
-         // in the DNS query matches an existing connection, so we add the remaining
-         // DNS records as reconnect hints in case this connection is dropped.  Undesirable
-         // behaviour for the original owner of the connection, but desirable for the newly-
-         // created Session.
-         c->pushTargets(endpoints);
+         c = Connection::createAnswer(mService, endpoints, shared_ptr<ssl::context>());
 
-         request.handler(Session::factory(c, request.self), asio::error());
+         mPool->add(c);
 
-         return;
+         return c;
       }
    }
 
-   try
+   // ?cb? almost certainly not correct behaviour?  One of the endpoints returned
+   // in the DNS query matches an existing connection, so we add the remaining
+   // DNS records as reconnect hints in case this connection is dropped.  Undesirable
+   // behaviour for the original owner of the connection, but desirable for the newly-
+   // created Session.
+   c->pushTargets(endpoints);
+
+   return c;
+}
+
+void
+SessionFactory::onDnsResult(const RequestInfo request, const vector<ip::address>& addrs)
+{
+   const vector<tcp::endpoint> endpoints = makeEndpoints(addrs, request.peer.port());
+
+   if (endpoints.empty())
    {
-      shared_ptr<Connection> connection(Connection::createAnswer(mService, endpoints,
-         shared_ptr<ssl::context>()));
+      // DNS error
+      request.handler(shared_ptr<Session>(), asio::error::host_not_found);
 
-      mPool->add(connection);
+      return;
+   }
 
-      request.handler(Session::factory(connection, request.self), asio::error());
+   try
+   {
+      request.handler(Session::factory(connect(endpoints), request.self), asio::error());
    }
    catch (const Connection::Exception& e)
    {
-      ErrLog(<< "onDnsResult: Connection::Exception caught: " << e);
+      MsrpErrLog(<< "onDnsResult: Connection::Exception caught: " << e);
 
       request.handler(shared_ptr<Session>(), asio::error::connection_aborted);
    }
@@ -193,11 +363,12 @@ SessionFactory::onDnsResult(const RequestInfo request, const vector<ip::address>
 void
 SessionFactory::shutdown()
 {
-   ScopedLock lock(mMutex);
-
    mDns.stop();
 
    mPool->close();
+
+   // the trim timer would keep run() going for another interval
+   asio::use_service<BlockPool>(mService).stop();
 }
 
 // Copyright 2007 Chris Bond
@@ -12,8 +12,6 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
 
-#include <rutil/dns/QueryTypes.hxx>
-
 #include "msrp/ConnectionPool.hxx"
 #include "msrp/DnsService.hxx"
 #include "msrp/Mutex.hxx"
@@ -22,6 +20,7 @@
 namespace msrp
 {
 
+class Connection;
 class Session;
 
 class SessionFactory :
@@ -37,6 +36,15 @@ class SessionFactory :
 
       asio::io_service& service();
 
+      // resolver for relay and SRV lookups, e.g. to set its nameservers
+      DnsService& dns();
+
+      // Run the io_service from the calling thread after building that
+      // thread's parsers; use it as the body of every reactor thread.  A
+      // thread that calls io_service::run() itself should call
+      // initializeParsers() first.
+      void run();
+
       boost::shared_ptr<Session> answer(const Uri& peer, const Uri& self, Callback handler);
 
       boost::shared_ptr<Session> offer(const asio::ip::tcp::endpoint& bind, const Uri& self);
@@ -51,13 +59,45 @@ class SessionFactory :
          Callback handler;
       };
 
-      void onSrvResult(const RequestInfo, const resip::DNSResult<resip::DnsSrvRecord>&);
+      // !cb! An SRV lookup in progress.  The A/AAAA lookups for its top
+      // targets run in parallel; the first to resolve creates the connection
+      // and the rest are appended to it as failover targets.
+      struct SrvLookup
+      {
+         SrvLookup() : outstanding(0) {}
+
+         Mutex mutex;
+
+         RequestInfo request;
+         unsigned int outstanding;
+         boost::shared_ptr<Connection> connection;
+      };
+
+      // targets of one SRV result resolved at once
+      enum { SrvFanout = 4 };
+
+      // locks for creating connections, chosen by target
+      enum { Stripes = 16 };
+
+      Mutex& stripe(const asio::ip::tcp::endpoint&);
+
+      boost::shared_ptr<Connection> pooled(const asio::ip::tcp::endpoint&) const;
+
+      void onSrvResult(const RequestInfo, const DnsResult<SrvRecord>&);
+
+      void onSrvTargetResult(boost::shared_ptr<SrvLookup>, unsigned short port,
+            const std::vector<asio::ip::address>&);
+
+      boost::shared_ptr<Connection> connect(const std::vector<asio::ip::tcp::endpoint>&);
+
+      // best TargetHealth among the cached addresses of a target
+      double health(const SrvRecord&);
 
       void onDnsResult(const RequestInfo, const std::vector<asio::ip::address>&);
 
       boost::shared_ptr<Session> answer(const asio::ip::tcp::endpoint& peer, const Uri& self);
       
-      mutable Mutex mMutex;
+      Mutex mStripes[Stripes];
 
       asio::io_service& mService;
 
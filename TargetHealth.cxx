@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <utility>
+
+#include "msrp/System.hxx"
+#include "msrp/TargetHealth.hxx"
+
+using namespace msrp;
+using namespace std;
+using namespace boost;
+using namespace asio::ip;
+
+namespace
+{
+
+struct HealthierFirst
+{
+   bool operator()(const pair<double, tcp::endpoint>& lhs,
+                   const pair<double, tcp::endpoint>& rhs) const
+   {
+      return lhs.first > rhs.first;
+   }
+};
+
+}
+
+TargetHealth&
+TargetHealth::instance()
+{
+   // !cb! never destroyed; connections may report during static destruction
+   static TargetHealth* health = new TargetHealth;
+
+   return *health;
+}
+
+void
+TargetHealth::connected(const tcp::endpoint& endpoint, long milliseconds)
+{
+   mutex::scoped_lock lock(mMutex);
+
+   Entry& e = mEntries[endpoint];
+
+   // exponentially weighted, 1/4 to the new sample
+   e.latency = e.latency ? (3 * e.latency + milliseconds) / 4 : milliseconds;
+   e.failures = 0;
+}
+
+void
+TargetHealth::failed(const tcp::endpoint& endpoint)
+{
+   mutex::scoped_lock lock(mMutex);
+
+   Entry& e = mEntries[endpoint];
+
+   ++e.failures;
+   e.failed = time(0);
+}
+
+void
+TargetHealth::attach(const tcp::endpoint& endpoint)
+{
+   mutex::scoped_lock lock(mMutex);
+
+   ++mEntries[endpoint].load;
+}
+
+void
+TargetHealth::detach(const tcp::endpoint& endpoint)
+{
+   mutex::scoped_lock lock(mMutex);
+
+   Map::iterator i = mEntries.find(endpoint);
+   if (i != mEntries.end() && i->second.load > 0)
+   {
+      --i->second.load;
+   }
+}
+
+double
+TargetHealth::health(const tcp::endpoint& endpoint) const
+{
+   mutex::scoped_lock lock(mMutex);
+
+   return health(endpoint, time(0));
+}
+
+double
+TargetHealth::health(const tcp::endpoint& endpoint, time_t now) const
+{
+   Map::const_iterator i = mEntries.find(endpoint);
+   if (i == mEntries.end())
+   {
+      return 1.0;
+   }
+
+   const Entry& e = i->second;
+
+   double h = 1.0;
+
+   if (e.failures && now - e.failed < Holddown)
+   {
+      if (e.failures >= Down)
+      {
+         return 0.0;
+      }
+
+      h /= 1 + e.failures;
+   }
+
+   if (e.latency > Reference)
+   {
+      h *= static_cast<double>(Reference) / e.latency;
+   }
+
+   h *= static_cast<double>(Load) / (Load + e.load);
+
+   return h;
+}
+
+void
+TargetHealth::order(vector<tcp::endpoint>& endpoints) const
+{
+   vector<pair<double, tcp::endpoint> > ranked;
+   ranked.reserve(endpoints.size());
+
+   {
+      mutex::scoped_lock lock(mMutex);
+
+      const time_t now = time(0);
+
+      for (vector<tcp::endpoint>::const_iterator i = endpoints.begin(); i != endpoints.end(); ++i)
+      {
+         ranked.push_back(make_pair(health(*i, now), *i));
+      }
+   }
+
+   stable_sort(ranked.begin(), ranked.end(), HealthierFirst());
+
+   for (size_t i = 0; i < ranked.size(); ++i)
+   {
+      endpoints[i] = ranked[i].second;
+   }
+}
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
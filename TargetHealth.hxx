@@ -0,0 +1,95 @@
+#ifndef MSRP_TARGETHEALTH_HXX
+#define MSRP_TARGETHEALTH_HXX
+
+#include <ctime>
+#include <map>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <asio/ip/tcp.hpp>
+
+namespace msrp
+{
+
+// !cb! What connections have learnt about each remote endpoint: smoothed
+// connect latency, consecutive connect failures and the number of
+// connections currently open.  TargetSelector and SessionFactory use it to
+// prefer endpoints that are doing well.  A failure only counts for
+// Holddown seconds, after which the endpoint gets another chance.
+
+class TargetHealth : private boost::noncopyable
+{
+   public:
+      enum
+      {
+         Holddown = 30,    // seconds a failure counts against an endpoint
+         Down = 3,         // consecutive failures that take an endpoint out
+         Reference = 50,   // connect latency (ms) still counted as healthy
+         Load = 32         // open connections that halve an endpoint's health
+      };
+
+      static TargetHealth& instance();
+
+      void connected(const asio::ip::tcp::endpoint&, long milliseconds);
+      void failed(const asio::ip::tcp::endpoint&);
+
+      // open connections
+      void attach(const asio::ip::tcp::endpoint&);
+      void detach(const asio::ip::tcp::endpoint&);
+
+      // 1 for a healthy or unknown endpoint, towards 0 for one that is slow,
+      // loaded or failing, and 0 while one that keeps failing is held down
+      double health(const asio::ip::tcp::endpoint&) const;
+
+      // stable sort, healthiest first
+      void order(std::vector<asio::ip::tcp::endpoint>&) const;
+
+   private:
+      struct Entry
+      {
+         Entry() : latency(0), failures(0), failed(0), load(0) {}
+
+         long latency;
+         unsigned int failures;
+         std::time_t failed;
+         unsigned int load;
+      };
+
+      typedef std::map<asio::ip::tcp::endpoint, Entry> Map;
+
+      double health(const asio::ip::tcp::endpoint&, std::time_t now) const;
+
+      mutable boost::mutex mMutex;
+
+      Map mEntries;
+};
+
+}
+
+#endif
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
@@ -1,44 +1,208 @@
+#include <cassert>
+#include <algorithm>
+
+#include <rutil/Random.hxx>
+
 #include "msrp/System.hxx"
 #include "msrp/TargetSelector.hxx"
 
 using namespace msrp;
 using namespace std;
+using namespace resip;
 
-ostream&
-msrp::operator<<(ostream& os, const TargetSelector& ts)
+namespace
 {
-   TargetSelector::RecordMap::const_iterator i = ts.mRecords.begin();
-   while (i != ts.mRecords.end())
+
+struct PriorityCompare
+{
+   bool operator()(const SrvRecord& lhs, const SrvRecord& rhs) const
    {
-      os << '('
-         << i->first
-         << ") = [";
+      return lhs.priority() < rhs.priority();
+   }
+};
 
-      TargetSelector::WeightMap map;
-      ts.sum(i->first, map);
+}
 
-      TargetSelector::WeightMap::const_iterator wi = map.begin();
+TargetSelector::TargetSelector(const vector<SrvRecord>& records, const Health& health) :
+   mLevel(0)
+{
+   vector<SrvRecord> sorted(records);
+   stable_sort(sorted.begin(), sorted.end(), PriorityCompare());
 
-      while (wi != map.end())
+   for (vector<SrvRecord>::const_iterator i = sorted.begin(); i != sorted.end(); ++i)
+   {
+      if (mLevels.empty() || mLevels.back().records.back().priority() != i->priority())
       {
-         os << wi->first
-            << ' '
-            << wi->second.target()
-            << ' '
-            << wi->second.port();
+         mLevels.push_back(Level());
+      }
+
+      Level& level = mLevels.back();
+
+      const double h = health ? health(*i) : 1.0;
+
+      // !cb! a weight of zero still gets a small chance, as RFC 2782 asks;
+      // a target with no health gets none until it is the only one left
+      unsigned long weight = 0;
+
+      if (h > 0)
+      {
+         weight = static_cast<unsigned long>(i->weight() * Scale * min(h, 1.0)) + 1;
+      }
+
+      level.records.push_back(*i);
+      level.weights.push_back(weight);
+   }
+
+   reset();
+}
+
+const SrvRecord
+TargetSelector::next()
+{
+   if (mLevels.empty())
+   {
+      throw Exception("DNS SRV records exhausted", codeContext());
+   }
+
+   if (mLevel == mLevels.size())
+   {
+      reset();
+   }
+
+   Level& level = mLevels[mLevel];
+
+   const size_t i = level.take(level.total ? Random::getRandom() % level.total : 0);
+
+   if (level.remaining == 0)
+   {
+      ++mLevel;
+   }
+
+   return level.records[i];
+}
+
+void
+TargetSelector::reset()
+{
+   for (vector<Level>::iterator i = mLevels.begin(); i != mLevels.end(); ++i)
+   {
+      i->build();
+   }
+
+   mLevel = 0;
+}
+
+void
+TargetSelector::Level::build()
+{
+   const size_t n = records.size();
+
+   tree.assign(n + 1, 0);
+   taken.assign(n, false);
+   remaining = n;
+   total = 0;
+
+   for (size_t i = 0; i < n; ++i)
+   {
+      // O(n) construction: each node passes its sum to its parent
+      tree[i + 1] += weights[i];
+      total += weights[i];
 
-         if (++wi != map.end())
+      const size_t parent = (i + 1) + ((i + 1) & -(i + 1));
+      if (parent <= n)
+      {
+         tree[parent] += tree[i + 1];
+      }
+   }
+}
+
+void
+TargetSelector::Level::add(size_t i, long delta)
+{
+   for (++i; i < tree.size(); i += i & -i)
+   {
+      tree[i] += delta;
+   }
+}
+
+size_t
+TargetSelector::Level::take(unsigned long point)
+{
+   assert(remaining);
+
+   size_t i = 0;
+
+   if (total)
+   {
+      // !cb! descend to the record whose cumulative range contains point
+      size_t step = 1;
+      while (step * 2 < tree.size())
+      {
+         step *= 2;
+      }
+
+      for (; step; step /= 2)
+      {
+         if (i + step < tree.size() && tree[i + step] <= point)
          {
-            os << ", ";
+            i += step;
+            point -= tree[i];
          }
       }
+   }
+   else
+   {
+      // only records without health are left
+      while (taken[i])
+      {
+         ++i;
+      }
+   }
 
-      os << ']';
+   assert(i < taken.size() && !taken[i]);
 
-      if (++i != ts.mRecords.end())
+   taken[i] = true;
+   --remaining;
+
+   if (weights[i])
+   {
+      add(i, -static_cast<long>(weights[i]));
+      total -= weights[i];
+   }
+
+   return i;
+}
+
+ostream&
+msrp::operator<<(ostream& os, const TargetSelector& ts)
+{
+   for (vector<TargetSelector::Level>::const_iterator i = ts.mLevels.begin();
+         i != ts.mLevels.end(); ++i)
+   {
+      if (i != ts.mLevels.begin())
       {
          os << ' ';
       }
+
+      os << '('
+         << i->records.front().priority()
+         << ") = [";
+
+      for (size_t r = 0; r < i->records.size(); ++r)
+      {
+         if (r)
+         {
+            os << ", ";
+         }
+
+         os << i->weights[r]
+            << ' '
+            << i->records[r].target()
+            << ' '
+            << i->records[r].port();
+      }
+
+      os << ']';
    }
 
    return os;
@@ -1,21 +1,28 @@
 #ifndef MSRP_TARGETSELECTOR_HXX
 #define MSRP_TARGETSELECTOR_HXX
 
-#include <list>
-#include <map>
+#include <cstddef>
+#include <ostream>
 #include <string>
+#include <vector>
 
-#include <rutil/Random.hxx>
-
-#include <rutil/dns/DnsStub.hxx>
-#include <rutil/dns/DnsSrvRecord.hxx>
+#include <boost/function.hpp>
 
+#include "msrp/DnsMessage.hxx"
 #include "msrp/Exception.hxx"
 
 namespace msrp
 {
 
-// !cb! RFC 2782 - select a service record target from a DNS result
+// !cb! RFC 2782 - select a service record target from a DNS result.  The
+// records are grouped by priority once, on construction; each level keeps
+// its effective weights in a Fenwick tree so that a weighted pick and the
+// removal of the picked record are both O(log n).  The optional health
+// function scales each weight by a factor in [0, 1] (see TargetHealth);
+// a record with zero health is only chosen once every other record of its
+// priority has been.  When every record has been returned the selector
+// starts another round.
+
 class TargetSelector
 {
    public:
@@ -26,129 +33,41 @@ class TargetSelector
          {}
       };
 
-      TargetSelector(std::vector<resip::DnsSrvRecord> records)
-      {
-         std::sort(records.begin(), records.end(), WeightCompare());
-
-         for (std::vector<resip::DnsSrvRecord>::const_iterator i = records.begin();
-               i != records.end(); ++i)
-         {
-            mRecords[i->priority()].push_back(*i);
-         }
-      }
-
-      const resip::DnsSrvRecord next()
-      {
-         if (mRecords.empty())
-         {
-            if (mRemoved.empty())
-            {
-               throw Exception("DNS SRV records exhausted", codeContext());
-            }
-            else
-            {
-               mRecords.swap(mRemoved);
-            }
-         }
-
-         WeightMap map;
-         sum(mRecords.begin()->first, map);
-
-         WeightMap::const_iterator i =
-            map.lower_bound(resip::Random::getRandom() % (highest(map) + 1));
+      typedef boost::function1<double, const SrvRecord&> Health;
 
-		 assert(i != map.end());
+      // resolution of the effective weights
+      enum { Scale = 16 };
 
-         const resip::DnsSrvRecord record = i->second;
+      TargetSelector(const std::vector<SrvRecord>&, const Health& = Health());
 
-         recycle(mRecords.begin()->first, record);
-
-         return record;
-      }
+      const SrvRecord next();
 
    private:
       friend std::ostream& operator<<(std::ostream&, const TargetSelector&);
 
-      typedef std::map<int, std::list<resip::DnsSrvRecord> > RecordMap;
-
-      RecordMap mRecords;
-      RecordMap mRemoved;
-
-      struct WeightCompare :
-         public std::binary_function<const resip::DnsSrvRecord, const resip::DnsSrvRecord, bool>
+      struct Level
       {
-         bool operator()(const resip::DnsSrvRecord& lhs,
-                         const resip::DnsSrvRecord& rhs) const
-         {
-            return lhs.weight() < rhs.weight();
-         }
-      };
+         Level() : remaining(0), total(0) {}
 
-      struct CompareRecord :
-         public std::unary_function<const resip::DnsSrvRecord, bool>
-      {
-         CompareRecord(const resip::DnsSrvRecord& r) :
-            lhs(r)
-         {}
+         void build();
+         std::size_t take(unsigned long);
+         void add(std::size_t, long);
 
-         bool operator()(const resip::DnsSrvRecord& rhs) const
-         {
-            return lhs.priority() == rhs.priority()
-               && lhs.weight() == rhs.weight()
-               && lhs.port() == rhs.port()
-               && lhs.target() == rhs.target()
-               && lhs.name() == rhs.name();
-         }
+         std::vector<SrvRecord> records;
+         std::vector<unsigned long> weights;
 
-         const resip::DnsSrvRecord& lhs;
-      };
+         // 1-based cumulative sums of the weights not yet taken
+         std::vector<unsigned long> tree;
+         std::vector<bool> taken;
 
-      typedef std::map<int, const resip::DnsSrvRecord> WeightMap;
-
-      void sum(int priority, WeightMap& map) const
-      {
-         RecordMap::const_iterator ri = mRecords.find(priority);
-         assert(ri != mRecords.end());
-
-         const std::list<resip::DnsSrvRecord>& records = ri->second;
-
-         std::list<resip::DnsSrvRecord>::const_iterator i = records.begin();
-
-         for (int running = 0; i != records.end(); ++i)
-         {
-            running += i->weight();
-
-            map.insert(WeightMap::value_type(running, *i));
-         }
-      }
-
-      int highest(const WeightMap& map) const
-      {
-         WeightMap::const_iterator i = map.end();
-         --i;
-
-         return i->first;
-      }
-
-      void recycle(int p, const resip::DnsSrvRecord& r)
-      {
-         std::list<resip::DnsSrvRecord>& recordList = mRecords[p];
-
-         std::list<resip::DnsSrvRecord>::iterator i =
-            std::find_if(recordList.begin(), recordList.end(), CompareRecord(r));
-
-         if (i != recordList.end())
-         {
-            recordList.erase(i);
+         std::size_t remaining;
+         unsigned long total;
+      };
 
-            if (recordList.empty())
-            {
-               mRecords.erase(p);
-            }
-         }
+      void reset();
 
-         mRemoved[p].push_back(r);
-      }
+      std::vector<Level> mLevels;
+      std::size_t mLevel;
 };
 
 std::ostream&
@@ -0,0 +1,217 @@
+#include <ctime>
+
+#include "msrp/System.hxx"
+#include "msrp/Trace.hxx"
+
+using namespace msrp;
+using namespace std;
+
+void
+Trace::enable(bool on)
+{
+   flag() = on;
+}
+
+Trace::Tick
+Trace::now()
+{
+   timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return static_cast<Tick>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+Trace&
+Trace::global()
+{
+   // !cb! never destroyed; connections may record during static destruction
+   static Trace* trace = new Trace;
+
+   return *trace;
+}
+
+const char*
+Trace::name(unsigned int histogram)
+{
+   static const char* names[Histograms] =
+   {
+      "read", "framed", "parsed", "demuxed", "delivered",
+      "queued", "scheduled", "first-byte", "last-byte", "reported",
+      "inbound", "outbound"
+   };
+
+   return histogram < Histograms ? names[histogram] : "unknown";
+}
+
+Trace::Trace()
+{}
+
+Trace::~Trace()
+{
+   for (unsigned int i = 0; i < Histograms; ++i)
+   {
+      delete mHistograms[i].load();
+   }
+}
+
+void
+Trace::record(unsigned int i, Tick t)
+{
+   Histogram* h = mHistograms[i].load();
+
+   if (!h)
+   {
+      Histogram* fresh = new Histogram;
+
+      if (mHistograms[i].compareExchange(0, fresh))
+      {
+         h = fresh;
+      }
+      else
+      {
+         // another thread got there first
+         delete fresh;
+
+         h = mHistograms[i].load();
+      }
+   }
+
+   h->record(t);
+}
+
+const Histogram*
+Trace::histogram(unsigned int i) const
+{
+   return mHistograms[i].load();
+}
+
+// Trace::Timeline
+
+Trace::Timeline::Timeline(Trace* trace) :
+   mTrace(trace),
+   mReport(true)
+{
+   clear();
+}
+
+void
+Trace::Timeline::attach(Trace* trace)
+{
+   mTrace = trace;
+}
+
+void
+Trace::Timeline::expectReport(bool report)
+{
+   mReport = report;
+}
+
+void
+Trace::Timeline::clear()
+{
+   mReport = true;
+
+   for (unsigned int i = 0; i < Stages; ++i)
+   {
+      mStamps[i] = 0;
+   }
+}
+
+void
+Trace::Timeline::stamp(Stage s)
+{
+   if (mStamps[s])
+   {
+      return;
+   }
+
+   const Tick t = now();
+
+   mStamps[s] = t;
+
+   const Stage first = s < Queued ? Read : Queued;
+   const Stage last = s < Queued ? Delivered : mReport ? Reported : LastByte;
+
+   // time since the latest stage stamped before this one
+   for (int i = s - 1; i >= first; --i)
+   {
+      if (mStamps[i])
+      {
+         if (mTrace)
+         {
+            mTrace->record(s, t - mStamps[i]);
+         }
+
+         global().record(s, t - mStamps[i]);
+
+         break;
+      }
+   }
+
+   if (s == last)
+   {
+      const unsigned int total = s == Delivered ? Inbound : Outbound;
+
+      if (s != first && mStamps[first])
+      {
+         if (mTrace)
+         {
+            mTrace->record(total, t - mStamps[first]);
+         }
+
+         global().record(total, t - mStamps[first]);
+      }
+
+      // ready for the next chunk or message in this direction
+      for (unsigned int i = first; i <= last; ++i)
+      {
+         mStamps[i] = 0;
+      }
+   }
+}
+
+ostream&
+msrp::operator<<(ostream& os, const Trace& trace)
+{
+   for (unsigned int i = 0; i < Trace::Histograms; ++i)
+   {
+      const Histogram* h = trace.histogram(i);
+
+      if (h && h->count())
+      {
+         os << Trace::name(i)
+            << " count " << h->count()
+            << " p50 " << h->percentile(0.5) / 1000.0
+            << " p99 " << h->percentile(0.99) / 1000.0
+            << " p999 " << h->percentile(0.999) / 1000.0
+            << " max " << h->max() / 1000.0
+            << std::endl;
+      }
+   }
+
+   return os;
+}
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
@@ -0,0 +1,153 @@
+#ifndef MSRP_TRACE_HXX
+#define MSRP_TRACE_HXX
+
+#include <ostream>
+
+#include <boost/noncopyable.hpp>
+
+#include "msrp/Atomic.hxx"
+#include "msrp/Histogram.hxx"
+
+namespace msrp
+{
+
+// !cb! Optional per-message lifecycle tracing.  A Timeline stamps each
+// stage a chunk or message passes through, and the time since the previous
+// stamped stage goes into that stage's histogram, both in the Trace it is
+// attached to (one per connection) and in the global one; reaching the
+// last stage of a direction also records the time from its first stage.
+// An outgoing message that asks for no success report ends at LastByte,
+// since no REPORT will follow.  A stage keeps its earliest stamp, so
+// marking it again is harmless.
+//
+// Tracing is off until enable() is called.  A mark is then a single
+// branch, and a connection's histograms are only allocated once something
+// is recorded in them.
+
+class Trace : private boost::noncopyable
+{
+   public:
+      enum Stage
+      {
+         // inbound, per chunk
+         Read,          // first bytes received
+         Framed,        // header block complete
+         Parsed,
+         Demuxed,       // routed to its session or message
+         Delivered,     // application handlers returned
+
+         // outbound, per message
+         Queued,        // Session::stream()
+         Scheduled,     // first chunk started
+         FirstByte,     // first contents queued on the connection
+         LastByte,
+         Reported,      // REPORT received
+
+         Stages
+      };
+
+      // histograms beyond the stages: the whole of each direction
+      enum
+      {
+         Inbound = Stages,
+         Outbound,
+         Histograms
+      };
+
+      // nanoseconds from a monotonic clock
+      typedef Histogram::Value Tick;
+
+      static bool enabled()
+      {
+         return flag();
+      }
+
+      // !cb! not synchronised; set it before starting any connections
+      static void enable(bool);
+
+      static Tick now();
+
+      static Trace& global();
+
+      static const char* name(unsigned int histogram);
+
+      Trace();
+      ~Trace();
+
+      void record(unsigned int histogram, Tick);
+
+      // 0 if nothing has been recorded
+      const Histogram* histogram(unsigned int) const;
+
+      class Timeline
+      {
+         public:
+            explicit Timeline(Trace* = 0);
+
+            void attach(Trace*);
+
+            // whether a REPORT closes the outbound timeline; on by default
+            void expectReport(bool);
+
+            void mark(Stage s)
+            {
+               if (enabled())
+               {
+                  stamp(s);
+               }
+            }
+
+            void clear();
+
+         private:
+            void stamp(Stage);
+
+            Trace* mTrace;
+
+            bool mReport;
+
+            Tick mStamps[Stages];
+      };
+
+   private:
+      static bool& flag()
+      {
+         static bool enabled = false;
+
+         return enabled;
+      }
+
+      Atomic<Histogram*> mHistograms[Histograms];
+};
+
+// one line per histogram with anything in it; times in microseconds
+std::ostream&
+operator<<(std::ostream&, const Trace&);
+
+}
+
+#endif
+
+// Copyright 2007 Chris Bond
+// 
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// 
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
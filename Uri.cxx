@@ -1,11 +1,13 @@
 #include <cctype>
 #include <memory>
-#include <sstream>
 #include <iostream>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/weak_ptr.hpp>
 
 #include "msrp/System.hxx"
+#include "msrp/HashTable.hxx"
 #include "msrp/Parse.hxx"
 #include "msrp/ParseException.hxx"
 #include "msrp/ParseUri.hxx"
@@ -14,30 +16,233 @@
 
 using namespace msrp;
 using namespace std;
+using namespace boost;
+
+// !cb! The table only points at interned Reps; they are owned by their
+// Uris, and the deleter takes a Rep out of the table when the last one
+// goes.  The table itself is never destroyed, since Uris with static
+// storage duration may outlive it otherwise.
+struct Uri::Table
+{
+   struct Entry
+   {
+      Entry() : rep(0) {}
+
+      Rep* rep;
+      weak_ptr<Rep> ref;
+   };
+
+   struct Release
+   {
+      void operator()(Rep* rep) const
+      {
+         Table& table = instance();
+
+         {
+            mutex::scoped_lock lock(table.guard);
+
+            const string id = identity(*rep);
+
+            Entry* e = table.reps.find(id);
+            if (e && e->rep == rep)
+            {
+               table.reps.erase(id);
+            }
+         }
+
+         delete rep;
+      }
+   };
+
+   static Table& instance()
+   {
+      static Table* table = new Table;
+      return *table;
+   }
+
+   mutex guard;
+   HashTable<string, Entry> reps;
+};
 
 Uri::Uri() :
-   mPort(0), mDelimiter(false)
+   mRep(none())
 {}
 
 Uri::Uri(const string& str) :
-   mPort(0), mDelimiter(false)
+   mRep(none())
 {
    parse(str);
+
+   intern();
 }
 
 Uri::Uri(const asio::ip::tcp::endpoint& endpoint, bool tls) :
-   mHost(endpoint.address().to_string()),
-   mPort(endpoint.port()),
-   mDelimiter(false)
+   mRep(new Rep)
 {
+   mRep->host = endpoint.address().to_string();
+   mRep->port = endpoint.port();
+
    if (tls)
    {
-      mScheme = "msrps";
+      mRep->scheme = "msrps";
    }
    else
    {
-      mScheme = "msrp";
+      mRep->scheme = "msrp";
    }
+
+   mRep->makeKey();
+
+   intern();
+}
+
+Uri::Uri(const Uri& rhs) :
+   mRep(rhs.mRep)
+{}
+
+Uri&
+Uri::operator=(const Uri& rhs)
+{
+   mRep = rhs.mRep;
+
+   return *this;
+}
+
+void
+Uri::scheme(const string& s)
+{
+   mutate().scheme = s;
+   mRep->makeKey();
+}
+
+void
+Uri::user(const string& s)
+{
+   mutate().user = s;
+}
+
+void
+Uri::host(const string& s)
+{
+   mutate().host = s;
+   mRep->makeKey();
+}
+
+void
+Uri::port(unsigned short p)
+{
+   mutate().port = p;
+   mRep->makeKey();
+}
+
+void
+Uri::session(const string& s)
+{
+   mutate().session = s;
+   mRep->makeKey();
+}
+
+void
+Uri::transport(const string& s)
+{
+   mutate().transport = s;
+}
+
+void
+Uri::delimiter(bool d)
+{
+   mutate().delimiter = d;
+}
+
+const shared_ptr<Uri::Rep>&
+Uri::none()
+{
+   // shared by default-constructed Uris; marked interned so that it is
+   // never modified in place
+   struct Empty
+   {
+      static Rep* create()
+      {
+         Rep* rep = new Rep;
+         rep->interned = true;
+
+         return rep;
+      }
+   };
+
+   static const shared_ptr<Rep> empty(Empty::create());
+
+   return empty;
+}
+
+Uri::Rep&
+Uri::mutate()
+{
+   if (mRep->interned || !mRep.unique())
+   {
+      shared_ptr<Rep> copy(new Rep(*mRep));
+      copy->interned = false;
+
+      mRep = copy;
+   }
+
+   return *mRep;
+}
+
+const string
+Uri::identity(const Rep& rep)
+{
+   string id;
+   id.reserve(rep.scheme.size() + rep.user.size() + rep.host.size()
+      + rep.session.size() + rep.transport.size() + 12);
+
+   id += rep.scheme;
+   id += '\0';
+   id += rep.user;
+   id += '\0';
+   id += rep.host;
+   id += '\0';
+   id.append(reinterpret_cast<const char*>(&rep.port), sizeof(rep.port));
+   id += rep.session;
+   id += '\0';
+   id += rep.transport;
+   id += rep.delimiter ? '/' : '\0';
+
+   return id;
+}
+
+void
+Uri::intern()
+{
+   if (mRep->interned)
+   {
+      return;
+   }
+
+   const string id = identity(*mRep);
+
+   Table& table = Table::instance();
+
+   mutex::scoped_lock lock(table.guard);
+
+   Table::Entry& e = table.reps[id];
+
+   shared_ptr<Rep> rep = e.ref.lock();
+
+   if (!rep)
+   {
+      Rep* r = new Rep(*mRep);
+      r->interned = true;
+
+      rep.reset(r, Table::Release());
+
+      e.rep = r;
+      e.ref = rep;
+   }
+
+   // !cb! the old Rep is private, so dropping it here cannot re-enter the
+   // table
+   mRep = rep;
 }
 
 void
@@ -46,27 +251,80 @@ Uri::parse(const string& s)
    Parse(*this, asio::const_buffer(s.c_str(), s.size()), ParserFactory<parser::Uri>::get());
 }
 
+void
+Uri::Rep::makeKey()
+{
+   key.clear();
+   key.reserve(scheme.size() + host.size() + session.size() + 8);
+
+   for (string::const_iterator i = scheme.begin(); i != scheme.end(); ++i)
+   {
+      key += static_cast<char>(tolower(static_cast<unsigned char>(*i)));
+   }
+
+   key += ':';
+
+   for (string::const_iterator i = host.begin(); i != host.end(); ++i)
+   {
+      key += static_cast<char>(tolower(static_cast<unsigned char>(*i)));
+   }
+
+   key += ':';
+
+   char digits[8];
+   char* d = digits + sizeof(digits);
+   unsigned int p = port;
+
+   do
+   {
+      *--d = static_cast<char>('0' + p % 10);
+      p /= 10;
+   }
+   while (p);
+
+   key.append(d, digits + sizeof(digits));
+
+   key += '/';
+   key += session;
+
+   hash = hashBytes(key.data(), key.size());
+}
+
 bool
 Uri::operator<(const Uri& rhs) const
 {
-   stringstream ls;
-   stringstream rs;
+   const int c = key().compare(rhs.key());
 
-   ls << this[0];
-   rs << rhs;
+   if (c != 0)
+   {
+      return c < 0;
+   }
 
-   return ls.str() < rs.str();
+   if (user() != rhs.user())
+   {
+      return user() < rhs.user();
+   }
+
+   return boost::algorithm::ilexicographical_compare(transport(), rhs.transport());
 }
 
 bool
 Uri::operator==(const Uri& rhs) const
 {
-   return mUser == rhs.mUser
-      && mSessionId == rhs.mSessionId
-      && mPort == rhs.mPort
-      && boost::algorithm::iequals(mScheme, rhs.mScheme)
-      && boost::algorithm::iequals(mHost, rhs.mHost)
-      && boost::algorithm::iequals(mTransport, rhs.mTransport);
+   if (mRep == rhs.mRep)
+   {
+      return true;
+   }
+
+   const Rep& l = *mRep;
+   const Rep& r = *rhs.mRep;
+
+   return l.user == r.user
+      && l.session == r.session
+      && l.port == r.port
+      && boost::algorithm::iequals(l.scheme, r.scheme)
+      && boost::algorithm::iequals(l.host, r.host)
+      && boost::algorithm::iequals(l.transport, r.transport);
 }
 
 bool
@@ -84,12 +342,14 @@ Uri::tls() const
 bool
 Uri::empty() const
 {
-   return mScheme.empty()
-      && mUser.empty()
-      && mHost.empty()
-      && mSessionId.empty()
-      && mTransport.empty()
-      && mPort == 0;
+   const Rep& r = *mRep;
+
+   return r.scheme.empty()
+      && r.user.empty()
+      && r.host.empty()
+      && r.session.empty()
+      && r.transport.empty()
+      && r.port == 0;
 }
 
 const asio::ip::tcp::endpoint
@@ -112,6 +372,35 @@ Uri::path() const
    return p;
 }
 
+const Path::Sequence&
+Path::uris() const
+{
+   static const Sequence Empty;
+
+   return mUris ? *mUris : Empty;
+}
+
+void
+Path::push_back(const Uri& uri)
+{
+   if (!mUris)
+   {
+      mUris.reset(new Sequence);
+   }
+   else if (!mUris.unique())
+   {
+      mUris.reset(new Sequence(*mUris));
+   }
+
+   mUris->push_back(uri);
+}
+
+void
+Path::clear()
+{
+   mUris.reset();
+}
+
 ostream&
 msrp::operator<<(ostream& os, const Uri& uri)
 {
@@ -131,7 +420,7 @@ msrp::operator<<(ostream& os, const Uri& uri)
 
    os << ':';
 
-   if (uri.mDelimiter)
+   if (uri.delimiter())
    {
       os << "//";
    }
@@ -1,17 +1,29 @@
 #ifndef MSRP_URI_HXX
 #define MSRP_URI_HXX
 
+#include <cstddef>
 #include <ostream>
 #include <string>
 #include <vector>
 
+#include <boost/shared_ptr.hpp>
+
 #include <asio/ip/tcp.hpp>
 
 namespace msrp
 {
 
-class Uri;
-typedef std::vector<Uri> Path;
+class Path;
+
+// !cb! A Uri is a handle to a shared representation, so copies cost one
+// refcount.  URIs built from strings or endpoints are interned: every Uri
+// with the same text shares one representation process-wide, equality
+// between them starts with a pointer compare, and their routing key is
+// computed once.  The setters copy the representation first if it is
+// shared (copy-on-write) and bring its routing key up to date, so a
+// representation is complete whenever it can be read and const access
+// never writes to it.  Call intern() after building a Uri by hand to share
+// it again.
 
 class Uri
 {
@@ -20,28 +32,31 @@ class Uri
       Uri(const asio::ip::tcp::endpoint&, bool tls);
       Uri(const std::string&);
 
+      Uri(const Uri&);
+      Uri& operator=(const Uri&);
+
       const Path path() const;
 
-      const std::string& scheme() const { return mScheme; }
-      std::string& scheme() { return mScheme; }
+      const std::string& scheme() const { return mRep->scheme; }
+      void scheme(const std::string&);
 
-      const std::string& user() const { return mUser; }
-      std::string& user() { return mUser; }
+      const std::string& user() const { return mRep->user; }
+      void user(const std::string&);
 
-      const std::string& host() const { return mHost; }
-      std::string& host() { return mHost; }
+      const std::string& host() const { return mRep->host; }
+      void host(const std::string&);
 
-      const unsigned short& port() const { return mPort; }
-      unsigned short& port() { return mPort; }
+      unsigned short port() const { return mRep->port; }
+      void port(unsigned short);
 
-      const std::string& session() const { return mSessionId; }
-      std::string& session() { return mSessionId; }
+      const std::string& session() const { return mRep->session; }
+      void session(const std::string&);
 
-      const std::string& transport() const { return mTransport; }
-      std::string& transport() { return mTransport; }
+      const std::string& transport() const { return mRep->transport; }
+      void transport(const std::string&);
 
-      const bool delimiter() const { return mDelimiter; }
-      bool& delimiter() { return mDelimiter; }
+      bool delimiter() const { return mRep->delimiter; }
+      void delimiter(bool);
 
       bool empty() const;
 
@@ -50,6 +65,17 @@ class Uri
       // throws asio::error if the URI cannot be converted into a tcp::endpoint
       const asio::ip::tcp::endpoint endpoint() const;
 
+      // Canonical routing key: case-folded scheme and host, port and session
+      // ID, which are the parts RFC 4975 compares when matching a To-Path
+      // against a session.  Kept current by the setters.
+      const std::string& key() const { return mRep->key; }
+      std::size_t hash() const { return mRep->hash; }
+
+      // Share the process-wide representation of an identical URI.
+      void intern();
+      bool interned() const { return mRep->interned; }
+
+      // orders by key(), then user and transport, consistent with ==
       bool operator<(const Uri&) const;
 
       bool operator==(const Uri&) const;
@@ -58,19 +84,84 @@ class Uri
    private:
       friend std::ostream& operator<<(std::ostream&, const Uri&);
 
-      std::string mScheme;
-      std::string mUser;
-      std::string mHost;
-      std::string mSessionId;
-      std::string mTransport;
+      struct Rep
+      {
+         Rep() : port(0), delimiter(false), interned(false), hash(0) { makeKey(); }
+
+         std::string scheme;
+         std::string user;
+         std::string host;
+         std::string session;
+         std::string transport;
+
+         unsigned short port;
+
+         bool delimiter;
+         bool interned;
 
-      unsigned short mPort;
+         // routing key, rebuilt whenever scheme, host, port or session
+         // change
+         std::string key;
+         std::size_t hash;
 
-      bool mDelimiter;
+         void makeKey();
+      };
+
+      // process-wide table of interned Reps
+      struct Table;
+
+      boost::shared_ptr<Rep> mRep;
+
+      Rep& mutate();
+
+      static const boost::shared_ptr<Rep>& none();
+      static const std::string identity(const Rep&);
 
       void parse(const std::string&);
 };
 
+// !cb! Copy-on-write sequence of URIs.  Copies share the sequence, and
+// push_back() and clear() copy it first if it is shared, so paths handed
+// between messages, sessions and responses cost a refcount each.
+
+class Path
+{
+   public:
+      typedef std::vector<Uri> Sequence;
+
+      typedef Sequence::value_type value_type;
+      typedef Sequence::size_type size_type;
+      typedef Sequence::const_reference const_reference;
+      typedef Sequence::const_iterator const_iterator;
+      typedef Sequence::const_reverse_iterator const_reverse_iterator;
+
+      Path() {}
+
+      const_iterator begin() const { return uris().begin(); }
+      const_iterator end() const { return uris().end(); }
+
+      const_reverse_iterator rbegin() const { return uris().rbegin(); }
+      const_reverse_iterator rend() const { return uris().rend(); }
+
+      bool empty() const { return !mUris || mUris->empty(); }
+      size_type size() const { return mUris ? mUris->size() : 0; }
+
+      const_reference front() const { return uris().front(); }
+      const_reference back() const { return uris().back(); }
+
+      const_reference operator[](size_type i) const { return uris()[i]; }
+
+      void push_back(const Uri&);
+      void clear();
+
+      void swap(Path& rhs) { mUris.swap(rhs.mUris); }
+
+   private:
+      const Sequence& uris() const;
+
+      boost::shared_ptr<Sequence> mUris;
+};
+
 std::ostream&
 operator<<(std::ostream&, const Uri&);
 
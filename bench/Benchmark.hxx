@@ -0,0 +1,199 @@
+#ifndef MSRP_BENCHMARK_HXX
+#define MSRP_BENCHMARK_HXX
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <string>
+#include <utility>
+
+// !cb! Harness for the micro-benchmarks in this directory.  Each program
+// calls Benchmark::initialize() with its arguments and then run() for each
+// case; a case's body performs one operation per call.  The iteration
+// count is doubled until a sample takes at least MinSample, then the best
+// of Samples samples is reported, which is far more repeatable than the
+// mean on a shared machine.  Output is one tab-separated line per case:
+//
+//    name  iterations  ns/op  allocs/op
+//
+// Lines starting with '#' are comments, so results from two builds can be
+// joined on the name column.  Any arguments select the cases whose names
+// start with one of them.
+//
+// Allocations are counted by replacing the global operator new, so include
+// this header from exactly one translation unit per program.
+
+namespace msrp
+{
+
+class Benchmark
+{
+   public:
+      enum
+      {
+         Samples = 5,
+         MinSample = 50000000,   // ns
+         MaxIterations = 1 << 24
+      };
+
+      static void initialize(int argc, char** argv)
+      {
+         arguments() = std::make_pair(argc - 1, argv + 1);
+
+         std::printf("# %s\n# name\titerations\tns/op\tallocs/op\n", argv[0]);
+      }
+
+      template<typename Body>
+      static void run(const std::string& name, Body& body)
+      {
+         if (!selected(name))
+         {
+            return;
+         }
+
+         std::size_t iterations = 1;
+
+         double elapsed;
+         unsigned long allocs;
+
+         for (;;)
+         {
+            elapsed = sample(body, iterations, allocs);
+
+            if (elapsed >= MinSample || iterations >= MaxIterations)
+            {
+               break;
+            }
+
+            iterations *= 2;
+         }
+
+         for (int i = 1; i < Samples; ++i)
+         {
+            unsigned long a;
+            const double t = sample(body, iterations, a);
+
+            if (t < elapsed)
+            {
+               elapsed = t;
+               allocs = a;
+            }
+         }
+
+         std::printf("%s\t%lu\t%.1f\t%.2f\n", name.c_str(),
+               static_cast<unsigned long>(iterations),
+               elapsed / iterations,
+               static_cast<double>(allocs) / iterations);
+         std::fflush(stdout);
+      }
+
+      // keep a result alive so the optimiser can't drop the work
+      template<typename T>
+      static void consume(const T& value)
+      {
+         sink() = *reinterpret_cast<const volatile char*>(&value);
+      }
+
+      static unsigned long& allocations()
+      {
+         static unsigned long count = 0;
+
+         return count;
+      }
+
+      // bytes requested through operator new, for footprint reports
+      static unsigned long& allocated()
+      {
+         static unsigned long bytes = 0;
+
+         return bytes;
+      }
+
+   private:
+      static volatile char& sink()
+      {
+         static volatile char s;
+
+         return s;
+      }
+
+      static std::pair<int, char**>& arguments()
+      {
+         static std::pair<int, char**> args(0, static_cast<char**>(0));
+
+         return args;
+      }
+
+      static bool selected(const std::string& name)
+      {
+         const std::pair<int, char**>& args = arguments();
+
+         if (args.first == 0)
+         {
+            return true;
+         }
+
+         for (int i = 0; i < args.first; ++i)
+         {
+            if (name.compare(0, std::strlen(args.second[i]), args.second[i]) == 0)
+            {
+               return true;
+            }
+         }
+
+         return false;
+      }
+
+      static double now()
+      {
+         timespec ts;
+         clock_gettime(CLOCK_MONOTONIC, &ts);
+
+         return ts.tv_sec * 1e9 + ts.tv_nsec;
+      }
+
+      template<typename Body>
+      static double sample(Body& body, std::size_t iterations, unsigned long& allocs)
+      {
+         const unsigned long before = allocations();
+         const double begin = now();
+
+         for (std::size_t i = 0; i < iterations; ++i)
+         {
+            body();
+         }
+
+         const double end = now();
+
+         allocs = allocations() - before;
+
+         return end - begin;
+      }
+};
+
+}
+
+void*
+operator new(std::size_t size) throw(std::bad_alloc)
+{
+   ++msrp::Benchmark::allocations();
+   msrp::Benchmark::allocated() += size;
+
+   void* p = std::malloc(size ? size : 1);
+   if (!p)
+   {
+      throw std::bad_alloc();
+   }
+
+   return p;
+}
+
+void
+operator delete(void* p) throw()
+{
+   std::free(p);
+}
+
+#endif
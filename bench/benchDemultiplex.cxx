@@ -0,0 +1,128 @@
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <asio.hpp>
+
+#include <boost/shared_ptr.hpp>
+
+#include <rutil/Logger.hxx>
+
+#include "msrp/Connection.hxx"
+#include "msrp/Demultiplex.hxx"
+#include "msrp/IncomingMessage.hxx"
+#include "msrp/Message.hxx"
+#include "msrp/Session.hxx"
+
+#include "Benchmark.hxx"
+
+using namespace msrp;
+using namespace std;
+using namespace resip;
+
+// !cb! Demultiplex::process routing complete SEND requests to one of N
+// sessions on a listening connection.  Each session takes the message and
+// declines the message session, so one operation covers the To-Path and
+// Message-ID lookups, the session's handlers and the IncomingMessage it
+// creates.  The messages are parsed once up front; routing leaves their
+// path headers unparsed, so they cost the same every time round.
+
+void
+ignore(boost::shared_ptr<const Message>)
+{}
+
+bool
+decline(boost::shared_ptr<IncomingMessage>)
+{
+   return false;
+}
+
+class Route
+{
+   public:
+      enum { Messages = 1024 };
+
+      Route(asio::io_service& service, size_t n) :
+         mNext(0)
+      {
+         mConnection = Connection::createOffer(service,
+               asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0),
+               boost::shared_ptr<asio::ssl::context>());
+
+         for (size_t i = 0; i < n; ++i)
+         {
+            stringstream self;
+            self << "msrp://127.0.0.1:2855/bench" << i << ";tcp";
+
+            boost::shared_ptr<Session> s = Session::factory(mConnection, Uri(self.str()));
+            s->onMessage().connect(&ignore);
+            s->onMessageSession().connect(&decline);
+
+            mDemux.insert(s);
+            mSessions.push_back(s);
+         }
+
+         const string eol("\r\n");
+
+         for (size_t i = 0; i < Messages; ++i)
+         {
+            stringstream block;
+            block << "MSRP a786hjs2 SEND" << eol
+                  << "To-Path: msrp://127.0.0.1:2855/bench" << i % n << ";tcp" << eol
+                  << "From-Path: msrp://alicepc.example.com:7777/iau39soe2843z;tcp" << eol
+                  << "Message-ID: 87652491" << i << eol
+                  << "Byte-Range: 1-25/25" << eol
+                  << "Content-Type: text/plain" << eol
+                  << eol;
+
+            const string b = block.str();
+
+            boost::shared_ptr<Message> m =
+               Message::factory(asio::buffer(b.data(), b.size()), Message::OverlayHeaders);
+            m->status() = Message::Complete;
+
+            mMessages.push_back(m);
+         }
+      }
+
+      void operator()()
+      {
+         Benchmark::consume(mDemux.process(mMessages[mNext]));
+
+         mNext = (mNext + 1) % Messages;
+      }
+
+   private:
+      boost::shared_ptr<Connection> mConnection;
+
+      vector<boost::shared_ptr<Session> > mSessions;
+      vector<boost::shared_ptr<const Message> > mMessages;
+
+      Demultiplex mDemux;
+
+      size_t mNext;
+};
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Err, argv[0]);
+
+   Benchmark::initialize(argc, argv);
+
+   asio::io_service service;
+
+   const size_t counts[] = { 1, 16, 256, 4096 };
+
+   for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+   {
+      Route route(service, counts[i]);
+
+      stringstream name;
+      name << "Demultiplex::process/" << counts[i];
+
+      Benchmark::run(name.str(), route);
+   }
+
+   return 0;
+}
@@ -0,0 +1,457 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <asio.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <rutil/Logger.hxx>
+
+#include "msrp/Connection.hxx"
+#include "msrp/IncomingMessage.hxx"
+#include "msrp/Message.hxx"
+#include "msrp/OutgoingMessage.hxx"
+#include "msrp/Session.hxx"
+#include "msrp/SessionFactory.hxx"
+
+using namespace msrp;
+using namespace std;
+using namespace resip;
+
+// !cb! End-to-end throughput and latency over 127.0.0.1.  One
+// SessionFactory offers M listening connections and answers them, and N
+// sessions are spread across the connections round robin.  Every sending
+// session keeps a window of messages in flight, with sizes drawn from a
+// weighted mix, and the receiving side times each message from
+// Session::stream() to the end of its contents.  Output is one
+// tab-separated result line after '#' comments, as in Benchmark.hxx:
+//
+//    messages  bytes  seconds  msgs/s  MB/s  cpu-us/msg  p50-us  p99-us  p999-us
+//
+// Usage: benchLoopback [-c connections] [-s sessions] [-n messages]
+//        [-w window] [-t threads] [-p port] [-m size:weight,...]
+//
+// Sizes take a k, M or G suffix and are limited to what a Byte-Range can
+// describe.  The default mix is mostly 100 byte chats with some 4k
+// messages and the odd 1M file.
+
+namespace
+{
+
+double
+now()
+{
+   timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+double
+cpu()
+{
+   rusage ru;
+   getrusage(RUSAGE_SELF, &ru);
+
+   return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e9 +
+      (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e3;
+}
+
+unsigned long
+parseSize(const string& s)
+{
+   char* end = 0;
+   double v = strtod(s.c_str(), &end);
+
+   switch (*end)
+   {
+      case 'k': v *= 1024; break;
+      case 'M': v *= 1024 * 1024; break;
+      case 'G': v *= 1024 * 1024 * 1024; break;
+   }
+
+   return static_cast<unsigned long>(v);
+}
+
+}
+
+class Loopback
+{
+   public:
+      struct Options
+      {
+         Options() :
+            connections(1), sessions(1), messages(10000), window(1), threads(1),
+            port(2855), mix("100:90,4k:9,1M:1")
+         {}
+
+         unsigned int connections;
+         unsigned int sessions;
+         unsigned long messages;
+         unsigned int window;
+         unsigned int threads;
+         unsigned short port;
+         string mix;
+      };
+
+      Loopback(asio::io_service& service, const Options& options) :
+         mService(service), mFactory(service), mOptions(options),
+         mIssued(0), mDelivered(0), mBytes(0)
+      {
+         draw();
+
+         for (unsigned int i = 0; i < mOptions.connections; ++i)
+         {
+            asio::ip::tcp::endpoint bound(asio::ip::address_v4::loopback(), mOptions.port + i);
+
+            mOffers.push_back(mFactory.offer(bound, receiver(i)));
+         }
+
+         for (unsigned int i = 0; i < mOptions.sessions; ++i)
+         {
+            const unsigned int c = i % mOptions.connections;
+
+            boost::shared_ptr<Session> r;
+
+            if (i < mOptions.connections)
+            {
+               r = mOffers[i];
+            }
+            else
+            {
+               r = Session::factory(mOffers[c]->connection(), receiver(i));
+            }
+
+            r->onMessage().connect(boost::bind(&Loopback::onMessage, this, i, _1));
+            r->onMessageSession().connect(boost::bind(&Loopback::onMessageSession, this, i, _1));
+            mReceivers.push_back(r);
+
+            // explicit addresses, so the answers never wait on DNS
+            boost::shared_ptr<Session> s = mFactory.answer(receiver(i), sender(i),
+                  SessionFactory::Callback());
+            assert(s);
+
+            // the answering connections are new, so none has connected yet
+            s->connection()->onConnect().connect(boost::bind(&Loopback::start, this, i));
+            mSenders.push_back(s);
+         }
+
+         mSent.resize(mSizes.size());
+         mLatency.reserve(mSizes.size());
+      }
+
+      // one per reactor thread
+      void run()
+      {
+         mFactory.run();
+      }
+
+      void report()
+      {
+         const double seconds = (mEnd - mBegin) / 1e9;
+
+         sort(mLatency.begin(), mLatency.end());
+
+         printf("# connections %u sessions %u window %u threads %u mix %s\n",
+               mOptions.connections, mOptions.sessions, mOptions.window,
+               mOptions.threads, mOptions.mix.c_str());
+         printf("# messages\tbytes\tseconds\tmsgs/s\tMB/s\tcpu-us/msg\tp50-us\tp99-us\tp999-us\n");
+         printf("%lu\t%.0f\t%.3f\t%.0f\t%.1f\t%.2f\t%.1f\t%.1f\t%.1f\n",
+               mDelivered, mBytes, seconds,
+               mDelivered / seconds,
+               mBytes / (1024 * 1024) / seconds,
+               (mCpuEnd - mCpuBegin) / 1e3 / mDelivered,
+               percentile(0.5), percentile(0.99), percentile(0.999));
+         fflush(stdout);
+      }
+
+   private:
+      Uri receiver(unsigned int i) const
+      {
+         stringstream s;
+         s << "msrp://127.0.0.1:" << mOptions.port + i % mOptions.connections
+           << "/recv" << i << ";tcp";
+
+         return Uri(s.str());
+      }
+
+      Uri sender(unsigned int i) const
+      {
+         stringstream s;
+         s << "msrp://127.0.0.1:" << mOptions.port + i % mOptions.connections
+           << "/send" << i << ";tcp";
+
+         return Uri(s.str());
+      }
+
+      // fix every message's size up front, so runs with the same options
+      // move the same bytes
+      void draw()
+      {
+         vector<pair<unsigned long, unsigned int> > mix;
+         unsigned int total = 0;
+
+         stringstream in(mOptions.mix);
+         string item;
+
+         while (getline(in, item, ','))
+         {
+            const string::size_type colon = item.find(':');
+            const unsigned int weight = colon == string::npos ? 1 :
+               atoi(item.c_str() + colon + 1);
+
+            unsigned long size = parseSize(item.substr(0, colon));
+            size = min<unsigned long>(size, numeric_limits<ByteRangeTuple::size_type>::max() - 1);
+
+            mix.push_back(make_pair(size, weight));
+            total += weight;
+         }
+
+         assert(total > 0);
+
+         srand(1);
+
+         for (unsigned long i = 0; i < mOptions.messages; ++i)
+         {
+            unsigned int r = rand() % total;
+            size_t j = 0;
+
+            while (r >= mix[j].second)
+            {
+               r -= mix[j].second;
+               ++j;
+            }
+
+            mSizes.push_back(mix[j].first);
+         }
+      }
+
+      double percentile(double p) const
+      {
+         if (mLatency.empty())
+         {
+            return 0;
+         }
+
+         return mLatency[min<size_t>(mLatency.size() - 1,
+               static_cast<size_t>(p * mLatency.size()))] / 1e3;
+      }
+
+      void start(unsigned int session)
+      {
+         {
+            boost::mutex::scoped_lock lock(mMutex);
+
+            if (mIssued == 0)
+            {
+               mBegin = now();
+               mCpuBegin = cpu();
+            }
+         }
+
+         for (unsigned int i = 0; i < mOptions.window; ++i)
+         {
+            send(session);
+         }
+      }
+
+      struct Pending
+      {
+         unsigned long remaining;
+      };
+
+      void send(unsigned int session)
+      {
+         unsigned long seq;
+
+         {
+            boost::mutex::scoped_lock lock(mMutex);
+
+            if (mIssued == mSizes.size())
+            {
+               return;
+            }
+
+            seq = mIssued++;
+            mSent[seq] = now();
+         }
+
+         Message m;
+         m.header<ToPath>().push_back(receiver(session));
+
+         mSenders[session]->prepare(m);
+
+         m.method() = Message::SEND;
+         m.status() = Message::Complete;
+         m.header("X-Sequence") = boost::lexical_cast<string>(seq);
+         m.header<ByteRange>().total = mSizes[seq];
+
+         boost::shared_ptr<Pending> p(new Pending);
+         p->remaining = mSizes[seq];
+
+         boost::shared_ptr<OutgoingMessage> out = mSenders[session]->stream(m);
+         out->onDataRequired().connect(boost::bind(&Loopback::onData, this, p, _1, _2));
+      }
+
+      void onData(boost::shared_ptr<Pending> p, size_t reqd, OutgoingMessage::StreamFunctor& stream)
+      {
+         static const char zeros[65536] = { 0 };
+
+         const size_t n = min<unsigned long>(p->remaining, reqd ? min(reqd, sizeof(zeros)) : sizeof(zeros));
+
+         p->remaining -= n;
+
+         stream(asio::const_buffer(zeros, n));
+      }
+
+      void onMessage(unsigned int session, boost::shared_ptr<const Message> m)
+      {
+         delivered(session, *m);
+      }
+
+      bool onMessageSession(unsigned int session, boost::shared_ptr<IncomingMessage> ims)
+      {
+         const Message& m = ims->message();
+
+         // already counted by onMessage
+         if (m.status() == Message::Complete)
+         {
+            return false;
+         }
+
+         // the message holds the signal, so bind a plain pointer to it
+         ims->onComplete().connect(boost::bind(&Loopback::onComplete, this, session, ims.get()));
+
+         return true;
+      }
+
+      void onComplete(unsigned int session, const IncomingMessage* ims)
+      {
+         delivered(session, ims->message());
+      }
+
+      void delivered(unsigned int session, const Message& m)
+      {
+         const double end = now();
+         const unsigned long seq = boost::lexical_cast<unsigned long>(m.header("X-Sequence"));
+
+         {
+            boost::mutex::scoped_lock lock(mMutex);
+
+            mLatency.push_back(end - mSent[seq]);
+            mBytes += mSizes[seq];
+
+            if (++mDelivered == mSizes.size())
+            {
+               mEnd = end;
+               mCpuEnd = cpu();
+
+               mFactory.shutdown();
+               mService.stop();
+
+               return;
+            }
+         }
+
+         // refill the sender's window from the io_service, not from inside
+         // the receiving connection's handlers
+         mService.post(boost::bind(&Loopback::send, this, session));
+      }
+
+      asio::io_service& mService;
+
+      SessionFactory mFactory;
+
+      const Options mOptions;
+
+      vector<boost::shared_ptr<Session> > mOffers;
+      vector<boost::shared_ptr<Session> > mReceivers;
+      vector<boost::shared_ptr<Session> > mSenders;
+
+      boost::mutex mMutex;
+
+      vector<unsigned long> mSizes;
+      vector<double> mSent;
+      vector<double> mLatency;
+
+      unsigned long mIssued;
+      unsigned long mDelivered;
+      double mBytes;
+
+      double mBegin;
+      double mEnd;
+      double mCpuBegin;
+      double mCpuEnd;
+};
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Err, argv[0]);
+
+   Loopback::Options options;
+
+   int c;
+
+   while ((c = getopt(argc, argv, "c:s:n:w:t:p:m:")) != -1)
+   {
+      switch (c)
+      {
+         case 'c': options.connections = atoi(optarg); break;
+         case 's': options.sessions = atoi(optarg); break;
+         case 'n': options.messages = strtoul(optarg, 0, 10); break;
+         case 'w': options.window = atoi(optarg); break;
+         case 't': options.threads = atoi(optarg); break;
+         case 'p': options.port = atoi(optarg); break;
+         case 'm': options.mix = optarg; break;
+         default:
+            fprintf(stderr, "usage: %s [-c connections] [-s sessions] [-n messages] "
+                  "[-w window] [-t threads] [-p port] [-m size:weight,...]\n", argv[0]);
+            return 1;
+      }
+   }
+
+   if (options.connections == 0 || options.sessions < options.connections ||
+       options.messages == 0 || options.window == 0 || options.threads == 0)
+   {
+      fprintf(stderr, "%s: need at least one connection, a session per connection, "
+            "a message, a window and a thread\n", argv[0]);
+      return 1;
+   }
+
+   printf("# %s\n", argv[0]);
+
+   asio::io_service service;
+
+   Loopback loopback(service, options);
+
+   boost::thread_group threads;
+
+   for (unsigned int i = 1; i < options.threads; ++i)
+   {
+      threads.create_thread(boost::bind(&Loopback::run, &loopback));
+   }
+
+   loopback.run();
+   threads.join_all();
+
+   loopback.report();
+
+   return 0;
+}
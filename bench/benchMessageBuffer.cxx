@@ -0,0 +1,126 @@
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include <rutil/Logger.hxx>
+
+#include "msrp/MessageBuffer.hxx"
+
+#include "Benchmark.hxx"
+
+using namespace msrp;
+using namespace std;
+using namespace resip;
+
+// !cb! MessageBuffer::read over a stream of chat-sized SEND requests with
+// the odd larger chunk, fed in reads of a fixed size the way Connection
+// would receive them.  One operation is one message framed.
+
+string
+stream()
+{
+   const string eol("\r\n");
+
+   stringstream s;
+
+   for (int i = 0; i < 64; ++i)
+   {
+      stringstream tid;
+      tid << "a786hjs2" << i;
+
+      const string contents = (i % 16 == 15) ? string(6000, 'x') : string(40 + i % 7 * 20, 'y');
+
+      s << "MSRP " << tid.str() << " SEND" << eol
+        << "To-Path: msrp://bob.example.com:8888/9di4eae923wzd;tcp" << eol
+        << "From-Path: msrp://alicepc.example.com:7777/iau39soe2843z;tcp" << eol
+        << "Message-ID: 87652491" << i << eol
+        << "Byte-Range: 1-" << contents.size() << "/" << contents.size() << eol
+        << "Content-Type: text/plain" << eol
+        << eol
+        << contents << eol
+        << "-------" << tid.str() << "$" << eol;
+   }
+
+   return s.str();
+}
+
+class Framing
+{
+   public:
+      Framing(const string& data, size_t readSize) :
+         mData(data), mReadSize(readSize), mPosition(0)
+      {}
+
+      void operator()()
+      {
+         // read until a message is complete, wrapping around the stream
+         for (;;)
+         {
+            if (mBuffer.state() == MessageBuffer::Complete)
+            {
+               mBuffer.reset();
+               mBuffer.read(0);
+
+               if (mBuffer.state() == MessageBuffer::Complete)
+               {
+                  return;
+               }
+            }
+
+            if (mPosition == mData.size())
+            {
+               mPosition = 0;
+            }
+
+            const asio::mutable_buffer space = mBuffer.mutableBuffer();
+
+            const size_t n = min(min(mReadSize, asio::buffer_size(space)), mData.size() - mPosition);
+            memcpy(asio::buffer_cast<char*>(space), mData.data() + mPosition, n);
+            mPosition += n;
+
+            mBuffer.read(n);
+
+            switch (mBuffer.state())
+            {
+               case MessageBuffer::Content:
+                  mBuffer.erase();
+                  break;
+               case MessageBuffer::Complete:
+                  return;
+               default:
+                  break;
+            }
+         }
+      }
+
+   private:
+      const string& mData;
+      const size_t mReadSize;
+      size_t mPosition;
+
+      MessageBuffer mBuffer;
+};
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Err, argv[0]);
+
+   Benchmark::initialize(argc, argv);
+
+   const string data = stream();
+
+   const size_t sizes[] = { 64, 512, 1460, 16384, 65536 };
+
+   for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+   {
+      Framing framing(data, sizes[i]);
+
+      stringstream name;
+      name << "MessageBuffer::read/" << sizes[i];
+
+      Benchmark::run(name.str(), framing);
+   }
+
+   return 0;
+}
@@ -0,0 +1,72 @@
+#include <sstream>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <rutil/Logger.hxx>
+
+#include "msrp/Message.hxx"
+#include "msrp/OutgoingMessage.hxx"
+#include "msrp/Scheduler.hxx"
+#include "msrp/Session.hxx"
+
+#include "Benchmark.hxx"
+
+using namespace msrp;
+using namespace std;
+using namespace resip;
+
+// !cb! Scheduler::thread selecting among N queued outgoing messages.  The
+// messages have no session; the scheduler only looks at their queues.
+
+class Select
+{
+   public:
+      Select(size_t n)
+      {
+         for (size_t i = 0; i < n; ++i)
+         {
+            Message m;
+            m.method() = Message::SEND;
+
+            stringstream id;
+            id << "bench" << i;
+            m.header<MessageId>() = id.str();
+
+            mMessages.push_back(OutgoingMessage::factory(boost::shared_ptr<Session>(), m));
+            mScheduler.queue(mMessages.back());
+         }
+      }
+
+      void operator()()
+      {
+         Benchmark::consume(mScheduler.thread().get());
+      }
+
+   private:
+      Scheduler mScheduler;
+
+      vector<boost::shared_ptr<OutgoingMessage> > mMessages;
+};
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Err, argv[0]);
+
+   Benchmark::initialize(argc, argv);
+
+   const size_t counts[] = { 1, 16, 256, 4096 };
+
+   for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+   {
+      Select select(counts[i]);
+
+      stringstream name;
+      name << "Scheduler::thread/" << counts[i];
+
+      Benchmark::run(name.str(), select);
+   }
+
+   return 0;
+}
@@ -0,0 +1,169 @@
+#include <cassert>
+#include <sstream>
+#include <string>
+
+#include <asio.hpp>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <rutil/Data.hxx>
+
+#include "msrp/BlockPool.hxx"
+#include "msrp/Buffer.hxx"
+
+using namespace msrp;
+using namespace std;
+using namespace resip;
+
+// !cb! Blocks are recycled through the free list and trimmed back to the
+// target, on demand or by the timer once traffic stops, a block queued on
+// two Buffers is only filled further by the one holding its newest bytes,
+// and a Buffer may outlive its io_service.
+
+string
+str(const Buffer& b)
+{
+   stringstream ss;
+   ss << b;
+
+   return ss.str();
+}
+
+int
+main()
+{
+   asio::io_service service;
+
+   BlockPool& pool = asio::use_service<BlockPool>(service);
+
+   // allocate and release
+
+   BlockPool::Block* a = pool.allocate();
+   BlockPool::Block* b = pool.allocate();
+   assert(a != b);
+   assert(pool.inUse() == 2);
+   assert(pool.idle() == 0);
+
+   BlockPool::release(a);
+   assert(pool.inUse() == 1);
+   assert(pool.idle() == 1);
+
+   BlockPool::Block* c = pool.allocate();
+   assert(c == a);
+   assert(pool.idle() == 0);
+
+   BlockPool::retain(c);
+   BlockPool::release(c);
+   assert(pool.inUse() == 2);
+
+   BlockPool::release(c);
+   BlockPool::release(b);
+   assert(pool.inUse() == 0);
+   assert(pool.idle() == 2);
+
+   // extend only from the end of the last claim
+
+   BlockPool::Block* e = pool.allocate();
+   assert(BlockPool::extend(e, e->data(), 100) == 100);
+   assert(BlockPool::extend(e, e->data(), 10) == 0);
+   assert(BlockPool::extend(e, e->data() + 100, BlockPool::BlockSize) == BlockPool::BlockSize - 100);
+   assert(BlockPool::extend(e, e->data() + BlockPool::BlockSize, 1) == 0);
+   BlockPool::release(e);
+
+   // trim
+
+   assert(pool.target() > pool.idle());
+   assert(pool.trim() == 0);
+
+   pool.target(0);
+   assert(pool.trim() == 2);
+   assert(pool.idle() == 0);
+
+   // blocks shared between buffers
+
+   {
+      Buffer x(pool);
+      x.write(Data("hello"));
+
+      Buffer y(pool);
+      y.append(x);
+      assert(pool.inUse() == 1);
+      assert(str(y) == "hello");
+
+      // x holds the newest bytes, so it keeps filling the shared block
+      x.write(Data(" world"));
+      assert(pool.inUse() == 1);
+
+      // y can't write over them and takes a block of its own
+      y.write(Data("!"));
+      assert(pool.inUse() == 2);
+
+      assert(str(x) == "hello world");
+      assert(str(y) == "hello!");
+
+      x.shift(x.size());
+      assert(x.empty());
+      assert(pool.inUse() == 2);
+      assert(str(y) == "hello!");
+   }
+
+   assert(pool.inUse() == 0);
+
+   // idle blocks above the target go back to the heap an interval after
+   // the release that left them, with nothing else released meanwhile
+
+   {
+      asio::io_service timed;
+
+      BlockPool& p = asio::use_service<BlockPool>(timed);
+      p.target(1);
+      p.interval(boost::posix_time::milliseconds(10));
+
+      BlockPool::Block* blocks[4];
+      for (int i = 0; i < 4; ++i)
+      {
+         blocks[i] = p.allocate();
+      }
+
+      for (int i = 0; i < 4; ++i)
+      {
+         BlockPool::release(blocks[i]);
+      }
+
+      assert(p.idle() == 4);
+
+      // returns once the timer has fired and trimmed
+      timed.run();
+      assert(p.idle() == 1);
+
+      // a stopped pool doesn't arm the timer, so run() returns at once
+      blocks[0] = p.allocate();
+      blocks[1] = p.allocate();
+      p.stop();
+      BlockPool::release(blocks[0]);
+      BlockPool::release(blocks[1]);
+
+      timed.reset();
+      timed.run();
+      assert(p.idle() == 2);
+
+      assert(p.trim() == 1);
+   }
+
+   // a buffer destroyed after its io_service releases into the surviving
+   // free list
+
+   Buffer* late;
+
+   {
+      asio::io_service gone;
+
+      late = new Buffer(asio::use_service<BlockPool>(gone));
+      late->write(Data("late"));
+   }
+
+   assert(str(*late) == "late");
+   delete late;
+
+   return 0;
+}
@@ -0,0 +1,188 @@
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <asio.hpp>
+
+#include <rutil/Data.hxx>
+
+#include "msrp/BlockPool.hxx"
+#include "msrp/Buffer.hxx"
+
+using namespace msrp;
+using namespace std;
+using namespace resip;
+
+// !cb! The view must always describe the front of the queue, and a view
+// taken before more data is queued must still describe the same bytes.
+
+string
+str(const Buffer& b)
+{
+   stringstream ss;
+   ss << b;
+
+   return ss.str();
+}
+
+string
+str(const Buffer::View& v)
+{
+   string s;
+
+   for (Buffer::View::const_iterator i = v.begin(); i != v.end(); ++i)
+   {
+      s.append(asio::buffer_cast<const char*>(*i), asio::buffer_size(*i));
+   }
+
+   return s;
+}
+
+size_t
+count(const Buffer::View& v)
+{
+   return v.end() - v.begin();
+}
+
+// one segment per call, owned by the buffer
+void
+write(Buffer& b, const string& s)
+{
+   char* p = new char[s.size()];
+   memcpy(p, s.data(), s.size());
+
+   b.write(asio::mutable_buffer(p, s.size()));
+}
+
+int
+main()
+{
+   asio::io_service service;
+
+   BlockPool& pool = asio::use_service<BlockPool>(service);
+
+   // partial shifts, within and across segments
+
+   {
+      Buffer b(pool);
+
+      write(b, "abcd");
+      write(b, "efgh");
+      write(b, "ijkl");
+      assert(b.size() == 12);
+      assert(count(b.view()) == 3);
+
+      b.shift(1);
+      assert(b.size() == 11);
+      assert(str(b.view()) == "bcdefghijkl");
+      assert(count(b.view()) == 3);
+
+      b.shift(5);
+      assert(str(b.view()) == "ghijkl");
+      assert(count(b.view()) == 2);
+
+      b.shift(2);
+      assert(str(b.view()) == "ijkl");
+      assert(count(b.view()) == 1);
+
+      b.shift(4);
+      assert(b.empty());
+      assert(b.size() == 0);
+      assert(count(b.view()) == 0);
+   }
+
+   // more segments than fit in the view
+
+   {
+      Buffer b(pool);
+
+      string all;
+
+      for (size_t i = 0; i < Buffer::Iov + 5; ++i)
+      {
+         const string s(1, static_cast<char>('a' + i % 26));
+
+         write(b, s);
+         all += s;
+      }
+
+      assert(b.size() == all.size());
+      assert(count(b.view()) == Buffer::Iov);
+      assert(str(b.view()) == all.substr(0, Buffer::Iov));
+      assert(str(b) == all);
+
+      // shifting refills the view from the segments behind it
+      b.shift(3);
+      assert(count(b.view()) == Buffer::Iov);
+      assert(str(b.view()) == all.substr(3, Buffer::Iov));
+
+      b.shift(4);
+      assert(count(b.view()) == Buffer::Iov - 2);
+      assert(str(b.view()) == all.substr(7));
+   }
+
+   // writes while a view is outstanding
+
+   {
+      Buffer b(pool);
+
+      b.write(Data("head"));
+
+      const Buffer::View outstanding = b.view();
+      assert(count(outstanding) == 1);
+
+      const asio::const_buffer before = *outstanding.begin();
+
+      // the tail block has room, but the bytes go in a new segment so the
+      // view's entry stays as it was
+      b.write(Data("tail"));
+      write(b, "owned");
+
+      assert(asio::buffer_cast<const char*>(*outstanding.begin())
+            == asio::buffer_cast<const char*>(before));
+      assert(asio::buffer_size(*outstanding.begin()) == 4);
+      assert(string(asio::buffer_cast<const char*>(before), 4) == "head");
+
+      assert(b.size() == 13);
+      assert(str(b) == "headtailowned");
+      assert(str(b.view()) == "headtailowned");
+      assert(pool.inUse() == 1);
+   }
+
+   assert(pool.inUse() == 0);
+
+   // two buffers sharing a tail block
+
+   {
+      Buffer a(pool);
+      a.write(Data("abc"));
+
+      Buffer b(pool);
+      b.append(a);
+      assert(pool.inUse() == 1);
+
+      // a holds the newest bytes and goes on filling the block; b has to
+      // take a new one rather than overwrite them
+      a.write(Data("def"));
+      b.write(Data("xyz"));
+      assert(pool.inUse() == 2);
+
+      assert(str(a) == "abcdef");
+      assert(str(b) == "abcxyz");
+
+      // b now holds the newest bytes of its own block
+      b.write(Data("123"));
+      assert(pool.inUse() == 2);
+      assert(str(b) == "abcxyz123");
+
+      b.shift(4);
+      assert(str(b) == "yz123");
+      assert(str(a) == "abcdef");
+   }
+
+   assert(pool.inUse() == 0);
+
+   return 0;
+}
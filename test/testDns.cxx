@@ -1,111 +1,332 @@
+#include <algorithm>
 #include <cassert>
 #include <functional>
 #include <string>
+#include <vector>
 
+#include <boost/algorithm/string.hpp>
 #include <boost/bind.hpp>
 
-#include <asio/deadline_timer.hpp>
+#include <asio.hpp>
 
 #include <rutil/Logger.hxx>
-#include <rutil/DnsUtil.hxx>
-#include <rutil/dns/DnsStub.hxx>
 
+#include "msrp/Connection.hxx"
 #include "msrp/DnsService.hxx"
-#include "msrp/TargetSelector.hxx"
+#include "msrp/Session.hxx"
+#include "msrp/SessionFactory.hxx"
 
 using namespace msrp;
 using namespace std;
 using namespace resip;
 using namespace boost;
+using namespace asio;
+using namespace asio::ip;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TEST
 
-ostream&
-operator<<(ostream& os, const DnsSrvRecord& srv)
+// !cb! Nameserver on the loopback interface answering from a fixed zone:
+// relay.example.com has one A record, _msrps._tcp.example.com two SRV
+// records, _msrps._tcp.fanout.example.com three SRV records whose targets
+// all have an A record for the loopback address, _msrps._tcp.dead.example.com
+// two SRV records whose targets don't exist, and every other name is
+// NXDOMAIN with an SOA for negative caching.
+class StubServer
 {
-   os << "pri " << srv.priority() << ' '
-      << "weight " << srv.weight() << ' '
-      << "port " << srv.port() << ' '
-      << "target " << srv.target();
-   return os;
+   public:
+      StubServer(io_service& ios) :
+         mSocket(ios, udp::endpoint(address_v4::loopback(), 0)),
+         mQueries(0)
+      {
+         receive();
+      }
+
+      const udp::endpoint endpoint() const { return mSocket.local_endpoint(); }
+
+      unsigned int queries() const { return mQueries; }
+
+      // source port of each query received
+      const vector<unsigned short>& ports() const { return mPorts; }
+
+      void close() { mSocket.close(); }
+
+   private:
+      void receive()
+      {
+         mSocket.async_receive_from(buffer(mBuffer, sizeof(mBuffer)), mPeer,
+            bind(&StubServer::handle, this, placeholders::error, placeholders::bytes_transferred));
+      }
+
+      void handle(const asio::error& e, size_t bytes)
+      {
+         if (e)
+         {
+            return;
+         }
+
+         ++mQueries;
+         mPorts.push_back(mPeer.port());
+
+         DnsMessage m;
+         if (m.decode(mBuffer, bytes))
+         {
+            m.response() = true;
+            m.ttl() = 300;
+
+            if (m.name() == "relay.example.com")
+            {
+               if (m.type() == DnsMessage::A)
+               {
+                  m.addresses().push_back(address::from_string("192.0.2.1"));
+               }
+               else
+               {
+                  m.negativeTtl() = 60;
+               }
+            }
+            else if (m.name() == "_msrps._tcp.example.com" && m.type() == DnsMessage::SRV)
+            {
+               m.services().push_back(SrvRecord(10, 60, 2855, "relay.example.com"));
+               m.services().push_back(SrvRecord(20, 0, 2856, "backup.example.com"));
+            }
+            else if (m.name() == "_msrps._tcp.fanout.example.com" && m.type() == DnsMessage::SRV)
+            {
+               m.services().push_back(SrvRecord(10, 10, 1, "a.fanout.example.com"));
+               m.services().push_back(SrvRecord(10, 10, 2, "b.fanout.example.com"));
+               m.services().push_back(SrvRecord(20, 0, 3, "c.fanout.example.com"));
+            }
+            else if (algorithm::ends_with(m.name(), ".fanout.example.com") && m.type() == DnsMessage::A)
+            {
+               m.addresses().push_back(address_v4::loopback());
+            }
+            else if (m.name() == "_msrps._tcp.dead.example.com" && m.type() == DnsMessage::SRV)
+            {
+               m.services().push_back(SrvRecord(10, 10, 2855, "x.dead.example.com"));
+               m.services().push_back(SrvRecord(20, 10, 2855, "y.dead.example.com"));
+            }
+            else
+            {
+               m.rcode() = DnsMessage::NameError;
+               m.negativeTtl() = 60;
+            }
+
+            char answer[DnsMessage::MaxSize];
+            const size_t size = m.encode(answer, sizeof(answer));
+            assert(size <= sizeof(answer));
+
+            mSocket.send_to(buffer(answer, size), mPeer);
+         }
+
+         receive();
+      }
+
+      udp::socket mSocket;
+      udp::endpoint mPeer;
+      char mBuffer[DnsMessage::MaxSize];
+      unsigned int mQueries;
+      vector<unsigned short> mPorts;
+};
+
+unsigned int answers = 0;
+
+vector<ip::address> addresses;
+DnsResult<SrvRecord> services;
+DnsResult<ip::address> hosts;
+
+void
+processAddresses(vector<ip::address> r)
+{
+   addresses = r;
+   ++answers;
 }
 
-ostream&
-operator<<(ostream& os, const DnsHostRecord& host)
+void
+processSrv(DnsResult<SrvRecord> r)
 {
-   return os << DnsUtil::inet_ntop(host.addr()) << endl;
+   services = r;
+   ++answers;
 }
 
-#ifdef USE_IPV6
-ostream&
-operator<<(ostream& os, const DnsAAAARecord& host)
+void
+processA(DnsResult<ip::address> r)
 {
-   return os << DnsUtil::inet_ntop(host.v6Address()) << endl;
+   hosts = r;
+   ++answers;
 }
-#endif
 
 void
-processSrv(const DNSResult<DnsSrvRecord>& r)
+processAnswer(DnsMessage m)
 {
-   InfoLog(<< "SRV result for " << r.domain);
-   
-   for (vector<DnsSrvRecord>::const_iterator i = r.records.begin(); i != r.records.end(); ++i)
-   {
-      InfoLog(<< *i);
-   }
+   ++answers;
 }
-   
+
+shared_ptr<Session> session;
+asio::error sessionError;
+
 void
-processA(const DNSResult<DnsHostRecord>& r)
+processSession(shared_ptr<Session> s, const asio::error& e)
 {
-   InfoLog(<< "ip4 result for " << r.domain);
-   
-   for (vector<DnsHostRecord>::const_iterator i = r.records.begin(); i != r.records.end(); ++i)
-   {
-      InfoLog(<< *i);
-   }
+   session = s;
+   sessionError = e;
+   ++answers;
+}
+
+bool
+targeted(const vector<tcp::endpoint>& targets, unsigned short port)
+{
+   return std::find(targets.begin(), targets.end(), tcp::endpoint(address_v4::loopback(), port))
+      != targets.end();
 }
 
-#ifdef USE_IPV6
 void
-processAAAA(const DNSResult<DnsAAARecord>& r)
+wait(io_service& ios, unsigned int expected)
 {
-   InfoLog(<< "ip6 result for " << r.domain);
-   
-   for (vector<DnsAAARecord>::const_iterator i = r.records.begin();
-            i != r.records.end(); ++i)
+   while (answers < expected)
    {
-      InfoLog(<< *i);
+      ios.run_one();
    }
 }
-#endif
 
 int
 main(int argc, char** argv)
 {
-   Log::initialize(Log::Cout, Log::Debug, argv[0]);
+   Log::initialize(Log::Cout, Log::Info, argv[0]);
 
-   assert(argc > 1);
-   const string domain(argv[1]);
+   io_service fifo;
 
-   asio::io_service fifo;
+   StubServer server(fifo);
 
    DnsService dns(fifo);
+   dns.nameservers(vector<udp::endpoint>(1, server.endpoint()));
+
+   dns.multiquery("relay.example.com", ptr_fun(&processAddresses));
+   wait(fifo, 1);
+
+   assert(addresses.size() == 1);
+   assert(addresses[0] == address::from_string("192.0.2.1"));
+
+   const unsigned int sent = server.queries();
+
+   // answered from the cache
+   dns.multiquery("RELAY.example.com.", ptr_fun(&processAddresses));
+   wait(fifo, 2);
+
+   assert(addresses.size() == 1);
+   assert(server.queries() == sent);
 
-   if (domain[0] == '_')
+   dns.query<Query::SRV>("_msrps._tcp.example.com", ptr_fun(&processSrv));
+   wait(fifo, 3);
+
+   assert(services.status == DnsMessage::NoError);
+   assert(services.records.size() == 2);
+   assert(services.records[0] == SrvRecord(10, 60, 2855, "relay.example.com"));
+   assert(services.records[1].target() == "backup.example.com");
+
+   // negative answers are cached too
+   dns.query<Query::A>("missing.example.com", ptr_fun(&processA));
+   wait(fifo, 4);
+
+   assert(hosts.status == DnsMessage::NameError && hosts.records.empty());
+
+   const unsigned int missed = server.queries();
+
+   dns.query<Query::A>("missing.example.com", ptr_fun(&processA));
+   wait(fifo, 5);
+
+   assert(hosts.status == DnsMessage::NameError);
+   assert(server.queries() == missed);
+
+   // concurrent lookups for one name share a query
+   dns.cache().clear();
+
+   dns.query<Query::SRV>("_msrps._tcp.example.com", ptr_fun(&processSrv));
+   dns.query<Query::SRV>("_MSRPS._tcp.example.com", ptr_fun(&processSrv));
+   wait(fifo, 7);
+
+   assert(services.records.size() == 2);
+   assert(server.queries() == missed + 1);
+
+   // names that cannot be encoded never reach the server
+   dns.query<Query::A>("bad..example.com", ptr_fun(&processA));
+   wait(fifo, 8);
+
+   assert(hosts.status == DnsMessage::FormatError);
+   assert(server.queries() == missed + 1);
+
+   // queries in flight together go out from different source ports
+   dns.cache().clear();
+
+   dns.query<Query::A>("relay.example.com", ptr_fun(&processA));
+   dns.query<Query::SRV>("_msrps._tcp.example.com", ptr_fun(&processSrv));
+   wait(fifo, 10);
+
+   assert(server.queries() == missed + 3);
+   assert(server.ports()[missed + 1] != server.ports()[missed + 2]);
+
+   // the resolver completes even a cache hit from the io_service, never
+   // from inside lookup()
+   shared_ptr<DnsResolver> resolver(new DnsResolver(fifo));
+   resolver->nameservers(vector<udp::endpoint>(1, server.endpoint()));
+
+   resolver->lookup("relay.example.com", DnsMessage::A, ptr_fun(&processAnswer));
+   wait(fifo, 11);
+
+   resolver->lookup("relay.example.com", DnsMessage::A, ptr_fun(&processAnswer));
+   assert(answers == 11);
+   wait(fifo, 12);
+
+   assert(server.queries() == missed + 4);
+
+   // an empty server list is refused, so queries still reach the old one
+   resolver->nameservers(vector<udp::endpoint>());
+   resolver->cache().clear();
+
+   resolver->lookup("relay.example.com", DnsMessage::A, ptr_fun(&processAnswer));
+   wait(fifo, 13);
+
+   assert(server.queries() == missed + 5);
+
+   // SRV targets are resolved in parallel: the first to resolve creates the
+   // connection and the others are appended to it as failover targets
+   SessionFactory factory(fifo);
+   factory.dns().nameservers(vector<udp::endpoint>(1, server.endpoint()));
+
+   Uri fanout;
+   fanout.scheme("msrps");
+   fanout.host("_msrps._tcp.fanout.example.com");
+
+   assert(!factory.answer(fanout, Uri(), &processSession));
+   wait(fifo, 14);
+
+   assert(session && !sessionError);
+
+   while (session->connection()->targets().size() < 3)
    {
-      dns.query<Query::SRV>(domain, ptr_fun(&processSrv));
+      fifo.run_one();
    }
-   else
-   {
-      dns.query<Query::A>(domain, ptr_fun(&processA));
 
-#ifdef USE_IPV6
-      dns.query<Query::AAAA>(domain, ptr_fun(&processAAAA));
-#endif
-   }
+   // one SRV query, then one A query per target
+   assert(server.queries() == missed + 9);
+
+   const vector<tcp::endpoint> targets = session->connection()->targets();
+   assert(targeted(targets, 1) && targeted(targets, 2) && targeted(targets, 3));
+
+   // when no target resolves, the handler is called once with an error
+   Uri dead;
+   dead.scheme("msrps");
+   dead.host("_msrps._tcp.dead.example.com");
+
+   assert(!factory.answer(dead, Uri(), &processSession));
+   wait(fifo, 15);
+
+   assert(!session && sessionError == asio::error::host_not_found);
+   assert(server.queries() == missed + 12);
+
+   factory.shutdown();
+
+   server.close();
 
-   fifo.run();
+   InfoLog(<< "DNS tests passed");
 
    return 0;
 }
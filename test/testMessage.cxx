@@ -1,18 +1,192 @@
 #include <cassert>
+#include <cstring>
 #include <iostream>
+#include <limits>
 #include <sstream>
+#include <vector>
 
+#include <boost/shared_ptr.hpp>
 #include <boost/timer.hpp>
 
+#include "msrp/FastParse.hxx"
+#include "msrp/HeaderHash.hxx"
 #include "msrp/Message.hxx"
+#include "msrp/ParseException.hxx"
 #include "msrp/Uri.hxx"
 
 using namespace msrp;
 using namespace std;
+using namespace boost;
+
+template<typename T>
+bool
+fastParse(bool (*parse)(const char*, const char*, T&), const char* s, T& value)
+{
+   return parse(s, s + strlen(s), value);
+}
+
+HeaderHash::Slot
+slot(const char* name)
+{
+   return HeaderHash::lookup(name, strlen(name));
+}
+
+// !cb! The hand-written value parsers and the perfect hash that picks them.
+void
+testFastParse()
+{
+   const unsigned int max = numeric_limits<unsigned int>::max();
+
+   // Content-Length
+
+   unsigned int n;
+   assert(fastParse(&parser::parseUnsigned, "0", n) && n == 0);
+   assert(fastParse(&parser::parseUnsigned, "4294967295", n) && n == max);
+   assert(!fastParse(&parser::parseUnsigned, "4294967296", n));
+   assert(!fastParse(&parser::parseUnsigned, "99999999999", n));
+   assert(!fastParse(&parser::parseUnsigned, "", n));
+   assert(!fastParse(&parser::parseUnsigned, "12a", n));
+   assert(!fastParse(&parser::parseUnsigned, "-1", n));
+
+   // Byte-Range
+
+   ByteRangeTuple r;
+   assert(fastParse(&parser::parseByteRange, "1-4294967295/4294967295", r));
+   assert(r.start == 1 && r.end == max && r.total == max);
+   assert(!fastParse(&parser::parseByteRange, "4294967296-1/1", r));
+   assert(!fastParse(&parser::parseByteRange, "1-4294967296/1", r));
+   assert(!fastParse(&parser::parseByteRange, "1-1/4294967296", r));
+
+   assert(fastParse(&parser::parseByteRange, "1-*/*", r));
+   assert(r.start == 1 && r.end == ByteRange::Unknown && r.total == ByteRange::Unknown);
+   assert(fastParse(&parser::parseByteRange, "11-*/20", r));
+   assert(r.start == 11 && r.end == ByteRange::Unknown && r.total == 20);
+   assert(fastParse(&parser::parseByteRange, "1-10/*", r));
+   assert(r.end == 10 && r.total == ByteRange::Unknown);
+
+   // a failed parse leaves the value alone
+   r = ByteRangeTuple(5, 6, 7);
+   assert(!fastParse(&parser::parseByteRange, "*-1/1", r));
+   assert(!fastParse(&parser::parseByteRange, "1-**/1", r));
+   assert(!fastParse(&parser::parseByteRange, "1-1/*1", r));
+   assert(!fastParse(&parser::parseByteRange, "1-1", r));
+   assert(!fastParse(&parser::parseByteRange, "1-1/1 ", r));
+   assert(r.start == 5 && r.end == 6 && r.total == 7);
+
+   // Status
+
+   StatusTuple st;
+   assert(fastParse(&parser::parseStatus, "000 200 OK", st));
+   assert(st.ns() == 0 && st.code() == 200 && st.phrase() == "OK");
+   assert(fastParse(&parser::parseStatus, "000 408", st));
+   assert(st.code() == 408 && st.phrase().empty());
+   assert(fastParse(&parser::parseStatus, "000\t413 \t too big", st));
+   assert(st.code() == 413 && st.phrase() == "too big");
+
+   assert(!fastParse(&parser::parseStatus, "", st));
+   assert(!fastParse(&parser::parseStatus, "000", st));
+   assert(!fastParse(&parser::parseStatus, "000 ", st));
+   assert(!fastParse(&parser::parseStatus, "000200 OK", st));
+   assert(!fastParse(&parser::parseStatus, "0000 200 OK", st));
+   assert(!fastParse(&parser::parseStatus, "000 2000 OK", st));
+   assert(!fastParse(&parser::parseStatus, "000 20x OK", st));
+   assert(!fastParse(&parser::parseStatus, " 000 200 OK", st));
+   assert(!fastParse(&parser::parseStatus, "abc 200 OK", st));
+
+   // Success-Report and Failure-Report
+
+   bool success = false;
+   assert(fastParse(&parser::parseSuccessReport, "yes", success) && success);
+   assert(fastParse(&parser::parseSuccessReport, "no", success) && !success);
+   assert(!fastParse(&parser::parseSuccessReport, "partial", success));
+   assert(!fastParse(&parser::parseSuccessReport, "Yes", success));
+   assert(!fastParse(&parser::parseSuccessReport, "yes ", success));
+   assert(!fastParse(&parser::parseSuccessReport, "", success));
+
+   int failure = -1;
+   assert(fastParse(&parser::parseFailureReport, "no", failure) && failure == FailureReport::No);
+   assert(fastParse(&parser::parseFailureReport, "yes", failure) && failure == FailureReport::Yes);
+   assert(fastParse(&parser::parseFailureReport, "partial", failure)
+         && failure == FailureReport::Partial);
+   assert(!fastParse(&parser::parseFailureReport, "part", failure));
+   assert(!fastParse(&parser::parseFailureReport, "partials", failure));
+   assert(!fastParse(&parser::parseFailureReport, "", failure));
+
+   // Message-ID
+
+   string id;
+   assert(fastParse(&parser::parseMessageId, "a.b-c+d%e=f09", id) && id == "a.b-c+d%e=f09");
+   assert(!fastParse(&parser::parseMessageId, "", id));
+   assert(!fastParse(&parser::parseMessageId, "a b", id));
+   assert(!fastParse(&parser::parseMessageId, "a/b", id));
+
+   // every standard header finds its own slot
+
+   for (int s = HeaderHash::Extension + 1; s < HeaderHash::Count; ++s)
+   {
+      const HeaderHash::Slot expected = static_cast<HeaderHash::Slot>(s);
+
+      assert(slot(HeaderHash::name(expected)) == expected);
+   }
+
+   // names hashing to a standard slot (same length, same second and
+   // next-to-last characters) are still extensions, as are near misses
+   assert(slot("To-Pxth") == HeaderHash::Extension);
+   assert(slot("Content-Lengtz") == HeaderHash::Extension);
+   assert(slot("Byte-Rangx") == HeaderHash::Extension);
+   assert(slot("to-path") == HeaderHash::Extension);
+   assert(slot("To-Path ") == HeaderHash::Extension);
+   assert(slot("") == HeaderHash::Extension);
+   assert(slot("T") == HeaderHash::Extension);
+
+   // and a parsed block keeps them as extension headers beside the
+   // standard ones they collide with
+   Message m;
+   m.method() = Message::SEND;
+   m.header("To-Path") = "msrp:127.0.0.1";
+   m.header("From-Path") = "msrp:192.168.0.1";
+   m.header("To-Pxth") = "msrp:10.0.0.1";
+   m.header("Content-Lengtz") = "12";
+   m.header("Byte-Range") = "1-*/*";
+   m.prepare();
+
+   ostringstream encoded;
+   static_cast<const Message&>(m).encodeHeader(encoded);
+
+   const string block = encoded.str();
+
+   shared_ptr<Message> parsed =
+      Message::factory(asio::buffer(block.data(), block.size()), Message::OverlayHeaders);
+   const Message& cm(*parsed);
+
+   assert(cm.exists("To-Pxth") && cm.header("To-Pxth") == "msrp:10.0.0.1");
+   assert(cm.exists("Content-Lengtz") && cm.header("Content-Lengtz") == "12");
+   assert(cm.header<ToPath>()[0].host() == "127.0.0.1");
+   assert(!cm.exists<ContentLength>());
+   assert(cm.header<ByteRange>().end == ByteRange::Unknown);
+   assert(cm.header<ByteRange>().total == ByteRange::Unknown);
+
+   // an overflowing value fails when the header is read
+   Message o;
+   o.header("Content-Length") = "4294967296";
+
+   bool threw = false;
+   try
+   {
+      static_cast<const Message&>(o).header<ContentLength>();
+   }
+   catch (const ParseException&)
+   {
+      threw = true;
+   }
+   assert(threw);
+}
 
 int
 main(int argc, char** argv)
 {
+   testFastParse();
+
    Message msg;
    msg.method() = Message::AUTH;
    msg.header("To-Path") = "msrp:127.0.0.1";
@@ -43,6 +217,12 @@ main(int argc, char** argv)
    assert(pmsg.header<ToPath>().size() == 1);
    assert(pmsg.header<ToPath>()[0].host() == "127.0.0.1");
 
+   // single URIs are read off an unparsed path without parsing it
+   Uri hop;
+   assert(pmsg.pathAt<FromPath>(1, hop) && hop.host() == "192.168.0.1");
+   assert(!pmsg.pathAt<FromPath>(2, hop));
+   assert(!pmsg.parsed<FromPath>());
+
    assert(pmsg.header<FromPath>().size() == 2);
    assert(pmsg.header<FromPath>()[0].scheme() == "msrps");
    assert(pmsg.header<FromPath>()[0].host() == "relay.example.com");
@@ -77,5 +257,46 @@ main(int argc, char** argv)
 
    cout << pmsg << endl;
 
+   // direct encoding reports the exact size and never writes past the buffer
+   ostringstream streamed;
+   streamed << pmsg;
+
+   const size_t size = pmsg.encode(0, 0);
+   assert(size == streamed.str().size());
+
+   vector<char> direct(size + 1, '!');
+   assert(pmsg.encode(&direct[0], size) == size);
+   assert(string(&direct[0], size) == streamed.str());
+   assert(direct[size] == '!');
+
+   char small[16];
+   assert(pmsg.encode(small, sizeof(small)) == size);
+
+   // re-parse the encoded header block with both header modes
+   ostringstream encoded;
+   pmsg.encodeHeader(encoded);
+
+   const string block = encoded.str();
+
+   shared_ptr<Message> overlay =
+      Message::factory(asio::buffer(block.data(), block.size()), Message::OverlayHeaders);
+   shared_ptr<Message> copied =
+      Message::factory(asio::buffer(block.data(), block.size()), Message::CopyHeaders);
+
+   assert(overlay->exists("Extension-Header"));
+   assert(overlay->header<ToPath>()[0].host() == "127.0.0.1");
+   assert(!overlay->exists("To-Path"));
+   assert(copied->header<FromPath>().size() == 2);
+
+   // materialise from the slice, then outlive the original message
+   const Message& coverlay(*overlay);
+   const string extension = coverlay.header("Extension-Header");
+   Message detached(*overlay);
+   overlay.reset();
+
+   assert(extension == "beer");
+   assert(detached.header("Extension-Header") == "beer");
+   assert(copied->header("Content-Disposition") == detached.header("Content-Disposition"));
+
    return 0;
 }
@@ -106,5 +106,111 @@ main(int argc, char** argv)
    partial.read(next - roff);
    assert(partial.state() == MessageBuffer::Complete);
 
+   // test growth past the initial buffer size
+
+   MessageBuffer growing(64, 1024);
+
+   for (size_t pos = 0; pos < mstr.size(); )
+   {
+      asio::mutable_buffer mb = growing.mutableBuffer();
+
+      const size_t bytes = min(asio::buffer_size(mb), mstr.size() - pos);
+      memcpy(asio::buffer_cast<char*>(mb), &mstr[pos], bytes);
+
+      growing.read(bytes);
+      pos += bytes;
+   }
+   assert(growing.state() == MessageBuffer::Complete);
+   assert(growing.capacity() > 64);
+
+   boost::shared_ptr<Message> grown = growing.parse(MessageBuffer::CopyContents);
+   assert(grown);
+   assert(grown->contents() == "This conference will end in 5 minutes");
+
+   // test the growth limit
+
+   MessageBuffer limited(64, 128);
+
+   bool exceeded = false;
+
+   try
+   {
+      for (size_t pos = 0; pos < mstr.size(); )
+      {
+         asio::mutable_buffer mb = limited.mutableBuffer();
+
+         const size_t bytes = min(asio::buffer_size(mb), mstr.size() - pos);
+         memcpy(asio::buffer_cast<char*>(mb), &mstr[pos], bytes);
+
+         limited.read(bytes);
+         pos += bytes;
+      }
+   }
+   catch (const MessageBuffer::Exception&)
+   {
+      exceeded = true;
+   }
+   assert(exceeded);
+
+   // test a transaction ID of the maximum length and a short one, split at
+   // every point of the contents and end token: no part of the token may be
+   // handed out as contents, and contents too short to release before the
+   // read ends must survive erase()
+
+   const string tids[] = { string(32, 'f'), "d93kswow" };
+   const string payload(100, 'x');
+
+   for (size_t t = 0; t < sizeof(tids) / sizeof(tids[0]); ++t)
+   {
+      const string& tid = tids[t];
+
+      msg.str(string());
+      msg
+         << "MSRP " << tid << " SEND" << eol
+         << "To-Path: msrp://bob.example.com:8888/9di4ea;tcp" << eol
+         << "From-Path: msrp://alicepc.example.com:7777/iau39;tcp" << eol
+         << "Content-Type: text/plain" << eol
+         << "Message-ID: 12339sdqwer" << eol
+         << eol
+         << payload
+         << "-------" << tid << "$";
+
+      const string lstr = msg.str();
+
+      for (size_t split = lstr.find(payload); split <= lstr.size(); ++split)
+      {
+         MessageBuffer streamed;
+         string received;
+
+         const size_t reads[] = { split, lstr.size() - split };
+
+         for (size_t pos = 0, r = 0; r < 2; pos += reads[r++])
+         {
+            if (!reads[r])
+            {
+               continue;
+            }
+
+            memcpy(asio::buffer_cast<char*>(streamed.mutableBuffer()), &lstr[pos], reads[r]);
+            streamed.read(reads[r]);
+
+            if (streamed.state() == MessageBuffer::Content
+                  || streamed.state() == MessageBuffer::Complete)
+            {
+               const asio::const_buffer b = streamed.contents();
+               received.append(asio::buffer_cast<const char*>(b), asio::buffer_size(b));
+
+               if (streamed.state() == MessageBuffer::Content)
+               {
+                  streamed.erase();
+               }
+            }
+         }
+
+         assert(streamed.state() == MessageBuffer::Complete);
+         assert(received == payload);
+      }
+   }
+
    return 0;
 }
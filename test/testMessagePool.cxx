@@ -6,6 +6,7 @@
 
 #include <boost/bind.hpp>
 #include <boost/thread.hpp>
+#include <boost/thread/barrier.hpp>
 
 #include "msrp/Message.hxx"
 #include "msrp/MessagePool.hxx"
@@ -14,26 +15,27 @@ using namespace boost;
 using namespace msrp;
 using namespace std;
 
-// !cb! Primarily serves as a performance test for Message instantiation
-// via msrp::MessagePool.  Memory usage should remain almost static and
-// the test (>100,000 concurrent allocations) should not take very long.
+// !cb! Concurrency and throughput test for msrp::MessagePool.  Each thread
+// allocates and frees at random, and hands a share of its messages to its
+// neighbour so that cross-thread frees go through the remote stacks.  Memory
+// usage should remain almost static and the test should not take very long.
 
 class PoolAllocatorThread
 {
    public:
       PoolAllocatorThread(MessagePool& pool)
-         : mPool(pool), mRemaining(1024 * 8)
+         : mPool(pool), mRemaining(1024 * 64), mNeighbour(0)
       {
-         mMessages.reserve(mRemaining);
+         mMessages.reserve(1024);
       }
 
-      void run()
+      void neighbour(PoolAllocatorThread& n)
       {
-         size_t alloc = 0;
-         size_t freed = 0;
-
-         size_t msgs = 0;
+         mNeighbour = &n;
+      }
 
+      void run()
+      {
          while (mRemaining)
          {
             if (mMessages.empty() || (random() % 3) != 0)
@@ -41,55 +43,163 @@ class PoolAllocatorThread
                mMessages.push_back(mPool.allocate());
 
                --mRemaining;
-
-               ++alloc;
             }
             else
             {
-               vector<shared_ptr<Message> >::iterator i = mMessages.begin();
-               advance(i, random() % mMessages.size());
+               shared_ptr<Message>& m = mMessages[random() % mMessages.size()];
 
-               mMessages.erase(i);
+               if ((random() % 4) == 0)
+               {
+                  mNeighbour->give(m);
+               }
 
-               ++freed;
+               m.swap(mMessages.back());
+               mMessages.pop_back();
             }
 
-            if ((++msgs % 1000) == 0)
+            if ((mRemaining % 256) == 0)
             {
-               cerr << this << ": "
-                    << alloc << " alloc "
-                    << freed << " freed"
-                    << endl;
+               // freed here, allocated on another thread
+               drain();
             }
          }
 
          mMessages.clear();
       }
 
+      void give(const shared_ptr<Message>& m)
+      {
+         mutex::scoped_lock lock(mMutex);
+         mInbox.push_back(m);
+      }
+
+      void drain()
+      {
+         mutex::scoped_lock lock(mMutex);
+         mInbox.clear();
+      }
+
    private:
       MessagePool& mPool;
 
       vector<shared_ptr<Message> > mMessages;
 
       size_t mRemaining;
+
+      PoolAllocatorThread* mNeighbour;
+
+      mutex mMutex;
+      vector<shared_ptr<Message> > mInbox;
 };
 
+// !cb! A running thread's cache is out of trim()'s reach; the thread empties
+// it itself on its next release after the trim.
+
+void
+cacheThenRelease(MessagePool* pool, barrier* cached, barrier* trimmed)
+{
+   {
+      vector<shared_ptr<Message> > messages;
+      for (size_t i = 0; i < 100; ++i)
+      {
+         messages.push_back(pool->allocate());
+      }
+   }
+
+   cached->wait();
+   trimmed->wait();
+
+   pool->allocate().reset();
+
+   cached->wait();
+}
+
+void
+testLiveTrim()
+{
+   MessagePool pool;
+
+   barrier cached(2);
+   barrier trimmed(2);
+
+   thread worker(bind(&cacheThenRelease, &pool, &cached, &trimmed));
+
+   cached.wait();
+   assert(pool.allocated() == 100);
+
+   assert(pool.trim() == 0);
+   assert(pool.allocated() == 100);
+
+   trimmed.wait();
+   cached.wait();
+
+   assert(pool.inUse() == 0);
+   assert(pool.allocated() == 0);
+
+   worker.join();
+}
+
 int
 main(int argc, char** argv)
 {
+   testLiveTrim();
+
    srandom(time(0));
 
    MessagePool pool;
 
-   PoolAllocatorThread allocator1(pool);
-   thread t1(bind(&PoolAllocatorThread::run, &allocator1));
+   const size_t Threads = 4;
+
+   vector<PoolAllocatorThread*> allocators;
+   for (size_t i = 0; i < Threads; ++i)
+   {
+      allocators.push_back(new PoolAllocatorThread(pool));
+   }
+
+   for (size_t i = 0; i < Threads; ++i)
+   {
+      allocators[i]->neighbour(*allocators[(i + 1) % Threads]);
+   }
+
+   const clock_t begin = clock();
+
+   thread_group threads;
+   for (size_t i = 0; i < Threads; ++i)
+   {
+      threads.create_thread(bind(&PoolAllocatorThread::run, allocators[i]));
+   }
+
+   threads.join_all();
+
+   const clock_t end = clock();
+
+   for (size_t i = 0; i < Threads; ++i)
+   {
+      allocators[i]->drain();
+      delete allocators[i];
+   }
+
+   assert(pool.inUse() == 0);
+   assert(pool.highWater() > 0);
+   assert(pool.allocated() >= pool.highWater());
+
+   cerr << Threads * 1024 * 64 << " allocations in "
+        << double(end - begin) / CLOCKS_PER_SEC << "s, "
+        << pool.highWater() << " high water, "
+        << pool.allocated() << " allocated"
+        << endl;
 
-   PoolAllocatorThread allocator2(pool);
-   thread t2(bind(&PoolAllocatorThread::run, &allocator2));
+   // the workers have exited, so their caches are orphaned and trimmable
+   pool.trim();
+   assert(pool.allocated() == 0);
 
-   t1.join();
+   shared_ptr<Message> m = pool.allocate();
+   assert(pool.inUse() == 1);
+   assert(pool.allocated() == 1);
 
-   t2.join();
+   m.reset();
+   assert(pool.inUse() == 0);
+   assert(pool.trim() == 1);
 
    return 0;
 }
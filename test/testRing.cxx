@@ -0,0 +1,102 @@
+#include <cassert>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "msrp/Atomic.hxx"
+#include "msrp/Ring.hxx"
+
+using namespace msrp;
+using namespace std;
+
+// !cb! Several producers and consumers share a small ring, so it wraps
+// many times and is often full or empty.  Every value must come out
+// exactly once.
+
+enum
+{
+   Producers = 4,
+   Consumers = 4,
+   PerProducer = 100000
+};
+
+Ring<unsigned long> ring(64);
+
+Atomic<unsigned long> consumed;
+
+vector<unsigned char> seen(Producers * PerProducer);
+
+void
+produce(unsigned long first)
+{
+   for (unsigned long v = first; v < first + PerProducer; ++v)
+   {
+      while (!ring.push(v))
+      {
+         boost::thread::yield();
+      }
+   }
+}
+
+void
+consume()
+{
+   while (consumed.load() < Producers * PerProducer)
+   {
+      unsigned long v;
+
+      if (ring.pop(v))
+      {
+         // each value is written by one consumer only, if the ring works
+         ++seen[v];
+
+         consumed.fetchAdd(1);
+      }
+      else
+      {
+         boost::thread::yield();
+      }
+   }
+}
+
+int
+main()
+{
+   unsigned long v;
+
+   assert(!ring.pop(v));
+
+   for (unsigned long i = 0; i < ring.capacity(); ++i)
+   {
+      assert(ring.push(i));
+   }
+
+   assert(!ring.push(0));
+
+   for (unsigned long i = 0; i < ring.capacity(); ++i)
+   {
+      assert(ring.pop(v) && v == i);
+   }
+
+   boost::thread_group threads;
+
+   for (unsigned long i = 0; i < Consumers; ++i)
+   {
+      threads.create_thread(&consume);
+   }
+
+   for (unsigned long i = 0; i < Producers; ++i)
+   {
+      threads.create_thread(boost::bind(&produce, i * PerProducer));
+   }
+
+   threads.join_all();
+
+   for (size_t i = 0; i < seen.size(); ++i)
+   {
+      assert(seen[i] == 1);
+   }
+
+   return 0;
+}
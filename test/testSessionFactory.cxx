@@ -5,8 +5,10 @@
 #include <sys/types.h>
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "msrp/System.hxx"
+#include "msrp/Connection.hxx"
 #include "msrp/IncomingMessage.hxx"
 #include "msrp/OutgoingMessage.hxx"
 #include "msrp/SessionFactory.hxx"
@@ -24,7 +26,7 @@ class OfferSession
 {
    public:
       OfferSession(SessionFactory& sf, const string& file) :
-         mFactory(sf), mFile(file), mTimer(sf.service())
+         mFactory(sf), mFile(file), mReported(false), mTimer(sf.service())
       {
          mFd = open(file.c_str(), O_RDONLY);
          assert(mFd >= 0);
@@ -52,6 +54,32 @@ class OfferSession
          c->onConnect().connect(bind(&OfferSession::onAccept, this, _1));
       }
 
+      // !cb! The answering side doesn't send success reports yet, so once
+      // it has the whole file, hand our connection the REPORT it would have
+      // sent.  The session finished with the message when the last chunk
+      // went out, so this checks the report route outlived that.
+      void report()
+      {
+         shared_ptr<Message> r = Message::factory();
+
+         r->method() = Message::REPORT;
+         r->status() = Message::Complete;
+         r->transaction() = "report";
+
+         r->header<ToPath>().push_back(mSession->address().front());
+         r->header<FromPath>().push_back(Uri("msrp://127.0.0.1:9955/peer;tcp"));
+         r->header<MessageId>() = mOutgoing->messageId();
+         r->header<ByteRange>() = ByteRangeTuple(1, mSize, mSize);
+
+         const bool delivered = mSession->connection()->demultiplexer().process(r);
+         assert(delivered);
+      }
+
+      bool reported() const
+      {
+         return mReported;
+      }
+
    private:
       void onAccept(const ip::tcp::endpoint& peer)
       {
@@ -71,7 +99,30 @@ class OfferSession
 
          mOutgoing = mSession->stream(m);
 
+         // the Message-ID stays with this message while it is in progress
+         Message again(m);
+         again.header<MessageId>() = mOutgoing->messageId();
+
+         bool refused = false;
+         try
+         {
+            mSession->stream(again);
+         }
+         catch (const Session::Exception&)
+         {
+            refused = true;
+         }
+         assert(refused);
+
          mOutgoing->onDataRequired().connect(bind(&OfferSession::onData, this, _1, _2));
+         mOutgoing->onReport().connect(bind(&OfferSession::onReport, this, _1));
+      }
+
+      void onReport(const Message& report)
+      {
+         InfoLog(<< "report: " << report);
+
+         mReported = true;
       }
 
       void onData(size_t reqd, OutgoingMessage::StreamFunctor& stream)
@@ -102,14 +153,16 @@ class OfferSession
 
       int mFd;
 
+      bool mReported;
+
       deadline_timer mTimer;
 };
 
 class AnswerSession
 {
    public:
-      AnswerSession(SessionFactory& sf) :
-         mFactory(sf)
+      AnswerSession(SessionFactory& sf, OfferSession& offer) :
+         mFactory(sf), mOffer(offer)
       {}
 
       void create()
@@ -194,6 +247,9 @@ class AnswerSession
       void onMessageSessionContext(const Message& m)
       {
          InfoLog(<< "message session context: " << m);
+
+         // every chunk's transaction ID, counter included, within RFC 4975
+         assert(m.transaction().size() <= 32);
       }
 
       void onMessageSessionContents(const asio::const_buffer& b)
@@ -212,11 +268,15 @@ class AnswerSession
          ::close(mFd);
          mFd = -1;
 
+         mOffer.report();
+
          mFactory.shutdown();
       }
 
       SessionFactory& mFactory;
 
+      OfferSession& mOffer;
+
       shared_ptr<Session> mSession;
 
       string mFilename;
@@ -224,11 +284,97 @@ class AnswerSession
       int mFd;
 };
 
+// !cb! Sessions answered from several threads at once must share one
+// connection per target, and targets pushed onto a pooled connection must
+// be found by later answers while the pool is being read and republished.
+
+enum
+{
+   AnswerThreads = 4,
+   Answers = 200,
+   Targets = 4,
+   Pushed = 50
+};
+
+Uri
+target(unsigned short port)
+{
+   Uri u;
+   u.scheme("msrp");
+   u.host("127.0.0.1");
+   u.port(port);
+
+   return u;
+}
+
+void
+answerThread(SessionFactory* sf, vector<shared_ptr<Connection> >* connections)
+{
+   for (unsigned int i = 0; i < Answers; ++i)
+   {
+      shared_ptr<Session> s = sf->answer(target(9960 + i % Targets), Uri(), SessionFactory::Callback());
+      assert(s);
+
+      (*connections)[i] = s->connection();
+   }
+}
+
+void
+pushThread(SessionFactory* sf)
+{
+   shared_ptr<Connection> c = sf->answer(target(9960), Uri(), SessionFactory::Callback())->connection();
+
+   for (unsigned short i = 0; i < Pushed; ++i)
+   {
+      vector<ip::tcp::endpoint> endpoints;
+      endpoints.push_back(ip::tcp::endpoint(ip::address_v4::loopback(), 9970 + i));
+
+      c->pushTargets(endpoints);
+
+      // the pool was republished with the new target
+      assert(sf->answer(target(9970 + i), Uri(), SessionFactory::Callback())->connection() == c);
+   }
+}
+
+void
+testConcurrentAnswer()
+{
+   asio::io_service ios;
+
+   SessionFactory sf(ios);
+
+   vector<vector<shared_ptr<Connection> > > connections(AnswerThreads,
+         vector<shared_ptr<Connection> >(Answers));
+
+   boost::thread_group threads;
+
+   for (unsigned int i = 0; i < AnswerThreads; ++i)
+   {
+      threads.create_thread(bind(&answerThread, &sf, &connections[i]));
+   }
+
+   threads.create_thread(bind(&pushThread, &sf));
+
+   threads.join_all();
+
+   for (unsigned int t = 0; t < AnswerThreads; ++t)
+   {
+      for (unsigned int i = 0; i < Answers; ++i)
+      {
+         assert(connections[t][i] == connections[0][i % Targets]);
+      }
+   }
+
+   sf.shutdown();
+}
+
 int
 main(int argc, char** argv)
 {
    Log::initialize(Log::Cout, Log::Debug, argv[0]);
 
+   testConcurrentAnswer();
+
    asio::io_service fifo;
 
    SessionFactory sf(fifo);
@@ -236,10 +382,12 @@ main(int argc, char** argv)
    scoped_ptr<OfferSession> os(new OfferSession(sf, "testSessionFactory.cxx"));
    os->create();
 
-   scoped_ptr<AnswerSession> as(new AnswerSession(sf));
+   scoped_ptr<AnswerSession> as(new AnswerSession(sf, *os));
    as->create();
 
-   fifo.run();
+   sf.run();
+
+   assert(os->reported());
 
    return 0;
 }
@@ -0,0 +1,85 @@
+#include <cassert>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <asio/ip/address.hpp>
+
+#include "msrp/TargetHealth.hxx"
+#include "msrp/TargetSelector.hxx"
+
+using namespace msrp;
+using namespace std;
+using namespace asio::ip;
+
+// !cb! A record with no health must come last in its priority, and the
+// weighted picks should follow the weights within a few percent.
+
+double
+health(const SrvRecord& r)
+{
+   return r.target() == "down" ? 0.0 : 1.0;
+}
+
+int
+main()
+{
+   vector<SrvRecord> records;
+   records.push_back(SrvRecord(10, 60, 2855, "a"));
+   records.push_back(SrvRecord(10, 20, 2855, "b"));
+   records.push_back(SrvRecord(10, 20, 2855, "down"));
+   records.push_back(SrvRecord(20, 0, 2855, "backup"));
+
+   map<string, int> first;
+
+   for (int n = 0; n < 10000; ++n)
+   {
+      TargetSelector selector(records, health);
+
+      ++first[selector.next().target()];
+
+      selector.next();
+      assert(selector.next().target() == "down");
+      assert(selector.next().target() == "backup");
+
+      // next round
+      assert(selector.next().priority() == 10);
+   }
+
+   assert(first["down"] == 0);
+   assert(first["a"] > 7000 && first["a"] < 8000);
+
+   try
+   {
+      TargetSelector empty((vector<SrvRecord>()));
+      empty.next();
+      assert(false);
+   }
+   catch (const TargetSelector::Exception&)
+   {}
+
+   const tcp::endpoint up(address::from_string("192.0.2.1"), 2855);
+   const tcp::endpoint failing(address::from_string("192.0.2.2"), 2855);
+
+   TargetHealth& th = TargetHealth::instance();
+
+   th.failed(failing);
+   assert(th.health(failing) < th.health(up));
+
+   vector<tcp::endpoint> endpoints;
+   endpoints.push_back(failing);
+   endpoints.push_back(up);
+   th.order(endpoints);
+   assert(endpoints.front() == up);
+
+   for (int n = 1; n < TargetHealth::Down; ++n)
+   {
+      th.failed(failing);
+   }
+   assert(th.health(failing) == 0);
+
+   th.connected(failing, 10);
+   assert(th.health(failing) == 1.0);
+
+   return 0;
+}
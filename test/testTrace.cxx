@@ -0,0 +1,81 @@
+#include <cassert>
+
+#include "msrp/Histogram.hxx"
+#include "msrp/Trace.hxx"
+
+using namespace msrp;
+
+// !cb! Histogram buckets must cover every value with 1/Sub precision, and
+// a timeline should record each stage against the one stamped before it.
+
+int
+main()
+{
+   for (Histogram::Value v = 0; v < (Histogram::Value(1) << Histogram::MaxBits); v = v * 5 / 4 + 1)
+   {
+      const std::size_t i = Histogram::index(v);
+
+      assert(i < Histogram::Buckets);
+      assert(Histogram::lowest(i) <= v);
+      assert(i + 1 == Histogram::Buckets || v < Histogram::lowest(i + 1));
+      assert(v - Histogram::lowest(i) <= v / Histogram::Sub);
+   }
+
+   assert(Histogram::index(~Histogram::Value(0)) == Histogram::Buckets - 1);
+
+   Histogram h;
+
+   for (Histogram::Value v = 1; v <= 100000; ++v)
+   {
+      h.record(v);
+   }
+
+   assert(h.count() == 100000);
+
+   const Histogram::Value p50 = h.percentile(0.5);
+   const Histogram::Value p99 = h.percentile(0.99);
+
+   assert(p50 >= 50000 && p50 <= 50000 + 50000 / Histogram::Sub);
+   assert(p99 >= 99000 && p99 <= 99000 + 99000 / Histogram::Sub);
+   assert(h.max() >= 100000 && h.max() <= 100000 + 100000 / Histogram::Sub);
+
+   // disabled: nothing is recorded
+   Trace trace;
+   Trace::Timeline timeline(&trace);
+
+   timeline.mark(Trace::Read);
+   timeline.mark(Trace::Delivered);
+   assert(!trace.histogram(Trace::Delivered));
+
+   Trace::enable(true);
+
+   timeline.mark(Trace::Queued);
+   timeline.mark(Trace::Scheduled);
+   timeline.mark(Trace::LastByte);
+   timeline.mark(Trace::Reported);
+
+   assert(trace.histogram(Trace::Scheduled)->count() == 1);
+   assert(trace.histogram(Trace::LastByte)->count() == 1);
+   assert(!trace.histogram(Trace::FirstByte));
+   assert(trace.histogram(Trace::Outbound)->count() == 1);
+   assert(Trace::global().histogram(Trace::Outbound)->count() == 1);
+
+   // with no success report asked for, the last byte ends the timeline and
+   // a stray REPORT records nothing
+   Trace::Timeline unreported(&trace);
+   unreported.expectReport(false);
+
+   unreported.mark(Trace::Queued);
+   unreported.mark(Trace::Scheduled);
+   unreported.mark(Trace::LastByte);
+
+   assert(trace.histogram(Trace::LastByte)->count() == 2);
+   assert(trace.histogram(Trace::Outbound)->count() == 2);
+
+   unreported.mark(Trace::Reported);
+
+   assert(trace.histogram(Trace::Reported)->count() == 1);
+   assert(trace.histogram(Trace::Outbound)->count() == 2);
+
+   return 0;
+}
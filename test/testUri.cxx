@@ -106,6 +106,40 @@ main(int argc, char** argv)
 
    Reject rejectionTests(sum);
 
+   // routing keys fold scheme and host case but not the session ID
+   Uri a("msrp://Relay.Example.com:2855/abc;tcp");
+   Uri b("MSRP://relay.example.com:2855/abc;tcp");
+   Uri c("msrp://relay.example.com:2855/ABC;tcp");
+
+   assert(a.key() == b.key() && a.hash() == b.hash());
+   assert(!(a < b) && !(b < a));
+   assert(a.key() != c.key());
+   assert((a < c) != (c < a));
+
+   b.session("ABC");
+   assert(b.key() == c.key());
+
+   // identical URIs share an interned representation; changing a copy
+   // detaches it
+   Uri d("msrp://relay.example.com:2855/ABC;tcp");
+   assert(c.interned() && d.interned() && d == c);
+
+   Uri e(d);
+   e.port(2856);
+   assert(!e.interned() && e != d && d.port() == 2855);
+
+   // copies of a changed Uri share its representation, whose key already
+   // reflects the change; changing one again detaches it
+   Uri f(e);
+   Uri g;
+   g = e;
+   assert(f.key() == "msrp:relay.example.com:2856/ABC");
+   assert(&f.key() == &e.key() && &g.key() == &e.key());
+
+   f.session("xyz");
+   assert(f.key() == "msrp:relay.example.com:2856/xyz");
+   assert(e.key() == "msrp:relay.example.com:2856/ABC");
+
    cerr << sum << " msrp URI tests passed" << endl;
 
    return 0;